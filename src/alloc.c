@@ -0,0 +1,523 @@
+#define _GNU_SOURCE // mremap
+#include "alloc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+// header stored right before the memory given to the caller
+union block {
+	struct {
+		size_t size;   // usable size asked by the caller
+		size_t length; // length of the mapping, 0 when the block is on the heap
+		int fd;        // scratch file behind the mapping, -1 when anonymous
+		int file;      // 1 for a private mapping of a file of the caller (see `alloc_map_file`)
+		const struct alloc_heap * heap; // of a heap block, NULL for the libc
+	} info;
+	long double align; // keep the user memory aligned as malloc does
+};
+
+
+// spill configuration (disabled without scratch directory)
+static const char * scratch_dir = NULL;
+static size_t spill_threshold = ALLOC_SPILL_THRESHOLD;
+
+// memory budget
+static size_t process_budget = ALLOC_PROCESS_BUDGET;
+static size_t used = 0; // bytes of all living blocks, shared by the threads (atomic)
+static __thread struct alloc_eval * eval = NULL; // evaluation of the thread (see `alloc_bind`)
+
+
+// heap of the bound evaluation, the libc otherwise
+static union block * heap_malloc(size_t total) {
+	const struct alloc_heap * heap = (eval != NULL ? eval->heap : NULL);
+	union block * b = (heap != NULL ? heap->malloc(total, heap->data) : malloc(total));
+	if (b != NULL) {
+		b->info.heap = heap;
+		b->info.file = 0;
+	}
+	return b;
+}
+
+static union block * heap_realloc(union block * b, size_t total) {
+	const struct alloc_heap * heap = b->info.heap;
+	return (heap != NULL ? heap->realloc(b, total, heap->data) : realloc(b, total));
+}
+
+static void heap_free(union block * b) {
+	const struct alloc_heap * heap = b->info.heap;
+	if (heap != NULL) {
+		heap->free(b, heap->data);
+		return;
+	}
+	free(b);
+}
+
+
+static size_t page_round(size_t len) {
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	return ((len + page - 1) / page) * page;
+}
+
+static union block * map_block(size_t length) {
+
+	void * addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		log_error("mmap of %zu bytes failed", length);
+		return NULL;
+	}
+	#ifdef MADV_HUGEPAGE
+	madvise(addr, length, MADV_HUGEPAGE); // only a hint, failure doesn't matter
+	#endif
+	union block * b = (union block *) addr;
+	b->info.fd   = -1;
+	b->info.file = 0;
+	return b;
+}
+
+// map a new (unlinked) file of the scratch directory, the kernel writes the pages back to it
+static union block * map_file_block(size_t length) {
+	if (scratch_dir == NULL) {
+		return NULL;
+	}
+
+	char path[strlen(scratch_dir) + sizeof("/calcul-XXXXXX")];
+	sprintf(path, "%s/calcul-XXXXXX", scratch_dir);
+
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		log_error("can't create scratch file in '%s' (%s)", scratch_dir, strerror(errno));
+		return NULL;
+	}
+	unlink(path); // the file disappears with its last mapping
+
+	if (ftruncate(fd, length) < 0) {
+		log_error("can't extend scratch file to %zu bytes (%s)", length, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	void * addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		log_error("mmap of scratch file [%zu bytes] failed", length);
+		close(fd);
+		return NULL;
+	}
+	log_info("spill %zu bytes in scratch directory '%s'", length, scratch_dir);
+
+	union block * b = (union block *) addr;
+	b->info.fd   = fd;
+	b->info.file = 0;
+	return b;
+}
+
+static void unmap_block(union block * b) {
+	int fd = b->info.fd;
+	munmap(b, b->info.length);
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+// grow (or shrink) a mapping, the kernel moves the pages instead of copying them
+static union block * remap_block(union block * b, size_t length) {
+
+	if ((b->info.fd >= 0) && (ftruncate(b->info.fd, length) < 0)) {
+		log_error("can't resize scratch file to %zu bytes (%s)", length, strerror(errno));
+		return NULL;
+	}
+
+	#ifdef MREMAP_MAYMOVE
+	void * addr = mremap(b, b->info.length, length, MREMAP_MAYMOVE);
+	if (addr == MAP_FAILED) {
+		log_error("mremap of %zu bytes to %zu failed", b->info.length, length);
+		return NULL;
+	}
+	#ifdef MADV_HUGEPAGE
+	if (((union block *) addr)->info.fd < 0) {
+		madvise(addr, length, MADV_HUGEPAGE);
+	}
+	#endif
+	return (union block *) addr;
+
+	#else // no mremap, fallback on a copy
+	union block * new = (b->info.fd < 0 ? map_block(length) : map_file_block(length));
+	if (new == NULL) {
+		return NULL;
+	}
+	int fd = new->info.fd;
+	memcpy(new, b, (b->info.length < length ? b->info.length : length));
+	new->info.fd = fd;
+	unmap_block(b);
+	return new;
+	#endif
+}
+
+// new mapping, spilled in a file when too big (or when the memory is exhausted)
+static union block * new_mapping(size_t length) {
+
+	union block * b = NULL;
+	if ((scratch_dir == NULL) || (length < spill_threshold)) {
+		b = map_block(length);
+	}
+	if (b == NULL) {
+		b = map_file_block(length);
+	}
+	return b;
+}
+
+
+
+// count a block going from `old_size` to `size` bytes
+static void count(size_t old_size, size_t size) {
+	if (size > old_size) {
+		__atomic_add_fetch(&used, size - old_size, __ATOMIC_RELAXED);
+	}
+	else {
+		__atomic_sub_fetch(&used, old_size - size, __ATOMIC_RELAXED);
+	}
+	if (eval != NULL) { // blocks from before the evaluation may be freed
+		eval->used = (eval->used + size > old_size ? eval->used + size - old_size : 0);
+	}
+}
+
+// return 1 (and set the error) if `more` bytes exceed a budget
+// (the process budget is checked before the allocation, threads can overtake it a little)
+static int over_budget(size_t more) {
+
+	size_t all = alloc_used();
+	if ((process_budget != 0) && (all + more > process_budget)) {
+		log_warn("process budget exceeded (%zu + %zu > %zu bytes)", all, more, process_budget);
+		error_set(MEM_BUDGET, NULL, NULL, 0);
+		return 1;
+	}
+	if ((eval != NULL) && (eval->budget != 0) && (eval->used + more > eval->budget)) {
+		log_warn("evaluation budget exceeded (%zu + %zu > %zu bytes)", eval->used, more, eval->budget);
+		error_set(MEM_BUDGET, NULL, NULL, 0);
+		return 1;
+	}
+	return 0;
+}
+
+static void * out_of_memory(size_t size) {
+	log_error("can't allocate %zu bytes", size);
+	error_set(OUT_OF_MEM, NULL, NULL, 0);
+	return NULL;
+}
+
+
+void * alloc_malloc(size_t size) {
+	if (over_budget(size)) {
+		return NULL;
+	}
+
+	union block * b;
+	size_t total = sizeof(union block) + size;
+
+	if (size < ALLOC_MAP_THRESHOLD) {
+		b = heap_malloc(total);
+		if (b == NULL) {
+			return out_of_memory(size);
+		}
+		b->info.length = 0;
+	}
+	else {
+		size_t length = page_round(total);
+		b = new_mapping(length);
+		if (b == NULL) {
+			return out_of_memory(size);
+		}
+		b->info.length = length;
+		log_debug("alloc map @%p [%zu bytes] fd %d", b, length, b->info.fd);
+	}
+	b->info.size = size;
+	count(0, size);
+	return (void *) &b[1];
+}
+
+void * alloc_realloc(void * ptr, size_t size) {
+	if (ptr == NULL) {
+		return alloc_malloc(size);
+	}
+	union block * b = ((union block *) ptr) - 1;
+	size_t total = sizeof(union block) + size;
+
+	if ((size > b->info.size) && over_budget(size - b->info.size)) {
+		return NULL;
+	}
+
+	if (b->info.length == 0) { // on the heap
+
+		if (size < ALLOC_MAP_THRESHOLD) {
+			size_t old_size = b->info.size;
+			union block * new = heap_realloc(b, total);
+			if (new == NULL) {
+				return out_of_memory(size);
+			}
+			new->info.size = size;
+			count(old_size, size);
+			return (void *) &new[1];
+		}
+
+		// last copy, from the heap to a mapping
+		void * new = alloc_malloc(size);
+		if (new == NULL) {
+			return NULL;
+		}
+		memcpy(new, ptr, (b->info.size < size ? b->info.size : size));
+		alloc_free(ptr);
+		return new;
+	}
+
+	size_t length = page_round(total);
+	if (b->info.file && (length != b->info.length)) {
+
+		// last copy, the pages after the end of the file can't be touched
+		void * new = alloc_malloc(size);
+		if (new == NULL) {
+			return NULL;
+		}
+		memcpy(new, ptr, (b->info.size < size ? b->info.size : size));
+		alloc_free(ptr);
+		return new;
+	}
+	if ((scratch_dir != NULL) && (b->info.fd < 0) && (length >= spill_threshold)) {
+
+		// last copy, from memory to a scratch file
+		union block * new = map_file_block(length);
+		if (new == NULL) {
+			return out_of_memory(size);
+		}
+		memcpy(&new[1], ptr, (b->info.size < size ? b->info.size : size));
+		new->info.length = length;
+		new->info.size   = size;
+		count(b->info.size, size);
+		unmap_block(b);
+		return (void *) &new[1];
+	}
+	if (length != b->info.length) {
+		size_t old_length = b->info.length;
+		union block * new = remap_block(b, length);
+		if (new == NULL) {
+			return out_of_memory(size);
+		}
+		log_debug("alloc remap @%p [%zu bytes] ==> @%p [%zu bytes]", b, old_length, new, length);
+		b = new;
+		b->info.length = length;
+	}
+	count(b->info.size, size);
+	b->info.size = size;
+	return (void *) &b[1];
+}
+
+void alloc_free(void * ptr) {
+	if (ptr == NULL) {
+		return;
+	}
+	union block * b = ((union block *) ptr) - 1;
+	assert(alloc_used() >= b->info.size);
+	count(b->info.size, 0);
+
+	if (b->info.length == 0) {
+		heap_free(b);
+		return;
+	}
+	log_debug("alloc unmap @%p [%zu bytes] fd %d", b, b->info.length, b->info.fd);
+	unmap_block(b);
+}
+
+
+void * alloc_map_file(int fd, off_t offset, size_t size) {
+	assert(offset % sysconf(_SC_PAGESIZE) == 0);
+	if (over_budget(size)) {
+		return NULL;
+	}
+
+	size_t length = page_round(sizeof(union block) + size);
+	void * addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+	if (addr == MAP_FAILED) {
+		log_error("mmap of a file [%zu bytes] failed (%s)", length, strerror(errno));
+		return out_of_memory(size);
+	}
+	union block * b = (union block *) addr; // over the first bytes of the file, in a private copy of the page
+	b->info.size   = size;
+	b->info.length = length;
+	b->info.fd     = -1; // the mapping keeps the file
+	b->info.file   = 1;
+	b->info.heap   = NULL;
+	log_debug("alloc map file @%p [%zu bytes]", b, length);
+	count(0, size);
+	return (void *) &b[1];
+}
+
+size_t alloc_file_header() {
+	return sizeof(union block);
+}
+
+
+void alloc_set_scratch(const char * dir, size_t threshold) {
+	scratch_dir = dir;
+	spill_threshold = threshold;
+	log_info("scratch directory '%s' from %zu bytes", (dir ? dir : "(none)"), threshold);
+}
+
+void alloc_set_budget(size_t process) {
+	process_budget = process;
+	log_info("memory budget %zu bytes per process", process);
+}
+
+void alloc_bind(struct alloc_eval * e) {
+	eval = e;
+}
+
+size_t alloc_used() {
+	return __atomic_load_n(&used, __ATOMIC_RELAXED);
+}
+
+
+size_t alloc_size(const void * ptr) {
+	return (((const union block *) ptr) - 1)->info.size;
+}
+
+int alloc_is_mapped(const void * ptr) {
+	return ((((const union block *) ptr) - 1)->info.length != 0);
+}
+
+int alloc_is_spilled(const void * ptr) {
+	const union block * b = ((const union block *) ptr) - 1;
+	return ((b->info.length != 0) && (b->info.fd >= 0));
+}
+
+
+
+/*
+	TEST
+*/
+
+
+void test_alloc() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("ALLOC:\n");
+
+
+	printf(" heap block\n");
+	unsigned char * h = alloc_malloc(16);
+	assert(h != NULL);
+	assert(!alloc_is_mapped(h));
+	assert(alloc_size(h) == 16);
+	for (int i = 0; i < 16; i++) {
+		h[i] = (unsigned char) i;
+	}
+	h = alloc_realloc(h, 64);
+	assert(!alloc_is_mapped(h));
+	assert(alloc_size(h) == 64);
+	for (int i = 0; i < 16; i++) {
+		assert(h[i] == (unsigned char) i);
+	}
+
+
+	printf(" heap to mapping\n");
+	h = alloc_realloc(h, ALLOC_MAP_THRESHOLD);
+	assert(alloc_is_mapped(h));
+	assert(alloc_size(h) == ALLOC_MAP_THRESHOLD);
+	for (int i = 0; i < 16; i++) {
+		assert(h[i] == (unsigned char) i);
+	}
+	alloc_free(h);
+
+
+	printf(" mapped block\n");
+	size_t size = ALLOC_MAP_THRESHOLD + 3;
+	unsigned char * m = alloc_malloc(size);
+	assert(m != NULL);
+	assert(alloc_is_mapped(m));
+	m[0] = 0x12;
+	m[size - 1] = 0x34;
+	m = alloc_realloc(m, 3 * size); // grow
+	assert(alloc_size(m) == 3 * size);
+	assert(m[0] == 0x12);
+	assert(m[size - 1] == 0x34);
+	m[3 * size - 1] = 0x56;
+	m = alloc_realloc(m, size + 1); // shrink
+	assert(alloc_is_mapped(m));
+	assert(m[0] == 0x12);
+	assert(m[size - 1] == 0x34);
+	alloc_free(m);
+
+	alloc_free(NULL);
+
+
+	printf(" spilled block\n");
+	alloc_set_scratch(".", ALLOC_MAP_THRESHOLD);
+	unsigned char * f = alloc_malloc(16);
+	assert(!alloc_is_spilled(f));
+	f[15] = 0x78;
+	f = alloc_realloc(f, ALLOC_MAP_THRESHOLD); // heap -> file
+	assert(alloc_is_spilled(f));
+	assert(f[15] == 0x78);
+	f = alloc_realloc(f, 2 * ALLOC_MAP_THRESHOLD);
+	assert(alloc_is_spilled(f));
+	assert(f[15] == 0x78);
+	f[2 * ALLOC_MAP_THRESHOLD - 1] = 0x9A;
+	alloc_free(f);
+	alloc_set_scratch(NULL, ALLOC_SPILL_THRESHOLD);
+
+
+	printf(" file\n");
+	FILE * tmp = tmpfile();
+	assert(tmp != NULL);
+	size_t header = alloc_file_header();
+	for (size_t i = 0; i < header + 3 * ALLOC_MAP_THRESHOLD / 2; i++) {
+		fputc((int) (i & 0xff), tmp);
+	}
+	fflush(tmp);
+	f = alloc_map_file(fileno(tmp), 0, 3 * ALLOC_MAP_THRESHOLD / 2);
+	assert((f != NULL) && alloc_is_mapped(f) && !alloc_is_spilled(f));
+	assert(alloc_size(f) == 3 * ALLOC_MAP_THRESHOLD / 2);
+	assert((f[0] == (unsigned char) header) && (f[1000] == (unsigned char) (header + 1000)));
+	f[0] = 0xEE; // private copy
+	f = alloc_realloc(f, 2 * ALLOC_MAP_THRESHOLD); // further than the file
+	assert((f != NULL) && (f[0] == 0xEE) && (f[1000] == (unsigned char) (header + 1000)));
+	f[2 * ALLOC_MAP_THRESHOLD - 1] = 0x9A;
+	alloc_free(f);
+	rewind(tmp);
+	assert(fgetc(tmp) == 0);
+	fseek(tmp, header, SEEK_SET);
+	assert(fgetc(tmp) == (int) (header & 0xff)); // the file is unchanged
+	fclose(tmp);
+
+
+	printf(" budget\n");
+	size_t before = alloc_used();
+	unsigned char * b1 = alloc_malloc(100);
+	assert(alloc_used() == before + 100);
+	struct alloc_eval e = {150, 0, NULL};
+	alloc_bind(&e);
+	unsigned char * b2 = alloc_malloc(100);
+	assert(b2 != NULL);
+	assert(alloc_malloc(100) == NULL); // 200 bytes in this evaluation
+	assert(error_get() == MEM_BUDGET);
+	error_reset();
+	assert(alloc_realloc(b2, 200) == NULL);
+	assert(error_get() == MEM_BUDGET);
+	error_reset();
+	alloc_free(b2);
+	assert(e.used == 0);
+	alloc_bind(NULL);
+	alloc_set_budget(before + 150);
+	assert(alloc_malloc(100) == NULL); // 200 bytes in the process
+	assert(error_get() == MEM_BUDGET);
+	error_reset();
+	alloc_free(b1);
+	assert(alloc_used() == before);
+	alloc_set_budget(ALLOC_PROCESS_BUDGET);
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,94 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "config.h"
+#include "error.h"
+#include "log.h"
+
+
+/*
+	Allocator for (potentially) huge blocks, like `struct big_int`
+
+Small blocks come from the heap. Blocks of at least `ALLOC_MAP_THRESHOLD` bytes
+are anonymous mappings (with transparent huge pages when available), they grow
+with `mremap` without copying and go back to the OS as soon as they are freed.
+
+With a scratch directory, mappings of at least the spill threshold (or when the
+memory is exhausted) are backed by an unlinked file of this directory, so a
+number can be bigger than the RAM. A block can also be a private mapping of a
+file (`alloc_map_file`): its pages are read on demand, only the written ones
+are copied.
+
+Every block is counted against a memory budget (per evaluation and per process,
+see `alloc_bind`). The small blocks of an evaluation can come from the heap of
+the caller, a block is always freed by the heap it comes from.
+On failure, the functions return NULL and set the error `OUT_OF_MEM` or
+`MEM_BUDGET` instead of leaving the program.
+*/
+
+
+// return NULL on failure (and set the error)
+void * alloc_malloc(size_t size);
+
+void * alloc_realloc(void * ptr, size_t size);
+
+void alloc_free(void * ptr);
+
+
+// map the `size` bytes of the file `fd` from `offset` + `alloc_file_header()` as a block (`offset`
+// is a multiple of the page size), copy on write: the file is never changed, the bytes before the
+// block are its header in memory
+// return NULL on failure (and set the error)
+void * alloc_map_file(int fd, off_t offset, size_t size);
+
+// bytes of a file before the block of `alloc_map_file`
+size_t alloc_file_header();
+
+
+// `dir` NULL disables the spill in files
+void alloc_set_scratch(const char * dir, size_t threshold);
+
+// heap given by a user of the library, `data` is passed back to the functions
+struct alloc_heap {
+	void * (* malloc)(size_t size, void * data);
+	void * (* realloc)(void * ptr, size_t size, void * data);
+	void (* free)(void * ptr, void * data);
+	void * data;
+};
+
+// memory of an evaluation
+struct alloc_eval {
+	size_t budget; // bytes (0 is unlimited)
+	size_t used;   // bytes allocated (and not freed) during the evaluation
+	const struct alloc_heap * heap; // of the small blocks, NULL for the libc
+};
+
+// budget of the process in bytes, 0 is unlimited
+void alloc_set_budget(size_t process_budget);
+
+// count the blocks of the calling thread in `eval` (NULL to stop)
+void alloc_bind(struct alloc_eval * eval);
+
+// bytes currently allocated by the process
+size_t alloc_used();
+
+
+// usable size of the block
+size_t alloc_size(const void * ptr);
+
+// return 1 if the block is a mapping (not from the heap)
+int alloc_is_mapped(const void * ptr);
+
+// return 1 if the block is a mapping of a scratch file
+int alloc_is_spilled(const void * ptr);
+
+
+void test_alloc();
+
+
+#endif // ALLOC_H
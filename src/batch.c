@@ -0,0 +1,947 @@
+#define _GNU_SOURCE // open_memstream, _SC_NPROCESSORS_ONLN, syscall
+#include "batch.h"
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+static void batch_error(struct calc_ctx * ctx, const char * line, const char * name, long line_nb, FILE * out) {
+	fprintf(out, "error %s:%ld:%d: ", name, line_nb, error_column(&ctx->error, line) + 1);
+	error_fprint(out, &ctx->error);
+	fputc('\n', out);
+}
+
+// evaluate one line (up to '\n' or '\0') and write its result
+static int batch_line(struct calc_ctx * ctx, struct command_state * cmd, const char * line, const char * name, long line_nb, FILE * out) {
+
+	if (command_is(line)) {
+		if (command_run(ctx, cmd, line, out, NULL) < 0) { // no last result in the batch
+			batch_error(ctx, line, name, line_nb, out);
+			return 1;
+		}
+		fputc('\n', out);
+		return 0;
+	}
+
+	struct number result;
+	int res = eval_str(ctx, line, &result);
+
+	if (res < 0) {
+		batch_error(ctx, line, name, line_nb, out);
+		return 1;
+	}
+	if (res > 0) {
+		number_fprint(out, &result);
+		number_free(result);
+	}
+	fputc('\n', out);
+	return 0;
+}
+
+// evaluate the lines of `text` (each one ends with '\n'), from the line `first`
+// return the number of errors
+static long batch_lines(struct calc_ctx * ctx, struct command_state * cmd, const char * text, size_t len, const char * name, long first, FILE * out) {
+
+	long errors = 0;
+	const char * end = text + len;
+
+	while (text < end) {
+		const char * nl = memchr(text, '\n', end - text);
+		assert(nl != NULL);
+		errors += batch_line(ctx, cmd, text, name, first++, out);
+		text = nl + 1;
+	}
+	return errors;
+}
+
+static long count_lines(const char * text, size_t len) {
+	long n = 0;
+	const char * end = text + len;
+	while ((text = memchr(text, '\n', end - text)) != NULL) {
+		text++;
+		n++;
+	}
+	return n;
+}
+
+
+
+/*
+	WORKER POOL
+
+With `BATCH_POOL_THREADS` threads or more, the reader cuts the input in chunks of complete lines. Each worker evaluates
+a chunk in its own memory stream with its own context. The chunks are kept in a ring of `BATCH_QUEUE` chunks
+per worker and written in the input order.
+*/
+
+struct chunk {
+	const char * text;
+	char * copy;    // of the text, NULL if it stays valid (mapped file)
+	size_t len;
+	long first;     // line number of the first line
+	char * res;     // output of the chunk
+	size_t res_len;
+	long errors;
+	int done;
+};
+
+struct pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work; // a chunk to evaluate, or the end
+	pthread_cond_t done; // a chunk is evaluated
+
+	struct chunk * ring;
+	long size;
+	long head; // next chunk to write
+	long next; // next chunk to evaluate
+	long tail; // next free chunk
+	int end;
+
+	const char * name;
+	FILE * out;
+	struct command_state * cmd;
+	long errors;
+
+	int threads;
+	pthread_t * worker;
+};
+
+
+static void * pool_worker(void * arg) {
+	struct pool * p = arg;
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "batch context");
+
+	pthread_mutex_lock(&p->lock);
+	while (1) {
+		while ((p->next == p->tail) && !p->end) {
+			pthread_cond_wait(&p->work, &p->lock);
+		}
+		if (p->next == p->tail) { // end
+			break;
+		}
+		struct chunk * c = &p->ring[p->next % p->size];
+		p->next++;
+		pthread_mutex_unlock(&p->lock);
+
+		FILE * out = open_memstream(&c->res, &c->res_len);
+		CHECK_MALLOC(out, "batch chunk output");
+		c->errors = batch_lines(ctx, p->cmd, c->text, c->len, p->name, c->first, out);
+		fclose(out);
+
+		pthread_mutex_lock(&p->lock);
+		c->done = 1;
+		pthread_cond_signal(&p->done);
+	}
+	pthread_mutex_unlock(&p->lock);
+	ctx_free(ctx);
+	return NULL;
+}
+
+// write the chunks in order, at least up to `until` (waiting for them), lock held
+static void pool_write(struct pool * p, long until) {
+
+	while (p->head < p->tail) {
+		struct chunk * c = &p->ring[p->head % p->size];
+		if (!c->done) {
+			if (p->head >= until) {
+				return;
+			}
+			pthread_cond_wait(&p->done, &p->lock);
+			continue;
+		}
+		// nobody else touches the chunk until `head` moves
+		pthread_mutex_unlock(&p->lock);
+		fwrite(c->res, 1, c->res_len, p->out);
+		p->errors += c->errors;
+		free(c->res);
+		LOG_FREE(c->copy);
+		free(c->copy);
+		pthread_mutex_lock(&p->lock);
+		p->head++;
+	}
+}
+
+static void pool_push(struct pool * p, const char * text, size_t len, long first, int in_place) {
+
+	char * copy = NULL;
+	if (!in_place) {
+		copy = malloc(len);
+		CHECK_MALLOC(copy, "batch chunk");
+		memcpy(copy, text, len);
+	}
+
+	pthread_mutex_lock(&p->lock);
+	pool_write(p, p->tail - p->size + 1); // a free chunk
+	struct chunk * c = &p->ring[p->tail % p->size];
+	c->text  = (in_place ? text : copy);
+	c->copy  = copy;
+	c->len   = len;
+	c->first = first;
+	c->res   = NULL;
+	c->done  = 0;
+	p->tail++;
+	pthread_cond_signal(&p->work);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static struct pool * pool_start(int threads, const char * name, FILE * out, struct command_state * cmd) {
+
+	struct pool * p = malloc(sizeof(struct pool));
+	CHECK_MALLOC(p, "batch pool");
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->work, NULL);
+	pthread_cond_init(&p->done, NULL);
+
+	p->size = (long) BATCH_QUEUE * threads;
+	p->ring = malloc(sizeof(struct chunk) * p->size);
+	CHECK_MALLOC(p->ring, "batch ring");
+	p->head = 0;
+	p->next = 0;
+	p->tail = 0;
+	p->end  = 0;
+	p->name = name;
+	p->out  = out;
+	p->cmd  = cmd;
+	p->errors  = 0;
+	p->threads = 0;
+
+	p->worker = malloc(sizeof(pthread_t) * threads);
+	CHECK_MALLOC(p->worker, "batch workers");
+	for (int i = 0; i < threads; i++) {
+		if (pthread_create(&p->worker[i], NULL, pool_worker, p) != 0) {
+			log_warn("batch: only %d worker threads", i);
+			break;
+		}
+		p->threads++;
+	}
+	log_info("batch: %d worker threads", p->threads);
+	return p;
+}
+
+// wait for every chunk, return the number of errors
+static long pool_stop(struct pool * p) {
+
+	pthread_mutex_lock(&p->lock);
+	p->end = 1;
+	pthread_cond_broadcast(&p->work);
+	pool_write(p, p->tail);
+	pthread_mutex_unlock(&p->lock);
+
+	for (int i = 0; i < p->threads; i++) {
+		pthread_join(p->worker[i], NULL);
+	}
+	long errors = p->errors;
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->work);
+	pthread_cond_destroy(&p->done);
+	LOG_FREE(p->worker);
+	free(p->worker);
+	LOG_FREE(p->ring);
+	free(p->ring);
+	LOG_FREE(p);
+	free(p);
+	return errors;
+}
+
+
+
+/*
+	PIPELINE
+
+With a few threads, the stages of the lines overlap instead: the reader lexes
+and parses line n + 1 while a thread evaluates line n and another one writes
+line n - 1 (the conversion of a huge result costs about as much as its
+computation). The stages are linked by bounded lock-free queues of one
+producer and one consumer, a full queue stops the stage before it.
+*/
+
+#define LINE_COMMAND 2 // `res` of a line run by the evaluator as a command
+
+struct line {
+	long line_nb;
+	int res;     // of `eval_parse`, then of the evaluation
+	struct expr e;
+	struct number result;
+	char * reply; // message of an error or report of a command (from `open_memstream`)
+	size_t reply_len;
+	const char * text; // the tokens point in it
+	char copy[];       // of the text, if it doesn't stay valid
+};
+
+// single producer, single consumer
+struct spsc {
+	struct line * slot[BATCH_PIPELINE_DEPTH];
+
+	// written by the producer
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t producer_sleeps;
+	uint32_t consumer_bell;
+
+	// written by the consumer
+	uint32_t head __attribute__((aligned(64)));
+	uint32_t consumer_sleeps;
+	uint32_t producer_bell;
+};
+
+struct pipeline {
+	struct spsc parsed;    // reader -> evaluator
+	struct spsc evaluated; // evaluator -> writer
+	const char * name;
+	FILE * out;
+	struct command_state * cmd;
+	long errors; // of the writer
+	pthread_t evaluator;
+	pthread_t writer;
+};
+
+
+// wake up the other side if it sleeps (after the store of what it waits for)
+static void spsc_bell(uint32_t * sleeps, uint32_t * bell) {
+	if (__atomic_load_n(sleeps, __ATOMIC_SEQ_CST)) {
+		__atomic_add_fetch(bell, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, bell, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+	}
+}
+
+// sleep until `*word` isn't `value` any more (or the bell rings)
+static void spsc_sleep(uint32_t * sleeps, uint32_t * bell, const uint32_t * word, uint32_t value) {
+	for (int i = 0; i < BATCH_PIPELINE_SPIN; i++) {
+		if (__atomic_load_n(word, __ATOMIC_ACQUIRE) != value) {
+			return;
+		}
+	}
+	uint32_t ring = __atomic_load_n(bell, __ATOMIC_SEQ_CST);
+	__atomic_store_n(sleeps, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(word, __ATOMIC_SEQ_CST) == value) { // the other side sees `sleeps` from now
+		syscall(SYS_futex, bell, FUTEX_WAIT_PRIVATE, ring, NULL, NULL, 0);
+	}
+	__atomic_store_n(sleeps, 0, __ATOMIC_RELAXED);
+}
+
+// NULL is the end of the lines
+static void spsc_push(struct spsc * q, struct line * l) {
+	uint32_t tail = q->tail;
+	uint32_t head;
+	while (tail - (head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) == BATCH_PIPELINE_DEPTH) {
+		spsc_sleep(&q->producer_sleeps, &q->producer_bell, &q->head, head);
+	}
+	q->slot[tail % BATCH_PIPELINE_DEPTH] = l;
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_SEQ_CST);
+	spsc_bell(&q->consumer_sleeps, &q->consumer_bell);
+}
+
+static struct line * spsc_pop(struct spsc * q) {
+	uint32_t head = q->head;
+	while (__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == head) {
+		spsc_sleep(&q->consumer_sleeps, &q->consumer_bell, &q->tail, head);
+	}
+	struct line * l = q->slot[head % BATCH_PIPELINE_DEPTH];
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_SEQ_CST);
+	spsc_bell(&q->producer_sleeps, &q->producer_bell);
+	return l;
+}
+
+static void line_error(struct calc_ctx * ctx, struct line * l, const char * name) {
+	FILE * out = open_memstream(&l->reply, &l->reply_len);
+	CHECK_MALLOC(out, "batch error");
+	batch_error(ctx, l->text, name, l->line_nb, out);
+	fclose(out);
+	l->res = -1;
+}
+
+static void * pipeline_evaluator(void * arg) {
+	struct pipeline * p = arg;
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "batch context");
+
+	struct line * l;
+	while ((l = spsc_pop(&p->parsed)) != NULL) {
+		if (l->res == LINE_COMMAND) {
+			FILE * out = open_memstream(&l->reply, &l->reply_len);
+			CHECK_MALLOC(out, "batch command");
+			l->res = (batch_line(ctx, p->cmd, l->text, p->name, l->line_nb, out) ? -1 : 0);
+			fclose(out);
+			ctx_error_reset(ctx); // `eval` doesn't reset it for the next line
+		}
+		else if (l->res > 0) {
+			l->result = eval(ctx, l->e);
+			token_free_expr(&l->e);
+			if (ctx_error(ctx)) {
+				number_free(l->result);
+				line_error(ctx, l, p->name);
+			}
+		}
+		spsc_push(&p->evaluated, l);
+	}
+	spsc_push(&p->evaluated, NULL);
+	ctx_free(ctx);
+	return NULL;
+}
+
+static void * pipeline_writer(void * arg) {
+	struct pipeline * p = arg;
+
+	struct line * l;
+	while ((l = spsc_pop(&p->evaluated)) != NULL) {
+		if (l->reply != NULL) {
+			fwrite(l->reply, 1, l->reply_len, p->out);
+			free(l->reply);
+			p->errors += (l->res < 0);
+		}
+		else {
+			if (l->res > 0) {
+				number_fprint(p->out, &l->result);
+				number_free(l->result);
+			}
+			fputc('\n', p->out);
+		}
+		LOG_FREE(l);
+		free(l);
+	}
+	return NULL;
+}
+
+// lex and parse a line (`len` bytes, without '\n'), then give it to the evaluator
+static void pipeline_push(struct pipeline * p, struct calc_ctx * ctx, const char * text, size_t len, long line_nb, int in_place) {
+
+	struct line * l = malloc(sizeof(struct line) + (in_place ? 0 : len + 1));
+	CHECK_MALLOC(l, "batch line");
+	l->text = text;
+	if (!in_place) {
+		memcpy(l->copy, text, len);
+		l->copy[len] = '\0';
+		l->text = l->copy;
+	}
+	l->line_nb = line_nb;
+	l->reply   = NULL;
+	if (command_is(l->text)) { // run by the evaluator
+		l->res = LINE_COMMAND;
+	}
+	else if ((l->res = eval_parse(ctx, l->text, &l->e)) < 0) {
+		line_error(ctx, l, p->name);
+	}
+	spsc_push(&p->parsed, l);
+}
+
+static struct pipeline * pipeline_start(const char * name, FILE * out, struct command_state * cmd) {
+
+	struct pipeline * p = malloc(sizeof(struct pipeline));
+	CHECK_MALLOC(p, "batch pipeline");
+	memset(p, 0, sizeof(struct pipeline));
+	p->name = name;
+	p->out  = out;
+	p->cmd  = cmd;
+	if ((pthread_create(&p->evaluator, NULL, pipeline_evaluator, p) != 0)
+		|| (pthread_create(&p->writer, NULL, pipeline_writer, p) != 0)) {
+		log_error("batch: can't start the pipeline threads");
+		exit(1);
+	}
+	log_info("batch: pipeline of 3 threads");
+	return p;
+}
+
+// wait for every line, return the number of errors
+static long pipeline_stop(struct pipeline * p) {
+
+	spsc_push(&p->parsed, NULL);
+	pthread_join(p->evaluator, NULL);
+	pthread_join(p->writer, NULL);
+	long errors = p->errors;
+	LOG_FREE(p);
+	free(p);
+	return errors;
+}
+
+
+
+/*
+	BATCH
+*/
+
+struct reader {
+	struct calc_ctx * ctx;
+	const char * name;
+	FILE * out;
+	struct command_state * cmd;
+	long line_nb; // of the next line
+	long errors;
+	struct pool * pool; // NULL to evaluate in the reader (with `ctx`)
+	struct pipeline * pipeline; // or to parse in the reader (with `ctx`)
+	int in_place; // the text stays valid until `reader_stop` (mapped file), no copy
+	int threads;
+};
+
+static void reader_start(struct reader * r, const char * name, FILE * out, int threads, struct command_state * cmd) {
+
+	r->ctx  = NULL;
+	r->name = name;
+	r->out  = out;
+	r->cmd  = cmd;
+	r->line_nb  = 1;
+	r->errors   = 0;
+	r->pool     = NULL;
+	r->pipeline = NULL;
+	r->in_place = 0;
+	r->threads  = threads;
+	if (threads >= BATCH_POOL_THREADS) {
+		r->pool = pool_start(threads, name, out, cmd);
+		return;
+	}
+	r->ctx = ctx_new();
+	CHECK_MALLOC(r->ctx, "batch context");
+	if (threads > 1) {
+		r->pipeline = pipeline_start(name, out, cmd);
+	}
+}
+
+// wait for every line
+static void reader_stop(struct reader * r) {
+
+	if (r->pool != NULL) {
+		r->errors += pool_stop(r->pool);
+		return;
+	}
+	if (r->pipeline != NULL) {
+		r->errors += pipeline_stop(r->pipeline);
+	}
+	ctx_free(r->ctx);
+}
+
+// a chunk with a `:prepare`: evaluated in the reader after the chunks before it
+// and before the ones after it, which may run the prepared expression
+static void reader_in_order(struct reader * r, const char * text, size_t len) {
+
+	long line_nb = r->line_nb;
+	int in_place = r->in_place;
+	reader_stop(r);
+	long errors  = r->errors; // with the ones of the workers
+
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "batch context");
+	errors += batch_lines(ctx, r->cmd, text, len, r->name, line_nb, r->out);
+	ctx_free(ctx);
+
+	reader_start(r, r->name, r->out, r->threads, r->cmd);
+	r->line_nb  = line_nb + count_lines(text, len);
+	r->errors   = errors;
+	r->in_place = in_place;
+}
+
+// evaluate (or dispatch) a region of complete lines
+static void reader_lines(struct reader * r, const char * text, size_t len) {
+
+	if (r->pipeline != NULL) {
+		const char * end = text + len;
+		while (text < end) {
+			const char * nl = memchr(text, '\n', end - text);
+			pipeline_push(r->pipeline, r->ctx, text, nl - text, r->line_nb++, r->in_place);
+			text = nl + 1;
+		}
+		return;
+	}
+	if (r->pool == NULL) {
+		long n = count_lines(text, len);
+		r->errors += batch_lines(r->ctx, r->cmd, text, len, r->name, r->line_nb, r->out);
+		r->line_nb += n;
+		return;
+	}
+
+	size_t pos = 0;
+	while (pos < len) {
+		size_t end = pos + BATCH_CHUNK_SIZE;
+		if (end >= len) {
+			end = len;
+		}
+		else { // up to the end of the line
+			end = (const char *) memchr(text + end - 1, '\n', len - end + 1) - text + 1;
+		}
+		if (memmem(text + pos, end - pos, COMMAND_PREPARE, strlen(COMMAND_PREPARE)) != NULL) {
+			reader_in_order(r, text + pos, end - pos);
+		}
+		else {
+			pool_push(r->pool, text + pos, end - pos, r->line_nb, r->in_place);
+			r->line_nb += count_lines(text + pos, end - pos);
+		}
+		pos = end;
+	}
+}
+
+
+// the line at the start of `buf` (`fill` bytes, without '\n') is longer than the
+// buffer: it is streamed (see `stream.h`) with the rest of it read in `buf`,
+// then evaluated in the reader after the lines before it
+// return the bytes of `buf` read after its '\n'
+static size_t reader_long_line(struct reader * r, char * buf, size_t fill, size_t cap, FILE * in) {
+
+	long line_nb = r->line_nb;
+	long errors  = r->errors;
+	reader_stop(r);
+	log_info("batch: line %ld streamed", line_nb);
+
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "batch context");
+	struct stream s;
+	if (stream_init(&s) < 0) {
+		CHECK_MALLOC(NULL, "batch stream");
+	}
+	size_t n = fill;
+	size_t used = stream_feed(ctx, &s, buf, n);
+	while (!s.done) {
+		n = fread(buf, 1, cap, in);
+		if (n == 0) { // the last line, without '\n'
+			stream_close(ctx, &s);
+			used = 0;
+			break;
+		}
+		used = stream_feed(ctx, &s, buf, n);
+	}
+
+	if (stream_check(ctx, &s) < 0) {
+		batch_error(ctx, s.text, r->name, line_nb, r->out);
+		errors++;
+	}
+	else {
+		errors += batch_line(ctx, r->cmd, s.text, r->name, line_nb, r->out);
+	}
+	stream_reset(ctx, &s);
+	stream_free(&s);
+	ctx_free(ctx);
+
+	reader_start(r, r->name, r->out, r->threads, r->cmd);
+	r->line_nb = line_nb + 1;
+	r->errors  = errors;
+	memmove(buf, buf + used, n - used);
+	return n - used;
+}
+
+
+// evaluate the lines of a regular file from its position, mapped in memory: the
+// lines are lexed in place and the tokens point in the mapping (no copy)
+// return -1 if the file can't be mapped
+static long batch_mapped(FILE * in, const char * name, FILE * out, int threads, struct command_state * cmd) {
+
+	struct stat st;
+	int fd = fileno(in);
+	off_t pos = ftello(in);
+	if ((fd < 0) || (pos < 0) || (fstat(fd, &st) < 0) || !S_ISREG(st.st_mode) || (st.st_size <= pos)) {
+		return -1;
+	}
+	char * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		log_info("batch: can't map '%s': %s", name, strerror(errno));
+		return -1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	const char * text = map + pos;
+	size_t len = st.st_size - pos;
+
+	struct reader r;
+	reader_start(&r, name, out, threads, cmd);
+	r.in_place = 1;
+
+	size_t end = len; // the lines with their '\n'
+	while ((end > 0) && (text[end - 1] != '\n')) {
+		end--;
+	}
+	reader_lines(&r, text, end);
+
+	char * last = NULL; // without '\n', the lexer would read past the mapping
+	if (end < len) {
+		last = malloc(len - end + 1);
+		CHECK_MALLOC(last, "batch last line");
+		memcpy(last, text + end, len - end);
+		last[len - end] = '\n';
+		r.in_place = 0;
+		reader_lines(&r, last, len - end + 1);
+	}
+	reader_stop(&r);
+	LOG_FREE(last);
+	free(last);
+	munmap(map, st.st_size);
+	fseeko(in, 0, SEEK_END);
+	log_info("batch '%s' (mapped): %ld lines, %ld errors", name, r.line_nb - 1, r.errors);
+	return r.errors;
+}
+
+
+long batch(FILE * in, const char * name, FILE * out, int threads, struct command_state * cmd) {
+
+	long mapped = batch_mapped(in, name, out, threads, cmd);
+	if (mapped >= 0) {
+		return mapped;
+	}
+	struct reader r;
+	reader_start(&r, name, out, threads, cmd);
+
+	const size_t cap = BATCH_BLOCK_SIZE;
+	char * buf = malloc(cap + 1); // + 1 for a '\n' after the last line
+	CHECK_MALLOC(buf, "batch buffer");
+	size_t fill = 0; // bytes in `buf`
+
+	while (1) {
+		if (fill == cap) { // a line longer than the buffer, never kept as a whole
+			fill = reader_long_line(&r, buf, fill, cap, in);
+		}
+		size_t n = fread(buf + fill, 1, cap - fill, in);
+		fill += n;
+		if ((n == 0) && (fill > 0)) { // end of file, the last line may have no '\n'
+			if (buf[fill - 1] != '\n') {
+				buf[fill++] = '\n';
+			}
+		}
+
+		// every complete line of the block
+		size_t end = fill;
+		while ((end > 0) && (buf[end - 1] != '\n')) {
+			end--;
+		}
+		if (end > 0) {
+			reader_lines(&r, buf, end);
+		}
+
+		if (n == 0) {
+			break;
+		}
+		memmove(buf, buf + end, fill - end);
+		fill -= end;
+	}
+	reader_stop(&r);
+	if (ferror(in)) {
+		log_error("batch: read error on '%s'", name);
+		r.errors++;
+	}
+	log_info("batch '%s': %ld lines, %ld errors", name, r.line_nb - 1, r.errors);
+	LOG_FREE(buf);
+	free(buf);
+	return r.errors;
+}
+
+
+long batch_files(const struct session * s, int n, char * const files[], int threads) {
+
+	if (threads <= 0) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	setvbuf(stdout, NULL, _IOFBF, BATCH_BLOCK_SIZE);
+	struct command_state cmd; // the prepared expressions stay from a file to the next one
+	command_state_init(&cmd, s);
+
+	if (n == 0) {
+		long errors = batch(stdin, "-", stdout, threads, &cmd);
+		fflush(stdout);
+		command_state_free(&cmd);
+		return errors;
+	}
+
+	long errors = 0;
+	for (int i = 0; i < n; i++) {
+		FILE * in = fopen(files[i], "r");
+		if (in == NULL) {
+			fflush(stdout);
+			fprintf(stderr, "error %s: ", files[i]);
+			perror(NULL);
+			errors++;
+			continue;
+		}
+		errors += batch(in, files[i], stdout, threads, &cmd);
+		fclose(in);
+	}
+	fflush(stdout);
+	command_state_free(&cmd);
+	return errors;
+}
+
+
+
+/*
+	TEST
+*/
+
+
+// output of `batch` on `input` in `res`, read from a mapped file or a stream
+static long batch_in(const char * input, char * res, int size, int threads, int mapped) {
+
+	FILE * in  = (mapped ? tmpfile() : fmemopen((void *) input, strlen(input), "r"));
+	FILE * out = tmpfile();
+	assert((in != NULL) && (out != NULL));
+	if (mapped) {
+		fputs(input, in);
+		rewind(in);
+	}
+
+	struct session session;
+	session_init(&session);
+	struct command_state cmd;
+	command_state_init(&cmd, &session);
+	long errors = batch(in, "t", out, threads, &cmd);
+	command_state_free(&cmd);
+	session_free(&session);
+
+	rewind(out);
+	size_t n = fread(res, 1, size - 1, out);
+	res[n] = '\0';
+	fclose(in);
+	fclose(out);
+	return errors;
+}
+
+static long batch_str(const char * input, char * res, int size, int threads) {
+	return batch_in(input, res, size, threads, 0);
+}
+
+void test_batch() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("BATCH:\n");
+	char res[512];
+
+
+	printf(" results\n");
+	assert(batch_str("1 + 2\n-31\n\n2 ^ 64\n", res, sizeof(res), 1) == 0);
+	assert(strcmp(res, "0x3\n-0x1f\n\n0x10000000000000000\n") == 0);
+
+	assert(batch_str("3 * 4", res, sizeof(res), 1) == 0); // no '\n' at the end
+	assert(strcmp(res, "0xc\n") == 0);
+
+
+	printf(" errors\n");
+	assert(batch_str("1 +\n2 # 3\n(4\n5\n", res, sizeof(res), 1) == 3);
+	assert(strncmp(res, "error t:1:", 10) == 0);
+	char * line = strchr(res, '\n') + 1;
+	assert(strncmp(line, "error t:2:3: Lexer: Unknown symbol '#'\n", 39) == 0);
+	line = strchr(line, '\n') + 1;
+	assert(strncmp(line, "error t:3:", 10) == 0);
+	line = strchr(line, '\n') + 1;
+	assert(strcmp(line, "0x5\n") == 0);
+
+
+	printf(" long lines\n");
+	int len = BATCH_BLOCK_SIZE + BATCH_BLOCK_SIZE / 2; // longer than the buffer
+	char * input = malloc(len + 1);
+	CHECK_MALLOC(input, "test batch");
+	memset(input, ' ', len);
+	memcpy(&input[len - 6], "1 + 2\n", 6);
+	input[len] = '\0';
+	assert(batch_str(input, res, sizeof(res), 1) == 0);
+	assert(strcmp(res, "0x3\n") == 0);
+
+	int w = sprintf(input, "6 * 7\n0x1"); // a literal streamed between lines of the workers
+	memset(input + w, '0', len - w - 20);
+	sprintf(input + len - 20, " * 0 + 5\n1 + 2");
+	assert(batch_str(input, res, sizeof(res), 4) == 0);
+	assert(strcmp(res, "0x2a\n0x5\n0x3\n") == 0);
+	LOG_FREE(input);
+	free(input);
+
+
+	printf(" worker threads\n");
+	int lines = 20000; // several chunks
+	len = lines * 32;
+	input = malloc(len);
+	char * serial   = malloc(2 * len);
+	char * parallel = malloc(2 * len);
+	assert((input != NULL) && (serial != NULL) && (parallel != NULL));
+	w = 0;
+	for (int i = 0; i < lines; i++) {
+		if (i % 7 == 0) {
+			w += sprintf(&input[w], "%d + # %d\n", i, i); // error
+		} else {
+			w += sprintf(&input[w], "-%d ^ %d * 3\n", i, i % 20);
+		}
+	}
+	long errors = batch_str(input, serial, 2 * len, 1);
+	assert(errors == (lines + 6) / 7);
+	assert(batch_str(input, parallel, 2 * len, 4) == errors);
+	assert(strcmp(serial, parallel) == 0);
+
+
+	printf(" mapped file\n");
+	for (int threads = 1; threads <= 4; threads++) {
+		assert(batch_in(input, parallel, 2 * len, threads, 1) == errors);
+		assert(strcmp(serial, parallel) == 0);
+	}
+	assert(batch_in("1 + 2\n-31\n\n2 ^ 64", res, sizeof(res), 1, 1) == 0); // no '\n' at the end
+	assert(strcmp(res, "0x3\n-0x1f\n\n0x10000000000000000\n") == 0);
+	assert(batch_in("1 +\n2 # 3\n", res, sizeof(res), 1, 1) == 2);
+	assert(strncmp(strchr(res, '\n') + 1, "error t:2:3: Lexer: Unknown symbol '#'\n", 39) == 0);
+
+
+	printf(" pipeline\n");
+	assert(batch_str(input, parallel, 2 * len, 2) == errors);
+	assert(strcmp(serial, parallel) == 0);
+	assert(batch_str("1 +\n\n3 ^ 3000\n2 # 3", parallel, 2 * len, 3) == 2);
+	assert(batch_str("1 +\n\n3 ^ 3000\n2 # 3", serial, 2 * len, 1) == 2);
+	assert(strcmp(serial, parallel) == 0);
+	free(input);
+	free(serial);
+	free(parallel);
+
+
+	printf(" commands\n");
+	char path[64];
+	char text[256];
+	char expected[256];
+	char content[64];
+	snprintf(path, sizeof(path), "/tmp/calcul-batch-%d.txt", (int) getpid());
+	snprintf(text, sizeof(text), "1 + 1\n" COMMAND_WRITE " %s 16 2 ^ 64\n" COMMAND_WRITE " %s 10 1\n2", path, path);
+	snprintf(expected, sizeof(expected), "0x2\nwrote 20 bytes in '%s'\nerror t:3:", path);
+	for (int threads = 1; threads <= 4; threads++) {
+		unlink(path);
+		assert(batch_str(text, res, sizeof(res), threads) == 1);
+		assert(strncmp(res, expected, strlen(expected)) == 0);
+		assert(strcmp(res + strlen(res) - 5, "\n0x2\n") == 0);
+		FILE * file = fopen(path, "r");
+		assert((file != NULL) && (fgets(content, sizeof(content), file) != NULL));
+		assert(strcmp(content, "0x10000000000000000\n") == 0);
+		fclose(file);
+	}
+	snprintf(text, sizeof(text), COMMAND_SNAPSHOT " %s\n1", path);
+	for (int threads = 1; threads <= 4; threads++) {
+		unlink(path);
+		assert(batch_str(text, res, sizeof(res), threads) == 0);
+		assert((strncmp(res, "snapshot of ", 12) == 0) && (strcmp(res + strlen(res) - 6, "'\n0x1\n") == 0));
+	}
+	unlink(path);
+
+	lines = 3 * BATCH_CHUNK_SIZE / 2; // the runs in several chunks, before and after a `:prepare`
+	input    = malloc(lines * 16);
+	serial   = malloc(lines * 32);
+	parallel = malloc(lines * 32);
+	assert((input != NULL) && (serial != NULL) && (parallel != NULL));
+	w = sprintf(input, COMMAND_RUN " sq\n" COMMAND_PREPARE " sq 7 ^ 2\n");
+	for (int i = 0; i < lines; i++) {
+		if (i == lines / 2) {
+			w += sprintf(&input[w], COMMAND_PREPARE " sq -3\n");
+		}
+		w += sprintf(&input[w], (i % 1000 == 0 ? COMMAND_RUN " sq\n" : "%d\n"), i % 10);
+	}
+	assert(batch_str(input, serial, lines * 32, 1) == 1); // not prepared yet
+	const char * head = "error t:1:6: Command: no expression prepared as 'sq'\nprepared 'sq' in 3 instructions\n0x31\n";
+	assert(strncmp(serial, head, strlen(head)) == 0);
+	assert(strstr(serial, "\n-0x3\n") != NULL);
+	for (int threads = 2; threads <= 4; threads++) {
+		assert(batch_str(input, parallel, lines * 32, threads) == 1);
+		assert(strcmp(serial, parallel) == 0);
+		assert(batch_in(input, parallel, lines * 32, threads, 1) == 1);
+		assert(strcmp(serial, parallel) == 0);
+	}
+	free(input);
+	free(serial);
+	free(parallel);
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,54 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+#include "session.h"
+#include "stream.h"
+
+
+/*
+	Non-interactive evaluation
+
+Every line of the input is an expression. The input is read by blocks of
+`BATCH_BLOCK_SIZE` bytes and the output is fully buffered. Line `n` of the
+output is the result of line `n` of the input, in hexadecimal:
+
+	0x2a
+	-0x1f
+	                                (empty line)
+	error <file>:<line>:<column>: <message>
+
+The column starts at 1 (0 when the error has no position).
+
+With several threads, the lines are evaluated by chunks on a pool of workers
+and the results are written back in the input order. With 2 or 3 threads, the
+parsing, the evaluation and the writing of the lines run in a pipeline instead.
+*/
+
+
+// evaluate the lines of `in` (called `name` in the errors) to `out` on `threads` threads,
+// the commands share `cmd`
+// return the number of errors
+long batch(FILE * in, const char * name, FILE * out, int threads, struct command_state * cmd);
+
+// evaluate the files (stdin if `n` is 0) to stdout, `:snapshot` saves the configuration of `s`
+// `threads` 0 is one thread per core
+// return the number of errors (unreadable files included)
+long batch_files(const struct session * s, int n, char * const files[], int threads);
+
+
+void test_batch();
+
+
+#endif // BATCH_H
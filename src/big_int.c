@@ -1,7 +1,19 @@
+#define _POSIX_C_SOURCE 200809L // open, pread, O_CLOEXEC
 #include "big_int.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #define BASE 256
 #define LONG_SIZE 16
+#define MUL_BLOCK 1024 // bytes per block in `mul_blocked`
+#define CONV_BLOCK (1 << 16) // digits of a power of 2 between two checks
+#define CONV_MULT_MAX ((1U << 31) - 1) // of a step of Horner, the products by a word fit in 64 bits
+#define SAVE_MAGIC "calcul\0b" // 8 bytes
+#define SAVE_VERSION 1
 
 
 struct big_int {
@@ -14,17 +26,31 @@ struct big_int {
 	} sign;
 };
 
+// header of a file of `big_int_save` (integers in the byte order of the host)
+struct big_int_file {
+	char magic[8];     // `SAVE_MAGIC`
+	uint32_t version;  // `SAVE_VERSION`
+	uint32_t negative;
+	uint64_t len;      // of the bytes of the absolute value (little endian)
+	uint64_t checksum; // of the bytes
+	uint64_t offset;   // of the bytes in the file
+};
+
 static const unsigned char one_bin [] = {1};
 static const unsigned char zero_bin[] = {0};
 static const struct big_int BIG_ONE  = {(unsigned char *)  one_bin, 1, 1, POSITIVE};
 static const struct big_int BIG_ZERO = {(unsigned char *) zero_bin, 1, 1, POSITIVE};
 
 
-// malloc a valid zero
+// malloc a valid zero, return NULL (and set the error) on failure
 static struct big_int * malloc_big_int(int cap) {
 
-	struct big_int * big = malloc(sizeof(struct big_int) + (sizeof(char) * cap));
-	CHECK_MALLOC(big, "malloc_big_int");
+	// huge big_int are mapped directly from the OS (see alloc.h)
+	struct big_int * big = alloc_malloc(sizeof(struct big_int) + (sizeof(char) * cap));
+	log_trace("malloc %p: %s", big, "malloc_big_int");
+	if (big == NULL) {
+		return NULL;
+	}
 
 	big->bin  = (unsigned char *) &big[1];
 	big->sign = POSITIVE;
@@ -35,16 +61,32 @@ static struct big_int * malloc_big_int(int cap) {
 	return big;
 }
 
+// the length of a big_int is an int: a result over `INT_MAX` bytes (2 GiB) is `TOO_BIG`
+// return 1 if `len` bytes fit, 0 (and set the error) otherwise
+static int length_fits(long len) {
+	if (len > INT_MAX) {
+		log_warn("big_int of %ld bytes, over the 2 GiB of an int length", len);
+		error_set(TOO_BIG, NULL, NULL, 0);
+		return 0;
+	}
+	return 1;
+}
+
+// on failure, `big` is unchanged (its capacity is still < `cap`) and the error is set
 static struct big_int * extend_capacity(struct big_int * big, int cap) {
 	if (big->cap >= cap) {
 		return big;
 	}
 
 	struct big_int save = *big;
-	int new_cap = ((2 * big->cap) > cap ? (2 * big->cap) : cap); // max(2 * big->cap, cap)
+	long twice = 2 * (long) big->cap;
+	int new_cap = (twice > cap ? (twice < INT_MAX ? (int) twice : INT_MAX) : cap); // max(2 * big->cap, cap)
 
-	struct big_int * new = realloc(big, sizeof(struct big_int) + new_cap);
-	CHECK_MALLOC(new, "extend_capacity");
+	struct big_int * new = alloc_realloc(big, sizeof(struct big_int) + new_cap); // no copy on huge big_int
+	log_trace("malloc %p: %s", new, "extend_capacity");
+	if (new == NULL) {
+		return big;
+	}
 
 	new->bin  = (unsigned char *) &new[1];
 	new->sign = save.sign;
@@ -56,48 +98,12 @@ static struct big_int * extend_capacity(struct big_int * big, int cap) {
 	return new;
 }
 
-// num is a `len` long array of digit (base `base`)
-// return the new size of the number represented in `num`
-static int digit_div_2(int len, unsigned char * num, unsigned int base) {
-	assert(base <= BASE);
-	unsigned short rem = 0;
-
-	for (int i = len - 1; i >= 0; i--) {
-		rem = (unsigned short) num[i] + rem;
-		num[i] = (unsigned char) (rem / 2);
-		rem = ((rem % 2) ? base : 0);
-	}
-	return (num[len - 1] ? len : len - 1); // new size
-}
-
-static struct big_int * digit_to_big_int(int len, unsigned char * num, unsigned int base) {
-
-	struct big_int * big = malloc_big_int(len);
-	int i = 0;
-
-	do {
-		unsigned char tmp = 0;
-
-		for (int j = 0; j < 8; j++) {
-
-			if (num[0] % 2) { 
-				tmp ^= (1 << j); // num is even
-			}
-			len = digit_div_2(len, num, base);
-			if (len == 0) { // num is zero
-				break;
-			}
-		}
-		big->bin[i] = tmp;
-		i++;
-		assert(i <= big->cap);
-
-	} while (len > 0);
-
-	big->len = i;
-	return big;
+// stop a cancelled kernel with a valid (meaningless) number of `len` bytes
+static void kernel_stop(struct big_int * b, int len) {
+	b->len = (len > 0 ? len : 1);
 }
 
+// swap the numbers, each capacity stays with its own allocation
 static void big_swap(struct big_int * b1, struct big_int * b2) {
 	assert(b1->len <= b2->cap);
 	assert(b2->len <= b1->cap);
@@ -116,11 +122,9 @@ static void big_swap(struct big_int * b1, struct big_int * b2) {
 	}
 
 	b1->len  = b2->len;
-	b1->cap  = b2->cap;
 	b1->sign = b2->sign;
 
 	b2->len  = b1save.len;
-	b2->cap  = b1save.cap;
 	b2->sign = b1save.sign;
 }
 
@@ -129,6 +133,9 @@ static void big_swap(struct big_int * b1, struct big_int * b2) {
 struct big_int * long_to_big(long l) {
 
 	struct big_int * big = malloc_big_int(LONG_SIZE); // that's long enough
+	if (big == NULL) {
+		return NULL;
+	}
 	unsigned long num;
 
 	if (l < 0) {
@@ -150,6 +157,18 @@ struct big_int * long_to_big(long l) {
 	return big;
 }
 
+struct big_int * big_int_copy(const struct big_int * b) {
+
+	struct big_int * big = malloc_big_int(b->len);
+	if (big == NULL) {
+		return NULL;
+	}
+	memcpy(big->bin, b->bin, b->len);
+	big->len  = b->len;
+	big->sign = b->sign;
+	return big;
+}
+
 static int char_to_digit(char c) {
 	if (isdigit(c)) {
 		return (c - '0');
@@ -159,28 +178,209 @@ static int char_to_digit(char c) {
 	return 10 + (c - 'a');
 }
 
-struct big_int * str_to_big(int len, const char * str, unsigned int base) {
-	assert(len  > 0);
-	assert(base > 1);
-
-	unsigned char * digit = malloc(sizeof(unsigned char) * len);
-	CHECK_MALLOC(digit, "str_to_big");
+int big_int_conv_begin(struct big_int_conv * c, unsigned int base, long total) {
+	assert((1 <= base) && (base <= 16));
+
+	c->base   = base;
+	c->bits   = ((base & (base - 1)) == 0 ? __builtin_ctz(base) : 0); // 0 for the base 1 too
+	c->mult   = 1;
+	c->group  = 0;
+	c->acc    = 0;
+	c->acc_bits = 0;
+	c->bytes  = 0;
+	c->digits = 0;
+	c->total  = total;
+	c->big    = NULL;
+	if (base == 1) { // only counted
+		return 0;
+	}
+	while ((c->bits == 0) && ((uint64_t) c->mult * base <= CONV_MULT_MAX)) { // digits of a step of Horner
+		c->mult *= base;
+		c->group++;
+	}
+	double bytes = total * log2(base) / 8;
+	if (bytes >= INT_MAX) {
+		error_set(TOO_BIG, NULL, NULL, 0);
+		return -1;
+	}
+	int cap = (total > 0 ? (int) bytes + 1 : LONG_SIZE); // the bytes of the value
+	c->big = malloc_big_int(cap);
+	return (c->big != NULL ? 0 : -1);
+}
 
+// bits of a power of 2: the bytes come from the most significant, in order (reversed by the end)
+static int conv_bits(struct big_int_conv * c, const char * digits, int len) {
 	for (int i = 0; i < len; i++) {
-		digit[i] = char_to_digit(str[len - i - 1]);
+		c->acc = (c->acc << c->bits) | char_to_digit(digits[i]);
+		c->acc_bits += c->bits;
+		if (c->acc_bits < 8) {
+			continue;
+		}
+		c->acc_bits -= 8;
+		if (c->bytes == c->big->cap) {
+			struct big_int * big = extend_capacity(c->big, c->bytes + 1);
+			if (big->cap == c->bytes) { // no memory
+				return -1;
+			}
+			c->big = big;
+		}
+		c->big->bin[c->bytes++] = (unsigned char) (c->acc >> c->acc_bits);
+		c->acc &= (1U << c->acc_bits) - 1;
+	}
+	return 0;
+}
+
+// big = big * mult + add, by words of 32 bits (`mult` < 2^31 so the products fit)
+static int conv_mul_add(struct big_int_conv * c, uint32_t mult, uint32_t add) {
+	unsigned char * bin = c->big->bin;
+	uint64_t carry = add;
+	int i = 0;
+	for (; i + 4 <= c->bytes; i += 4) {
+		uint64_t w = (uint32_t) bin[i] | ((uint32_t) bin[i + 1] << 8) | ((uint32_t) bin[i + 2] << 16) | ((uint32_t) bin[i + 3] << 24);
+		w = w * mult + carry;
+		bin[i]     = (unsigned char) w;
+		bin[i + 1] = (unsigned char) (w >> 8);
+		bin[i + 2] = (unsigned char) (w >> 16);
+		bin[i + 3] = (unsigned char) (w >> 24);
+		carry = w >> 32;
+	}
+	for (; i < c->bytes; i++) {
+		uint64_t w = (uint64_t) bin[i] * mult + carry;
+		bin[i] = (unsigned char) w;
+		carry = w >> 8;
+	}
+	while (carry > 0) {
+		if (c->bytes == c->big->cap) {
+			struct big_int * big = extend_capacity(c->big, c->bytes + 1);
+			if (big->cap == c->bytes) { // no memory
+				return -1;
+			}
+			c->big = big;
+		}
+		c->big->bin[c->bytes++] = (unsigned char) carry;
+		carry >>= 8;
+	}
+	return 0;
+}
+
+// Horner by groups of digits: one pass on the value for `group` digits
+static int conv_horner(struct big_int_conv * c, const char * digits, int len) {
+	int i = 0;
+	for (int step = 0; i < len; step++) {
+		if (CANCEL_POINT(step)) {
+			return -1;
+		}
+		uint32_t mult = 1;
+		uint32_t add  = 0;
+		for (int n = 0; (n < c->group) && (i < len); n++, i++) {
+			mult *= c->base;
+			add   = add * c->base + char_to_digit(digits[i]);
+		}
+		if (conv_mul_add(c, mult, add) < 0) {
+			return -1;
+		}
+		if (c->total > 0) {
+			progress_report("conversion", c->digits + i, c->total);
+		}
+	}
+	return 0;
+}
+
+int big_int_conv_digits(struct big_int_conv * c, const char * digits, int len) {
+	int res = 0;
+	if (c->base == 1) {
+		res = 0;
+	}
+	else if (c->bits > 0) {
+		for (int i = 0; (i < len) && (res == 0); i += CONV_BLOCK) { // checks between the blocks
+			if (cancel_check()) {
+				return -1;
+			}
+			if (c->total > 0) {
+				progress_report("conversion", c->digits + i, c->total);
+			}
+			res = conv_bits(c, digits + i, (len - i < CONV_BLOCK ? len - i : CONV_BLOCK));
+		}
+	}
+	else {
+		res = conv_horner(c, digits, len);
 	}
+	c->digits += len;
+	return res;
+}
 
-	struct big_int * big = digit_to_big_int(len, digit, base);
-	free(digit);
-	LOG_FREE(digit);
+struct big_int * big_int_conv_end(struct big_int_conv * c) {
+	assert(c->digits > 0);
+
+	if (c->base == 1) {
+		return long_to_big(c->digits);
+	}
+	struct big_int * big = c->big;
+	c->big = NULL;
+	int n = c->bytes;
+	if (c->bits > 0) { // the bytes from the most significant, then `acc_bits` bits
+		for (int i = 0; i < n / 2; i++) {
+			unsigned char tmp = big->bin[i];
+			big->bin[i] = big->bin[n - 1 - i];
+			big->bin[n - 1 - i] = tmp;
+		}
+		int r = c->acc_bits;
+		if (r > 0) {
+			big = extend_capacity(big, n + 1);
+			if (big->cap < n + 1) { // no memory
+				big_int_free(big);
+				return NULL;
+			}
+			unsigned carry = c->acc;
+			for (int i = 0; i < n; i++) { // shifted by `r` bits, `acc` in the lowest
+				unsigned v = ((unsigned) big->bin[i] << r) | carry;
+				big->bin[i] = (unsigned char) v;
+				carry = v >> 8;
+			}
+			big->bin[n++] = (unsigned char) carry;
+		}
+	}
+	while ((n > 1) && (big->bin[n - 1] == 0)) {
+		n--;
+	}
+	if (n == 0) {
+		big->bin[n++] = 0;
+	}
+	big->len = n;
 	return big;
 }
 
+void big_int_conv_free(struct big_int_conv * c) {
+	if (c->big != NULL) {
+		big_int_free(c->big);
+		c->big = NULL;
+	}
+}
+
+struct big_int * str_to_big(int len, const char * str, unsigned int base) {
+	assert(len  > 0);
+	assert(base > 1);
+
+	struct big_int_conv c;
+	if (big_int_conv_begin(&c, base, len) < 0) {
+		return NULL;
+	}
+	if (big_int_conv_digits(&c, str, len) < 0) {
+		big_int_conv_free(&c);
+		return NULL;
+	}
+	return big_int_conv_end(&c);
+}
+
 
 int big_int_length(const struct big_int * b) {
 	return b->len;
 }
 
+struct big_int * big_int_reserve(struct big_int * b, int cap) {
+	return extend_capacity(b, cap);
+}
+
 void big_int_neg(struct big_int * b) {
 	log_info("big -%p", b);
 	if ((b->len == 1) && (b->bin[0] == 0)) {
@@ -282,7 +482,14 @@ struct big_int * big_int_add(struct big_int * b1, struct big_int * b2) {
 	}
 	assert(b1->sign == b2->sign);
 
-	b1 = extend_capacity(b1, (b1->len < b2->len ? b2->len : b1->len) + 1);
+	if (!length_fits((long) (b1->len < b2->len ? b2->len : b1->len) + 1)) {
+		return b1;
+	}
+	int cap = (b1->len < b2->len ? b2->len : b1->len) + 1;
+	b1 = extend_capacity(b1, cap);
+	if (b1->cap < cap) { // no memory
+		return b1;
+	}
 	add_big(b1, b2);
 	return b1;
 }
@@ -361,7 +568,10 @@ struct big_int * big_int_sub(struct big_int * b1, struct big_int * b2) {
 	}
 
 	// b2 > b1
-	b1 = extend_capacity(b1, b2->cap);
+	b1 = extend_capacity(b1, b2->len);
+	if (b1->cap < b2->len) { // no memory
+		return b1;
+	}
 	big_swap(b1, b2);
 	sub_big(b1, b2);
 	b1->sign = NEGATIVE;
@@ -382,8 +592,14 @@ static void mul_big(struct big_int * b1, const struct big_int * b2) {
 	int w = 0;
 	long rem = 0;
 	int len = b2->len;
+	const int total = len + b1->len - 1; // bytes of the result (without the last carry)
 
 	for (int i = 0; i < len; i++) {
+		if (CANCEL_POINT(i)) {
+			kernel_stop(b1, w);
+			return;
+		}
+		PROGRESS_POINT("mul", w, total);
 		for (int j = i; j >= 0; j--) {
 			// printf("%d, %d\n", j, len + i - j);
 			rem += b2->bin[j] * b1->bin[len + i - j];
@@ -394,6 +610,11 @@ static void mul_big(struct big_int * b1, const struct big_int * b2) {
 	log_debug("big_int_sqr monitor long rem = %ld >= 0", rem);
 	assert(rem >= 0);
 	for (int i = 1; i < b1->len; i++) {
+		if (CANCEL_POINT(i)) {
+			kernel_stop(b1, w);
+			return;
+		}
+		PROGRESS_POINT("mul", w, total);
 		for (int j = i; j < len; j++) {
 			// printf("%d, %d\n", j, 2 * len - j + i - 1);
 			rem += b2->bin[j] * b1->bin[2 * len - j + i - 1];
@@ -408,6 +629,69 @@ static void mul_big(struct big_int * b1, const struct big_int * b2) {
 	b1->len = w;
 }
 
+// multiplication by blocks of `MUL_BLOCK` bytes for big_int spilled in a file (see alloc.h)
+// `mul_big` sweeps both operands for every byte of the result, here only 3 blocks are used at once
+// the result is a new big_int (without sign)
+static struct big_int * mul_blocked(const struct big_int * b1, const struct big_int * b2) {
+	log_info("big @%p * @%p by blocks", b1, b2);
+
+	if (!length_fits((long) b1->len + b2->len)) {
+		return NULL;
+	}
+	int len = b1->len + b2->len;
+	struct big_int * res = malloc_big_int(len);
+	if (res == NULL) {
+		return NULL;
+	}
+	if (!alloc_is_spilled(res)) { // a new scratch file is already zero
+		memset(res->bin, 0, len);
+	}
+	unsigned long acc[2 * MUL_BLOCK];
+
+	for (int i = 0; i < b1->len; i += MUL_BLOCK) {
+		int ni = (b1->len - i < MUL_BLOCK ? b1->len - i : MUL_BLOCK);
+
+		for (int j = 0; j < b2->len; j += MUL_BLOCK) {
+			int nj = (b2->len - j < MUL_BLOCK ? b2->len - j : MUL_BLOCK);
+			if (cancel_check()) {
+				big_int_free(res);
+				return NULL;
+			}
+			progress_report("mul", (long) i * b2->len + (long) j * ni, (long) b1->len * b2->len);
+
+			// product of the two blocks
+			memset(acc, 0, sizeof(unsigned long) * (ni + nj));
+			for (int k = 0; k < ni; k++) {
+				const unsigned long d = b1->bin[i + k];
+				for (int l = 0; l < nj; l++) {
+					acc[k + l] += d * b2->bin[j + l];
+				}
+			}
+
+			// accumulate it in the result
+			unsigned long rem = 0;
+			int w = i + j;
+			for (int k = 0; k < ni + nj; k++) {
+				rem += res->bin[w] + acc[k];
+				res->bin[w++] = (unsigned char) rem;
+				rem = rem >> 8;
+			}
+			while (rem > 0) {
+				assert(w < len);
+				rem += res->bin[w];
+				res->bin[w++] = (unsigned char) rem;
+				rem = rem >> 8;
+			}
+		}
+	}
+
+	while ((len > 1) && (res->bin[len - 1] == 0)) {
+		len--;
+	}
+	res->len = len;
+	return res;
+}
+
 struct big_int * big_int_mul(struct big_int * b1, struct big_int * b2) {
 	assert(b1 != b2);
 
@@ -420,9 +704,20 @@ struct big_int * big_int_mul(struct big_int * b1, struct big_int * b2) {
 		return b1;
 	}
 
+	// out of core, or in place over the length of an int (3 times the longer one)
+	long longer = (b1->len > b2->len ? b1->len : b2->len);
+	if (alloc_is_spilled(b1) || alloc_is_spilled(b2) || (3 * longer > INT_MAX)) {
+		struct big_int * res = mul_blocked(b1, b2);
+		if (res == NULL) { // no memory (or too big)
+			return b1;
+		}
+		res->sign = (b1->sign == b2->sign ? POSITIVE : NEGATIVE);
+		big_int_free(b1);
+		return res;
+	}
+
 	// check capacity
 	if (b1->len > b2->len) { // b1 is longer
-		printf("b1 len %d cap %d, b2 len %d cap %d\n", b1->len, b1->cap, b2->len, b2->cap);
 		if (b2->cap >= b1->len) { // b1 fit in b2
 			big_swap(b1, b2);
 			b1 = extend_capacity(b1, 2 * b2->len);
@@ -431,6 +726,9 @@ struct big_int * big_int_mul(struct big_int * b1, struct big_int * b2) {
 			// I don't want to extend b2 just for the swap
 			// I also need to extend b1 after. So I extend once b1 to fit b1 and b2
 			b1 = extend_capacity(b1, b1->len * 3);
+			if (b1->cap < b1->len * 3) { // no memory
+				return b1;
+			}
 			memcpy(&(b1->bin[2 * b1->len]), b1->bin, b1->len); 	// copy b1 further
 			memcpy(b1->bin, b2->bin, b2->len);					// copy b2 on b1
 
@@ -443,8 +741,10 @@ struct big_int * big_int_mul(struct big_int * b1, struct big_int * b2) {
 	} else {
 		b1 = extend_capacity(b1, 2 * b2->len);
 	}
+	if (b1->cap < 2 * b2->len) { // no memory
+		return b1;
+	}
 	assert(b1->len <= b2->len);
-	assert(b1->cap >= 2 * b2->len);
 	mul_big(b1, b2);
 	
 	// sign
@@ -458,9 +758,25 @@ struct big_int * big_int_sqr(struct big_int * b) {
 	// set sign
 	b->sign = POSITIVE;
 
+	if (!length_fits(2 * (long) b->len)) {
+		return b;
+	}
+	// out of core
+	if (alloc_is_spilled(b)) {
+		struct big_int * res = mul_blocked(b, b);
+		if (res == NULL) { // no memory
+			return b;
+		}
+		big_int_free(b);
+		return res;
+	}
+
 	// check capacity
 	int len = b->len;
 	b = extend_capacity(b, 2 * len);
+	if (b->cap < 2 * len) { // no memory
+		return b;
+	}
 
 	// shitf the number on the second half of bin
 	memcpy(&(b->bin[len]), b->bin, b->len);
@@ -468,8 +784,14 @@ struct big_int * big_int_sqr(struct big_int * b) {
 	int l = len; 			// lower cursor on the tmp num
 	int u = l + len - 1; 	// upper cursor
 	long rem = 0; 			// hoping a long is enough
+	const int total = 2 * len - 1;
 
 	for (int i = 0; i < len; i++) {
+		if (CANCEL_POINT(i)) {
+			kernel_stop(b, w);
+			return b;
+		}
+		PROGRESS_POINT("sqr", w, total);
 		for (int j = 0; j <= i; j++) {
 			// printf("%d, %d\n", l + j, l + i - j); // debug
 			rem += b->bin[l + j] * b->bin[l + i - j];
@@ -480,6 +802,11 @@ struct big_int * big_int_sqr(struct big_int * b) {
 	log_debug("big_int_sqr monitor long rem = %ld >= 0", rem);
 	assert(rem >= 0);
 	for (int i = len - 2; i >= 0; i--) {
+		if (CANCEL_POINT(i)) {
+			kernel_stop(b, w);
+			return b;
+		}
+		PROGRESS_POINT("sqr", w, total);
 		for (int j = 0; j <= i; j++) {
 			// printf("%d, %d\n", u - i + j, u - j); // debug
 			rem += b->bin[u - i + j] * b->bin[u - j];
@@ -495,6 +822,27 @@ struct big_int * big_int_sqr(struct big_int * b) {
 	return b;
 }
 
+// prod = prod * b, with prod shorter than b
+// on failure, prod is unchanged and the error is set
+static struct big_int * pow_mul(struct big_int * prod, const struct big_int * b) {
+	assert(prod->len <= b->len);
+
+	if (alloc_is_spilled(prod) || alloc_is_spilled(b) || (2 * (long) b->len > INT_MAX)) {
+		struct big_int * res = mul_blocked(prod, b);
+		if (res == NULL) {
+			return prod;
+		}
+		big_int_free(prod);
+		return res;
+	}
+	prod = extend_capacity(prod, 2 * b->len);
+	if (prod->cap < 2 * b->len) {
+		return prod;
+	}
+	mul_big(prod, b);
+	return prod;
+}
+
 struct big_int * big_int_pow(struct big_int * b, long expo) {
 	log_info("big @%p ^ %ld", b, expo);
 	assert(expo >= 0);
@@ -512,21 +860,36 @@ struct big_int * big_int_pow(struct big_int * b, long expo) {
 	if (expo == 2) {
 		return big_int_sqr(b);
 	}
+	if (!length_fits(2 * (long) b->len)) { // the square already
+		return b;
+	}
+
+	struct checkpoint cp;
+	checkpoint_begin(&cp, b, expo);
 
 	// check sign
 	b->sign = (expo % 2 ? NEGATIVE : POSITIVE);
 
-	// expoentiation by squaring
-	struct big_int * prod = malloc_big_int(b->cap * 2);
-	prod->bin[0] = 1;
+	// expoentiation by squaring (a reserved capacity of b is for the result)
+	const int bits = 8 * sizeof(long) - __builtin_clzl(expo); // scanned from the lowest
+	int bit = 0;
+	struct big_int * prod;
+	if (!checkpoint_take(&cp, &prod, &b, &expo, &bit)) {
+		prod = malloc_big_int(b->cap > 2 * b->len ? b->cap : 2 * b->len);
+		if (prod == NULL) { // no memory
+			checkpoint_end(&cp, 0);
+			return b;
+		}
+		prod->bin[0] = 1;
+	}
 
-	while (expo != 1) {
+	while ((expo != 1) && !error_get() && !cancel_check()) {
 		log_debug("big expo, b @%p, prod @%p, expo %ld", b, prod, expo);
+		checkpoint_step(&cp, prod, b, expo, bit);
+		progress_step("pow bit", bit++, bits);
 
 		if (expo % 2) { // odd
-			assert(prod->len <= b->len);
-			prod = extend_capacity(prod, 2 * b->len);
-			mul_big(prod, b);
+			prod = pow_mul(prod, b);
 			expo -= 1;
 			b = big_int_sqr(b);
 			expo /= 2;
@@ -536,11 +899,17 @@ struct big_int * big_int_pow(struct big_int * b, long expo) {
 			expo /= 2;
 		}
 	}
-	assert(expo == 1);
-	
-	assert(prod->len <= b->len);
-	prod = extend_capacity(prod, 2 * b->len);
-	mul_big(prod, b);
+	if (!error_get()) {
+		assert(expo == 1);
+		progress_step("pow bit", bit, bits);
+		prod = pow_mul(prod, b);
+	}
+	progress_step(NULL, 0, 0);
+	checkpoint_end(&cp, !error_get());
+	if (error_get()) { // no memory or cancelled, keep b
+		big_int_free(prod);
+		return b;
+	}
 	
 	big_int_free(b);
 	log_info("big expo in @%p", prod);
@@ -548,6 +917,57 @@ struct big_int * big_int_pow(struct big_int * b, long expo) {
 }
 
 
+struct big_int * big_int_shl(struct big_int * b, long bits) {
+	assert(bits >= 0);
+	if ((bits == 0) || ((b->len == 1) && (b->bin[0] == 0))) {
+		return b;
+	}
+	if (bits / 8 > INT_MAX - b->len - 1) { // the length is an int
+		error_set(TOO_BIG, NULL, NULL, 0);
+		return b;
+	}
+	int bytes = bits / 8;
+	int r = bits % 8;
+	int len = b->len + bytes + 1;
+	b = extend_capacity(b, len);
+	if (b->cap < len) { // no memory
+		return b;
+	}
+
+	// from the top, each byte takes the bits of two
+	b->bin[len - 1] = b->bin[b->len - 1] >> (8 - r);
+	for (int i = b->len - 1; i > 0; i--) {
+		b->bin[i + bytes] = (b->bin[i] << r) | (b->bin[i - 1] >> (8 - r));
+	}
+	b->bin[bytes] = b->bin[0] << r;
+	memset(b->bin, 0, bytes);
+
+	if (b->bin[len - 1] == 0) {
+		len--;
+	}
+	b->len = len;
+	return b;
+}
+
+struct big_int * big_int_pow10(struct big_int * b, long expo) {
+	assert(expo >= 0);
+	log_info("big @%p * 10 ^ %ld", b, expo);
+
+	struct big_int * five = long_to_big(5);
+	if (five == NULL) {
+		return b;
+	}
+	five = big_int_pow(five, expo);
+	if (!error_get()) {
+		b = big_int_mul(b, five);
+	}
+	big_int_free(five);
+	if (error_get()) {
+		return b;
+	}
+	return big_int_shl(b, expo);
+}
+
 
 // return LONG_MIN if big_int can't fit in an long
 long big_to_long(const struct big_int * big) {
@@ -571,23 +991,170 @@ long big_to_long(const struct big_int * big) {
 	return res;
 }
 
-void big_int_print(const struct big_int * const big) {
+int big_int_bytes(const struct big_int * big, const unsigned char ** bytes, int * len) {
+	*bytes = big->bin;
+	*len   = big->len;
+	return (big->sign == NEGATIVE);
+}
+
+void big_int_write(struct output * o, const struct big_int * const big) {
 	if (big->sign == NEGATIVE) {
-		printf("-");
+		output_char(o, '-');
 	}
-	printf("0x");
-	printf("%hhx", big->bin[big->len - 1]);
+	output_mem(o, "0x", 2);
+	output_hex_bytes(o, big->bin, big->len);
+}
 
-	for (int i = big->len - 2; i >= 0; i--) {
-		printf("%02hhx", big->bin[i]);
+void big_int_fprint(FILE * out, const struct big_int * const big) {
+	struct output o;
+	output_open(&o, out);
+	big_int_write(&o, big);
+	output_close(&o);
+}
+
+void big_int_print(const struct big_int * const big) {
+	big_int_fprint(stdout, big);
+}
+
+// offset of the bytes in a file: a mapping of the whole file is a block whose bytes are in place
+static size_t file_offset() {
+	return alloc_file_header() + sizeof(struct big_int);
+}
+
+// the sums depend on the order of the bytes, 8 of them at a time
+static uint64_t checksum(const unsigned char * bytes, size_t len) {
+	uint64_t a = 1;
+	uint64_t b = 0;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w;
+		memcpy(&w, &bytes[i], 8);
+		a += w;
+		b += a;
+	}
+	for (; i < len; i++) {
+		a += bytes[i];
+		b += a;
 	}
+	return a ^ ((b << 32) | (b >> 32));
+}
+
+uint64_t big_int_checksum(const struct big_int * big) {
+	return checksum(big->bin, big->len);
+}
+
+static int read_all(int fd, unsigned char * bytes, size_t len, off_t offset) {
+	while (len > 0) {
+		ssize_t n = pread(fd, bytes, len, offset);
+		if ((n < 0) && (errno == EINTR)) {
+			continue;
+		}
+		if (n <= 0) {
+			if (n == 0) { // shorter than its header says
+				errno = EILSEQ;
+			}
+			return -1;
+		}
+		bytes  += n;
+		len    -= n;
+		offset += n;
+	}
+	return 0;
+}
+
+long big_int_save(const struct big_int * big, int fd) {
+
+	struct big_int_file h;
+	assert(sizeof(h) <= file_offset());
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SAVE_MAGIC, sizeof(h.magic));
+	h.version  = SAVE_VERSION;
+	h.negative = (big->sign == NEGATIVE);
+	h.len      = big->len;
+	h.checksum = checksum(big->bin, big->len);
+	h.offset   = file_offset();
+
+	struct output o;
+	output_open_fd(&o, fd);
+	output_mem(&o, (const char *) &h, sizeof(h));
+	for (size_t i = sizeof(h); i < h.offset; i++) {
+		output_char(&o, '\0');
+	}
+	output_mem(&o, (const char *) big->bin, big->len);
+	return (output_close(&o) == 0 ? o.written : -1);
+}
+
+struct big_int * big_int_load(int fd, off_t offset) {
+
+	struct big_int_file h;
+	struct stat st;
+	if ((fstat(fd, &st) < 0) || (read_all(fd, (unsigned char *) &h, sizeof(h), offset) < 0)) {
+		return NULL;
+	}
+	if ((memcmp(h.magic, SAVE_MAGIC, sizeof(h.magic)) != 0) || (h.version != SAVE_VERSION)
+		|| (h.len == 0) || (h.len > INT_MAX) || (h.offset < sizeof(h))
+		|| ((uint64_t) st.st_size < (uint64_t) offset + h.offset + h.len)) {
+		log_warn("no saved big_int at %ld", (long) offset);
+		errno = EILSEQ;
+		return NULL;
+	}
+
+	struct big_int * big;
+	int mapped = 0;
+	if ((h.offset == file_offset()) && (h.len >= ALLOC_MAP_THRESHOLD) && (offset % sysconf(_SC_PAGESIZE) == 0)) { // used in place
+		mapped = 1;
+		big = alloc_map_file(fd, offset, sizeof(struct big_int) + h.len);
+		if (big != NULL) {
+			big->bin = (unsigned char *) &big[1];
+		}
+	}
+	else {
+		big = malloc_big_int(h.len);
+		if ((big != NULL) && (read_all(fd, big->bin, h.len, offset + h.offset) < 0)) {
+			int errsv = errno;
+			big_int_free(big);
+			big = NULL;
+			errno = errsv;
+		}
+	}
+	if (big == NULL) {
+		return NULL;
+	}
+	log_info("load big_int [%lu bytes] @%p", (unsigned long) h.len, big);
+	big->len  = h.len;
+	big->cap  = h.len;
+	big->sign = (h.negative ? NEGATIVE : POSITIVE);
+
+	// a mapped one isn't read here, only its last page (see `big_int_verify`)
+	if ((!mapped && (checksum(big->bin, big->len) != h.checksum)) || ((big->len > 1) && (big->bin[big->len - 1] == 0))) {
+		log_warn("saved big_int corrupted (checksum)");
+		big_int_free(big);
+		errno = EILSEQ;
+		return NULL;
+	}
+	return big;
+}
+
+int big_int_verify(const struct big_int * big, int fd, off_t offset) {
+
+	struct big_int_file h;
+	if (read_all(fd, (unsigned char *) &h, sizeof(h), offset) < 0) {
+		return -1;
+	}
+	if ((memcmp(h.magic, SAVE_MAGIC, sizeof(h.magic)) != 0) || (h.len != (uint64_t) big->len)
+		|| ((h.negative != 0) != (big->sign == NEGATIVE)) || (h.checksum != checksum(big->bin, big->len))) {
+		log_warn("saved big_int corrupted (checksum)");
+		errno = EILSEQ;
+		return -1;
+	}
+	return 0;
 }
 
 void big_int_free(struct big_int * big) {
 	big->len = 0;
 	big->cap = 0;
 	LOG_FREE(big);
-	free(big);
+	alloc_free(big);
 }
 
 
@@ -606,36 +1173,47 @@ void test_big_int() {
 	printf("BIG INT\n");
 
 
-	printf(" digit_div_2\n");
-	unsigned char num1[] = {1, 2, 3, 4, 5}; // 54321
-	assert(digit_div_2(5, num1, 10) == 5); // 27160
-	assert(num1[0] == 0);
-	assert(num1[1] == 6);
-	assert(num1[2] == 1);
-	assert(num1[3] == 7);
-	assert(num1[4] == 2);
-
-	unsigned char num2[] = {9, 2, 11, 10, 2, 8, 12}; // 209 890 089 -> 0xC82AB29
-	assert(digit_div_2(7, num2, 16) == 7); // 104 945 044 -> 0x6415594
-	assert(num2[0] == 4);
-	assert(num2[1] == 9);
-	assert(num2[2] == 5);
-	assert(num2[3] == 5);
-	assert(num2[4] == 1);
-	assert(num2[5] == 4);
-	assert(num2[6] == 6);
-
-	unsigned char num3[] = {3, 1}; // 13
-	assert(digit_div_2(2, num3, 10) == 1); // 6
-	assert(num3[0] == 6);
-	assert(num3[1] == 0);
-
-	struct big_int * d1 = long_to_big(0x2210);
-	// big_int_print(d1);
-	d1->len = digit_div_2(d1->len, d1->bin, BASE);
-	// big_int_print(d1);
+	printf(" big_int_conv\n");
+	struct big_int_conv conv;
+	assert(big_int_conv_begin(&conv, 10, 0) == 0); // 54321, by parts
+	assert(big_int_conv_digits(&conv, "54", 2) == 0);
+	assert(big_int_conv_digits(&conv, "321", 3) == 0);
+	struct big_int * d1 = big_int_conv_end(&conv);
+	assert((d1->len == 2) && (d1->bin[0] == 0x31) && (d1->bin[1] == 0xD4));
+	big_int_free(d1);
+
+	assert(big_int_conv_begin(&conv, 16, 0) == 0); // 0xC82AB29, by odd parts
+	assert(big_int_conv_digits(&conv, "C", 1) == 0);
+	assert(big_int_conv_digits(&conv, "82a", 3) == 0);
+	assert(big_int_conv_digits(&conv, "B29", 3) == 0);
+	d1 = big_int_conv_end(&conv);
+	assert((d1->len == 4) && (d1->bin[0] == 0x29) && (d1->bin[1] == 0xAB) && (d1->bin[2] == 0x82) && (d1->bin[3] == 0x0C));
+	big_int_free(d1);
+
+	assert(big_int_conv_begin(&conv, 8, 0) == 0); // 0o1234567 = 0x53977, 3 bits across the bytes
+	assert(big_int_conv_digits(&conv, "0001234567", 10) == 0);
+	d1 = big_int_conv_end(&conv);
+	assert((d1->len == 3) && (d1->bin[0] == 0x77) && (d1->bin[1] == 0x39) && (d1->bin[2] == 0x05));
+	big_int_free(d1);
+
+	assert(big_int_conv_begin(&conv, 3, 0) == 0); // 3 ^ 40 = 0xA8B8B452291FE821, more than a step of Horner
+	assert(big_int_conv_digits(&conv, "10000000000000000000", 20) == 0);
+	assert(big_int_conv_digits(&conv, "000000000000000000000", 21) == 0);
+	d1 = big_int_conv_end(&conv);
+	unsigned long p40 = 0xA8B8B452291FE821UL;
+	assert((d1->len == 8) && (memcmp(d1->bin, &p40, 8) == 0)); // little endian host
+	big_int_free(d1);
+
+	assert(big_int_conv_begin(&conv, 1, 0) == 0); // unary, counted
+	assert(big_int_conv_digits(&conv, "00000", 5) == 0);
+	d1 = big_int_conv_end(&conv);
+	assert((d1->len == 1) && (d1->bin[0] == 5));
 	big_int_free(d1);
 
+	assert(big_int_conv_begin(&conv, 16, 0) == 0);
+	assert(big_int_conv_digits(&conv, "F", 1) == 0);
+	big_int_conv_free(&conv);
+
 
 	printf(" malloc_big_int\n");
 	struct big_int * b1 = malloc_big_int(3);
@@ -647,34 +1225,11 @@ void test_big_int() {
 	big_int_free(b1);
 
 
-	printf(" digit_to_big_int\n");
-	unsigned char num4[] = {2, 4}; // 42
-	struct big_int * b4  = digit_to_big_int(2, num4, 10);
-	assert(b4->sign == POSITIVE);
-	assert(b4->len  == 1);
-	assert(b4->cap  == 2);
-	assert(b4->bin[0] == 42);
-	// big_int_print(b4);
-	big_int_free(b4);
-
-	unsigned char num5[] = {9, 2, 11, 10, 2, 8, 12}; // 209 890 089 -> 0x C 82 AB 29
-	struct big_int * b5  = digit_to_big_int(7, num5, 16);
-	assert(b5->sign == POSITIVE);
-	assert(b5->len  == 4);
-	assert(b5->cap  == 7);
-	assert(b5->bin[0] == 0x29);
-	assert(b5->bin[1] == 0xAB);
-	assert(b5->bin[2] == 0x82);
-	assert(b5->bin[3] == 0x0C);
-	// big_int_print(b5);
-	big_int_free(b5);
-
-
 	printf(" str_to_big\n");
 	struct big_int * b6 = str_to_big(6, "123456", 10); // 0x 1 E2 40
 	assert(b6->sign == POSITIVE);
 	assert(b6->len  == 3);
-	assert(b6->cap  == 6);
+	assert(b6->cap  == 3); // sized for the value, not the digits
 	assert(b6->bin[0] == 0x40);
 	assert(b6->bin[1] == 0xE2);
 	assert(b6->bin[2] == 0x01);
@@ -684,7 +1239,7 @@ void test_big_int() {
 	struct big_int * b7 = str_to_big(21, "919476744083708551629", 10); // 31 d8 4d 9b 25 c6 33 a1 cd
 	assert(b7->sign == POSITIVE);
 	assert(b7->len  == 9);
-	assert(b7->cap  == 21);
+	assert(b7->cap  == 9);
 	assert(b7->bin[0] == 0xCD);
 	assert(b7->bin[1] == 0xA1);
 	assert(b7->bin[2] == 0x33);
@@ -736,14 +1291,9 @@ void test_big_int() {
 
 
 	printf(" (zeros)\n");
-	unsigned char zero[] = {0};
-	assert(digit_div_2(1, zero, 10) == 0);
-	assert(zero[0] == 0);
-
-	struct big_int * dzero = digit_to_big_int(1, zero, 10);
+	struct big_int * dzero = str_to_big(4, "0000", 16);
 	assert(dzero->sign == POSITIVE);
 	assert(dzero->len  == 1);
-	assert(dzero->cap  == 1);
 	assert(dzero->bin[0] == 0);
 	big_int_free(dzero);
 
@@ -953,6 +1503,24 @@ void test_big_int() {
 	big_int_free(m12);
 
 
+	printf(" mul_blocked\n");
+	m1 = big_int_pow(long_to_big(7), 1500); // longer than a block
+	m2 = big_int_pow(long_to_big(7), 700);
+	rm12 = mul_blocked(m1, m2);
+	m1 = big_int_mul(m1, m2);
+	assert(big_int_cmp(m1, rm12) == 0);
+	big_int_free(m1);
+	big_int_free(rm12);
+
+	m1 = big_int_pow(long_to_big(7), 1500);
+	rm12 = mul_blocked(m1, m1);
+	m1 = big_int_sqr(m1);
+	assert(big_int_cmp(m1, rm12) == 0);
+	big_int_free(m1);
+	big_int_free(m2);
+	big_int_free(rm12);
+
+
 	printf(" big_to_long\n");
 	long l1 = (long) 1527261;
 	struct big_int * p1 = long_to_big(l1);
@@ -1052,6 +1620,148 @@ void test_big_int() {
 	printf(" = 3 ^ 300\n");
 	big_int_free(pow);
 
+
+	printf(" big_int_shl\n");
+	struct big_int * shl = big_int_shl(long_to_big(0x2d), 3);
+	assert(big_to_long(shl) == 0x168);
+	shl = big_int_shl(shl, 0);
+	assert(big_to_long(shl) == 0x168);
+	shl = big_int_shl(shl, 45); // bytes and bits
+	assert(big_to_long(shl) == 0x168L << 45);
+	shl = big_int_shl(shl, 200);
+	struct big_int * factor = long_to_big(0x168);
+	pow = big_int_mul(big_int_pow(long_to_big(2), 245), factor);
+	assert(big_int_cmp(shl, pow) == 0);
+	big_int_free(pow);
+	big_int_free(factor);
+	big_int_neg(shl);
+	shl = big_int_shl(shl, 8);
+	assert(shl->sign == NEGATIVE);
+	big_int_free(shl);
+	shl = big_int_shl(long_to_big(0), 100);
+	assert((shl->len == 1) && (shl->bin[0] == 0));
+	big_int_free(shl);
+
+
+	printf(" big_int_pow10\n");
+	struct big_int * ten = big_int_pow10(long_to_big(15), 16);
+	assert(big_to_long(ten) == 150000000000000000L);
+	big_int_free(ten);
+	ten = big_int_pow10(long_to_big(7), 0);
+	assert(big_to_long(ten) == 7);
+	big_int_free(ten);
+	ten = big_int_pow10(long_to_big(3), 1001);
+	factor = long_to_big(3);
+	pow = big_int_mul(big_int_pow(long_to_big(10), 1001), factor);
+	assert(big_int_cmp(ten, pow) == 0);
+	big_int_free(ten);
+	big_int_free(pow);
+	big_int_free(factor);
+
+
+	printf(" (memory budget)\n");
+	pow = long_to_big(3);
+	struct alloc_eval budget = {64, 0, NULL};
+	alloc_bind(&budget);
+	pow = big_int_pow(pow, 1000);
+	assert(error_get() == MEM_BUDGET);
+	error_reset();
+	alloc_bind(NULL);
+	big_int_free(pow);
+
+
+	printf(" (length limit)\n"); // only the lengths are read, no memory behind them
+	struct big_int * huge1 = long_to_big(1);
+	struct big_int * huge2 = long_to_big(1);
+	huge1->len = huge1->cap = huge2->len = huge2->cap = INT_MAX / 2 + 1;
+	assert(big_int_sqr(huge1) == huge1);
+	assert(error_get() == TOO_BIG);
+	error_reset();
+	assert(big_int_mul(huge1, huge2) == huge1);
+	assert(error_get() == TOO_BIG);
+	error_reset();
+	assert(big_int_pow(huge1, 3) == huge1);
+	assert(error_get() == TOO_BIG);
+	error_reset();
+	huge1->len = INT_MAX;
+	assert(big_int_add(huge1, huge2) == huge1);
+	assert(error_get() == TOO_BIG);
+	error_reset();
+	big_int_free(huge1);
+	big_int_free(huge2);
+
+
+	printf(" (cancel)\n");
+	cancel_begin(0);
+	cancel_request();
+	pow = big_int_pow(long_to_big(3), 100000);
+	assert(error_get() == CANCELLED);
+	error_reset();
+	big_int_free(pow);
+
+	m1 = big_int_pow(long_to_big(7), 1500);
+	m2 = big_int_pow(long_to_big(7), 1400);
+	m1 = big_int_mul(m1, m2);
+	assert(error_get() == CANCELLED);
+	error_reset();
+	big_int_free(m1);
+	big_int_free(m2);
+
+	assert(str_to_big(12, "123456789012", 10) == NULL);
+	assert(error_get() == CANCELLED);
+	error_reset();
+	cancel_end();
+
+
+	printf(" big_int_save, big_int_load\n");
+	FILE * file = tmpfile();
+	assert(file != NULL);
+	int fd = fileno(file);
+	pow = big_int_pow(long_to_big(-3), 301);
+	assert(big_int_save(pow, fd) == (long) (file_offset() + pow->len));
+	struct big_int * load = big_int_load(fd, 0);
+	assert((load != NULL) && !alloc_is_mapped(load));
+	assert(big_int_cmp(pow, load) == 0);
+	big_int_free(load);
+	big_int_free(pow);
+
+	int huge = ALLOC_MAP_THRESHOLD + 1000; // used in place, after a page
+	pow = malloc_big_int(huge);
+	for (int i = 0; i < huge; i++) {
+		pow->bin[i] = (unsigned char) (i * 13 + 7);
+	}
+	pow->bin[huge - 1] = 0xff;
+	pow->len = huge;
+	long page = sysconf(_SC_PAGESIZE);
+	assert(ftruncate(fd, 0) == 0);
+	assert(pwrite(fd, "page", 4, page - 4) == 4);
+	assert(lseek(fd, page, SEEK_SET) == page);
+	assert(big_int_save(pow, fd) > 0);
+	load = big_int_load(fd, page);
+	assert((load != NULL) && alloc_is_mapped(load));
+	assert(big_int_cmp(pow, load) == 0);
+	struct big_int * one = long_to_big(1);
+	load = big_int_add(load, one); // in a private copy
+	big_int_free(one);
+	big_int_free(pow);
+	pow = big_int_load(fd, page);
+	assert((pow != NULL) && (big_int_cmp(pow, load) < 0));
+	big_int_free(load);
+	big_int_free(pow);
+
+	assert(pwrite(fd, "\x55", 1, page + file_offset() + 1234) == 1);
+	load = big_int_load(fd, page); // not read at load
+	assert((load != NULL) && alloc_is_mapped(load));
+	errno = 0;
+	assert((big_int_verify(load, fd, page) < 0) && (errno == EILSEQ));
+	big_int_free(load);
+	assert(pwrite(fd, "\x00", 1, page + file_offset() + huge - 1) == 1);
+	errno = 0;
+	assert((big_int_load(fd, page) == NULL) && (errno == EILSEQ));
+	assert((big_int_load(fd, 0) == NULL) && (errno == EILSEQ));
+	fclose(file);
+	assert(error_get() == NO_ERROR);
+
 	printf("done\n\n");
 	#endif
 }
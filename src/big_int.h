@@ -3,11 +3,18 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "alloc.h"
+#include "cancel.h"
+#include "checkpoint.h"
 #include "config.h"
 #include "limits.h"
 #include "log.h"
+#include "output.h"
+#include "progress.h"
 #include "string.h"
 
 
@@ -15,11 +22,45 @@ struct big_int * long_to_big(long l);
 
 struct big_int * str_to_big(int len, const char * str, unsigned int base);
 
+// conversion of the digits of a literal given by parts, the most significant first: the value is
+// built as they come (linear in a power of 2, by steps of Horner otherwise), no copy of the digits
+struct big_int_conv {
+	struct big_int * big;
+	unsigned int base;
+	int bits;          // per digit if the base is a power of 2, 0 otherwise
+	uint32_t mult;     // base ^ group
+	int group;         // digits of a step of Horner
+	unsigned int acc;  // bits not in a whole byte yet (power of 2)
+	int acc_bits;
+	int bytes;         // of the value so far
+	long digits;       // given so far
+	long total;        // expected digits (size and progress), 0 if unknown
+};
+
+// return -1 (and set the error) if no memory
+int big_int_conv_begin(struct big_int_conv * c, unsigned int base, long total);
+
+// `len` more digits (valid in the base)
+// return -1 (and set the error) if no memory or cancelled, then only `big_int_conv_free`
+int big_int_conv_digits(struct big_int_conv * c, const char * digits, int len);
+
+// value of the digits (at least one), NULL (and the error set) if no memory
+struct big_int * big_int_conv_end(struct big_int_conv * c);
+
+// without the value (after a failure)
+void big_int_conv_free(struct big_int_conv * c);
+
+// return NULL (and set the error) if no memory
+struct big_int * big_int_copy(const struct big_int * b);
+
 
 int big_int_length(const struct big_int * b);
 
 void big_int_neg(struct big_int * b);
 
+// make room for `cap` bytes (on failure, `b` is unchanged and the error is set)
+struct big_int * big_int_reserve(struct big_int * b, int cap);
+
 int big_int_cmp(const struct big_int * b1, const struct big_int * b2);
 
 
@@ -35,12 +76,46 @@ struct big_int * big_int_sqr(struct big_int * b);
 
 struct big_int * big_int_pow(struct big_int * b, long expo);
 
+// b * 2 ^ bits
+struct big_int * big_int_shl(struct big_int * b, long bits);
+
+// b * 10 ^ expo, computed as b * 5 ^ expo shifted by `expo` bits (squares of 2/3 of the size)
+struct big_int * big_int_pow10(struct big_int * b, long expo);
+
 
 // return LONG_MIN if big_int can't fit in an long
 long big_to_long(const struct big_int * big);
 
+// bytes of the absolute value (little endian) without copy, `*len` of them
+// return 1 if `big` is negative
+int big_int_bytes(const struct big_int * big, const unsigned char ** bytes, int * len);
+
 void big_int_print(const struct big_int * const big);
 
+void big_int_fprint(FILE * out, const struct big_int * const big);
+
+void big_int_write(struct output * o, const struct big_int * const big);
+
+// of the bytes of the absolute value, as in the header of `big_int_save`
+uint64_t big_int_checksum(const struct big_int * big);
+
+// save in `fd` from its current position: a header (sign, length, checksum), then the bytes
+// of the absolute value
+// return the bytes written, -1 on failure (see `errno`)
+long big_int_save(const struct big_int * big, int fd);
+
+// load what `big_int_save` wrote at `offset` of `fd`, a huge one is mapped and used
+// in place (see `alloc_map_file`) if `offset` is a multiple of the page size: its
+// checksum isn't computed then, only its header and last byte are checked
+// return NULL on failure: with the error set if no memory, see `errno` otherwise
+// (`EILSEQ` if it isn't a saved big_int or it is corrupted)
+struct big_int * big_int_load(int fd, off_t offset);
+
+// check the checksum of `big`, loaded from `offset` of `fd`, against its header
+// (it reads every page of a mapped one)
+// return 0, -1 on failure (`EILSEQ` if it doesn't match)
+int big_int_verify(const struct big_int * big, int fd, off_t offset);
+
 void big_int_free(struct big_int * big);
 
 
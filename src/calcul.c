@@ -0,0 +1,350 @@
+#define _POSIX_C_SOURCE 200809L // open_memstream
+#include "calcul.h"
+
+
+struct calcul {
+	struct calc_ctx * ctx;
+	struct alloc_eval mem; // heap of the blocks outside `eval` (input, tokens)
+
+	char * input; // copy of the last input with a NUL (for the lexer)
+	size_t input_cap;
+	const char * error_src; // where the error of the last evaluation points: `input` or a prepared expression
+
+	struct number result;
+	int has_result;
+	const unsigned char * bytes; // of the result (see `number_bytes`)
+	int len;
+	int negative;
+	unsigned char small[sizeof(long)];
+};
+
+
+struct calcul * calcul_new(const struct alloc_heap * heap) {
+
+	struct alloc_eval mem = {0, 0, heap};
+	alloc_bind(&mem);
+	struct calcul * c = alloc_malloc(sizeof(struct calcul));
+	struct calc_ctx * ctx = (c != NULL ? ctx_new() : NULL);
+	alloc_bind(NULL);
+	log_trace("malloc %p: calcul", c);
+
+	if (ctx == NULL) {
+		alloc_free(c);
+		return NULL;
+	}
+	ctx->alloc.heap = heap;
+	c->ctx = ctx;
+	c->mem = mem;
+	c->input = NULL;
+	c->input_cap = 0;
+	c->error_src = NULL;
+	c->has_result = 0;
+	return c;
+}
+
+static void forget_result(struct calcul * c) {
+	if (c->has_result) {
+		number_free(c->result);
+		c->has_result = 0;
+	}
+}
+
+void calcul_free(struct calcul * c) {
+	forget_result(c);
+	ctx_free(c->ctx);
+	LOG_FREE(c->input);
+	alloc_free(c->input);
+	LOG_FREE(c);
+	alloc_free(c);
+}
+
+void calcul_set_config(struct calcul * c, const struct calc_config * config) {
+	c->ctx->config = *config;
+}
+
+
+// the previous result is `CONSOLE_LAST` for the next evaluation, then `result` replaces it
+static int set_result(struct calcul * c, int res, struct number * result) {
+	c->ctx->last = NULL;
+	forget_result(c);
+	if (res > 0) {
+		c->result = *result;
+		c->has_result = 1;
+		c->negative = number_bytes(&c->result, c->small, &c->bytes, &c->len);
+	}
+	return res;
+}
+
+// copy `str` in `c->input`
+// return -1 if no memory (and set the error)
+static int set_input(struct calcul * c, const char * str, size_t len) {
+	if (c->input_cap < len + 1) {
+		char * input = alloc_realloc(c->input, len + 1);
+		if (input == NULL) {
+			ctx_error_set(c->ctx, OUT_OF_MEM, NULL, NULL, 0);
+			return -1;
+		}
+		c->input = input;
+		c->input_cap = len + 1;
+	}
+	memcpy(c->input, str, len); // the lexer stops on the NUL
+	c->input[len] = '\0';
+	c->error_src = c->input;
+	return 0;
+}
+
+int calcul_eval(struct calcul * c, const char * str, size_t len) {
+
+	c->mem.used = 0;
+	alloc_bind(&c->mem);
+	if (set_input(c, str, len) < 0) {
+		alloc_bind(NULL);
+		return set_result(c, -1, NULL);
+	}
+	c->ctx->last = (c->has_result ? &c->result : NULL);
+	struct number result;
+	int res = eval_str(c->ctx, c->input, &result);
+	alloc_bind(NULL);
+	return set_result(c, res, &result);
+}
+
+
+struct program * calcul_prepare(struct calcul * c, const char * str, size_t len) {
+
+	c->mem.used = 0;
+	alloc_bind(&c->mem);
+	struct program * p = NULL;
+	if (set_input(c, str, len) == 0) {
+		c->ctx->last = (c->has_result ? &c->result : NULL); // for the estimate
+		p = program_compile(c->ctx, c->input, len);
+		c->ctx->last = NULL;
+	}
+	alloc_bind(NULL);
+	return p;
+}
+
+int calcul_run(struct calcul * c, struct program * p) {
+	c->ctx->last = (c->has_result ? &c->result : NULL);
+	c->error_src = p->src;
+	struct number result;
+	int res = program_run(c->ctx, p, &result);
+	return set_result(c, res, &result);
+}
+
+void calcul_unprepare(struct program * p) {
+	program_free(p); // every block goes back to its heap
+}
+
+
+int calcul_bytes(const struct calcul * c, const unsigned char ** bytes, size_t * len) {
+
+	if (!c->has_result) {
+		*bytes = NULL;
+		*len   = 0;
+		return 0;
+	}
+	*bytes = c->bytes;
+	*len   = c->len;
+	return (c->negative ? -1 : 1);
+}
+
+// append `str` to `buf` (truncated), return the length appended as a whole
+static int append(char * buf, size_t size, int at, const char * str) {
+	int len = strlen(str);
+	for (int i = 0; (i < len) && ((size_t) (at + i + 1) < size); i++) {
+		buf[at + i] = str[i];
+	}
+	return len;
+}
+
+int calcul_format(const struct calcul * c, char * buf, size_t size) {
+
+	const unsigned char * bytes;
+	size_t len;
+	int sign = calcul_bytes(c, &bytes, &len);
+	if (sign == 0) {
+		return -1;
+	}
+
+	int at = 0;
+	if (sign < 0) {
+		at += append(buf, size, at, "-");
+	}
+	if ((len == 1) && (bytes[0] == 0)) { // as "%#lx"
+		at += append(buf, size, at, "0");
+	}
+	else {
+		char hex[8];
+		snprintf(hex, sizeof(hex), "0x%x", bytes[len - 1]);
+		at += append(buf, size, at, hex);
+		for (size_t i = len - 1; i > 0; i--) {
+			snprintf(hex, sizeof(hex), "%02x", bytes[i - 1]);
+			at += append(buf, size, at, hex);
+		}
+	}
+	if (size > 0) {
+		buf[((size_t) at < size ? (size_t) at : size - 1)] = '\0';
+	}
+	return at;
+}
+
+
+int calcul_error(const struct calcul * c, int * column) {
+	if (column != NULL) {
+		*column = (c->error_src != NULL ? error_column(&c->ctx->error, c->error_src) : -1);
+	}
+	return ctx_error(c->ctx);
+}
+
+int calcul_error_message(const struct calcul * c, char * buf, size_t size) {
+
+	char * msg = NULL;
+	size_t len = 0;
+	FILE * out = open_memstream(&msg, &len);
+	if (out == NULL) {
+		return -1;
+	}
+	error_fprint(out, &c->ctx->error);
+	fclose(out);
+
+	int res = snprintf(buf, size, "%s", msg);
+	free(msg); // from the libc
+	return res;
+}
+
+
+
+/*
+	TEST
+*/
+
+
+// heap counting its living blocks
+static void * count_malloc(size_t size, void * data) {
+	(*(long *) data)++;
+	return malloc(size);
+}
+
+static void * count_realloc(void * ptr, size_t size, void * data) {
+	return realloc(ptr, size);
+}
+
+static void count_free(void * ptr, void * data) {
+	(*(long *) data)--;
+	free(ptr);
+}
+
+void test_calcul() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("CALCUL:\n");
+	long blocks = 0;
+	struct alloc_heap heap = {count_malloc, count_realloc, count_free, &blocks};
+	struct calcul * c = calcul_new(&heap);
+	assert(c != NULL);
+	assert(blocks > 0);
+	const unsigned char * bytes;
+	size_t len;
+	char buf[64];
+
+
+	printf(" eval\n");
+	const char * str = "1 + 2 garbage";
+	assert(calcul_eval(c, str, 5) == 1); // no NUL after "1 + 2"
+	assert(calcul_bytes(c, &bytes, &len) == 1);
+	assert((len == 1) && (bytes[0] == 3));
+
+	assert(calcul_eval(c, "-(2 ^ 64)", 9) == 1);
+	assert(calcul_bytes(c, &bytes, &len) == -1);
+	assert((len == 9) && (bytes[0] == 0) && (bytes[8] == 1));
+
+	str = "123456789012345678901234567890 - 123456789012345678901234567889 * 1 + 8"; // literals converted first
+	assert(calcul_eval(c, str, strlen(str)) == 1);
+	assert(calcul_bytes(c, &bytes, &len) == 1);
+	assert((len == 1) && (bytes[0] == 9));
+
+	assert(calcul_eval(c, "  ", 2) == 0);
+	assert(calcul_bytes(c, &bytes, &len) == 0);
+	assert(calcul_format(c, buf, sizeof(buf)) == -1);
+
+
+	printf(" format\n");
+	assert(calcul_eval(c, "2 ^ 64 - 1", 10) == 1);
+	assert(calcul_format(c, buf, sizeof(buf)) == 18);
+	assert(strcmp(buf, "0xffffffffffffffff") == 0);
+	assert(calcul_format(c, buf, 5) == 18); // truncated
+	assert(strcmp(buf, "0xff") == 0);
+
+	assert(calcul_eval(c, "-31", 3) == 1);
+	assert(calcul_format(c, buf, sizeof(buf)) == 5);
+	assert(strcmp(buf, "-0x1f") == 0);
+
+	assert(calcul_eval(c, "0", 1) == 1);
+	assert(calcul_format(c, buf, sizeof(buf)) == 1);
+	assert(strcmp(buf, "0") == 0);
+
+
+	printf(" error\n");
+	int column;
+	assert(calcul_eval(c, "1 + 2 # 3", 9) == -1);
+	assert(calcul_error(c, &column) == UNKNOWN_SYM);
+	assert(column == 6);
+	assert(calcul_error_message(c, buf, sizeof(buf)) > 0);
+	assert(strcmp(buf, "Lexer: Unknown symbol '#'") == 0);
+
+	assert(calcul_eval(c, "2 ^ -1", 6) == -1);
+	assert(calcul_error(c, NULL) == POW_NEG);
+	str = "2 ^ -1 + 99999999999999999999999"; // with a literal not evaluated yet
+	assert(calcul_eval(c, str, strlen(str)) == -1);
+	assert(calcul_error(c, NULL) == POW_NEG);
+	assert(calcul_eval(c, "1", 1) == 1);
+	assert(calcul_error(c, &column) == NO_ERROR);
+	assert(column == -1);
+
+
+	printf(" prepare\n");
+	str = "_ * 3 + 1 garbage";
+	struct program * p = calcul_prepare(c, str, 9);
+	assert(p != NULL);
+	for (int i = 0; i < 3; i++) { // 1, then 4, 13, 40
+		assert(calcul_run(c, p) == 1);
+	}
+	assert(calcul_bytes(c, &bytes, &len) == 1);
+	assert((len == 1) && (bytes[0] == 40));
+	struct program * square = calcul_prepare(c, "_ ^ 2", 5);
+	assert(calcul_run(c, square) == 1);
+	assert(calcul_bytes(c, &bytes, &len) == 1);
+	assert((len == 2) && (bytes[0] == 0x40) && (bytes[1] == 0x06)); // 1600
+
+	assert(calcul_eval(c, "-1", 2) == 1);
+	str = "1 + 2 ^ _";
+	struct program * neg = calcul_prepare(c, str, strlen(str));
+	assert(calcul_run(c, neg) == -1);
+	assert(calcul_error(c, &column) == POW_NEG);
+	assert(column == 6); // in the prepared expression
+	assert(calcul_bytes(c, &bytes, &len) == 0);
+	assert(calcul_run(c, neg) == -1); // no previous result
+	assert(calcul_error(c, &column) == UNMANAGED);
+	assert(column == 8);
+
+	assert(calcul_prepare(c, "1 + 2 # 3", 9) == NULL);
+	assert(calcul_error(c, &column) == UNKNOWN_SYM);
+	assert(column == 6);
+	assert(calcul_prepare(c, "  ", 2) == NULL);
+	assert(calcul_error(c, NULL) == NO_ERROR);
+	calcul_unprepare(p);
+	calcul_unprepare(square);
+	calcul_unprepare(neg);
+
+
+	printf(" heap\n");
+	calcul_free(c);
+	assert(blocks == 0); // every block went back to the heap
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,85 @@
+#ifndef CALCUL_H
+#define CALCUL_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "big_int.h"
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+#include "program.h"
+
+
+/*
+	Library interface (libcalcul)
+
+An evaluator owns a context and the last result. The input is a buffer and
+its length (no NUL needed), the result is read without copy as the bytes of
+its absolute value (little endian) or formatted in a buffer of the caller.
+The memory of the evaluations (results included) comes from the heap given to
+`calcul_new` (NULL for the libc), nothing leaves the program on failure.
+
+An evaluator is used by one thread at a time, two evaluators evaluate
+concurrently. The bytes of a result are valid until the next `calcul_eval` or
+`calcul_run`.
+
+An expression evaluated many times is prepared once (`calcul_prepare`, see
+program.h), then each `calcul_run` skips the lexer, the parser and the
+conversion of the literals. In both, the name `_` is the previous result of
+the evaluator, so a prepared `_ * 3 + 1` iterates.
+*/
+
+
+struct calcul;
+
+// `heap` NULL is the libc (`heap` must outlive the evaluator)
+// return NULL if no memory
+struct calcul * calcul_new(const struct alloc_heap * heap);
+
+void calcul_free(struct calcul * c);
+
+// configuration of the next evaluations (the default is `ctx_set_default`)
+void calcul_set_config(struct calcul * c, const struct calc_config * config);
+
+
+// evaluate the `len` bytes of `str`
+// return 1 on success, 0 if there is no expression, -1 on error
+int calcul_eval(struct calcul * c, const char * str, size_t len);
+
+// compile the `len` bytes of `str` once, for `calcul_run`
+// return NULL on error (see `calcul_error`) or if there is no expression
+struct program * calcul_prepare(struct calcul * c, const char * str, size_t len);
+
+// evaluate `p` (prepared by `c`), the result as `calcul_eval`
+// return 1 on success, -1 on error (its column is in the prepared expression)
+int calcul_run(struct calcul * c, struct program * p);
+
+void calcul_unprepare(struct program * p);
+
+
+// bytes of the absolute value of the result (little endian) in `*bytes`, `*len` of them
+// return -1 if the result is negative, 1 otherwise (0 if there is no result)
+int calcul_bytes(const struct calcul * c, const unsigned char ** bytes, size_t * len);
+
+// result in hexadecimal (like `number_fprint`) in `buf`, truncated to `size` - 1 characters
+// return the length of the whole result (like `snprintf`), -1 if there is no result
+int calcul_format(const struct calcul * c, char * buf, size_t size);
+
+
+// return the error of the last evaluation (`NO_ERROR` is 0) and its column in `*column` (-1 if none)
+int calcul_error(const struct calcul * c, int * column);
+
+// message of the error in `buf`, as `calcul_format`
+int calcul_error_message(const struct calcul * c, char * buf, size_t size);
+
+
+void test_calcul();
+
+
+#endif // CALCUL_H
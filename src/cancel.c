@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200809L // sigaction, clock_gettime
+#include "cancel.h"
+
+
+// state of the evaluation of the thread
+static __thread volatile sig_atomic_t running   = 0;
+static __thread volatile sig_atomic_t cancelled = NO_ERROR; // or the reason, `CANCELLED` or `TIMEOUT`
+static __thread double timeout;
+static __thread struct timespec deadline;
+static __thread const long * yield_to = NULL; // jobs waiting for the CPU
+
+
+void cancel_begin(double seconds) {
+	cancelled = NO_ERROR;
+	timeout   = seconds;
+	if (timeout > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		long nsec = deadline.tv_nsec + (long) ((timeout - (long) timeout) * 1e9);
+		deadline.tv_sec  += (time_t) timeout + (nsec / 1000000000);
+		deadline.tv_nsec  = nsec % 1000000000;
+	}
+	running = 1;
+}
+
+void cancel_end() {
+	running   = 0;
+	cancelled = NO_ERROR;
+}
+
+
+void cancel_request() {
+	cancelled = CANCELLED;
+}
+
+static int over_deadline() {
+	if (timeout <= 0) {
+		return 0;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec > deadline.tv_sec) || ((now.tv_sec == deadline.tv_sec) && (now.tv_nsec >= deadline.tv_nsec)));
+}
+
+void cancel_yield_to(const long * waiting) {
+	yield_to = waiting;
+}
+
+int cancel_check() {
+	if (!running) { // out of an evaluation
+		return 0;
+	}
+	if ((yield_to != NULL) && (__atomic_load_n(yield_to, __ATOMIC_RELAXED) > 0)) {
+		sched_yield();
+	}
+	if (!cancelled && over_deadline()) {
+		log_info("evaluation over %g seconds", timeout);
+		cancelled = TIMEOUT; // stop at the next check too
+	}
+	if (cancelled) {
+		log_info("evaluation cancelled");
+		error_set(cancelled, NULL, NULL, 0);
+		return 1;
+	}
+	return 0;
+}
+
+
+static void sigint_handler(int sig) {
+	if (!running) { // nothing to interrupt, leave as usual
+		signal(sig, SIG_DFL);
+		raise(sig);
+		return;
+	}
+	cancel_request();
+}
+
+void cancel_catch_sigint() {
+	struct sigaction act;
+	act.sa_handler = sigint_handler;
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = SA_RESTART;
+	sigaction(SIGINT, &act, NULL);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+void test_cancel() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("CANCEL:\n");
+
+
+	printf(" cancel_request\n");
+	cancel_begin(0);
+	assert(!cancel_check());
+	assert(!CANCEL_POINT(0));
+	cancel_request();
+	assert(!CANCEL_POINT(1)); // not a check point
+	assert(CANCEL_POINT(CANCEL_BLOCK));
+	assert(error_get() == CANCELLED);
+	error_reset();
+	cancel_end();
+
+	cancel_begin(0); // a new evaluation
+	assert(!cancel_check());
+	cancel_end();
+
+
+	printf(" timeout\n");
+	cancel_begin(0.001);
+	struct timespec wait = {0, 2000000}; // 2 ms
+	nanosleep(&wait, NULL);
+	assert(cancel_check());
+	assert(error_get() == TIMEOUT);
+	error_reset();
+	cancel_end();
+
+
+	printf("done\n\n");
+	#endif
+}
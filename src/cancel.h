@@ -0,0 +1,52 @@
+#ifndef CANCEL_H
+#define CANCEL_H
+
+#include <assert.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "config.h"
+#include "error.h"
+#include "log.h"
+
+
+/*
+	Cooperative cancellation of an evaluation
+
+The long loops of the kernels (multiplication, square, conversion) call
+`cancel_check` every `CANCEL_BLOCK` iterations. When the evaluation is
+interrupted (SIGINT) or over its time limit, it sets the error `CANCELLED` or
+`TIMEOUT`, the kernels stop and `eval` releases everything.
+*/
+
+// check point for the loop counter `i` of a kernel
+#define CANCEL_POINT(i) ((((i) % CANCEL_BLOCK) == 0) && cancel_check())
+
+
+// around an evaluation, limited to `seconds` (0 is no limit)
+void cancel_begin(double seconds);
+
+void cancel_end();
+
+
+// interrupt the current evaluation (safe in a signal handler)
+void cancel_request();
+
+// return 1 (and set the error) if the evaluation has to stop
+// (and yield the CPU if jobs are waiting, see `cancel_yield_to`)
+int cancel_check();
+
+// the checks of the thread yield the CPU while `*waiting` > 0 (NULL to stop)
+void cancel_yield_to(const long * waiting);
+
+
+// SIGINT interrupts the evaluation, or leaves the program between evaluations
+void cancel_catch_sigint();
+
+
+void test_cancel();
+
+
+#endif // CANCEL_H
@@ -0,0 +1,312 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, pread, fsync, O_CLOEXEC, PATH_MAX
+#include "checkpoint.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC "calcul\0p" // 8 bytes
+#define CHECKPOINT_VERSION 1
+
+
+// header of a checkpoint file (integers in the byte order of the host), padded to a page
+// then `prod` and `b` as `big_int_save`, each one at a multiple of the page size
+struct checkpoint_file {
+	char magic[8];      // `CHECKPOINT_MAGIC`
+	uint32_t version;   // `CHECKPOINT_VERSION`
+	uint32_t bit;       // steps done
+	int64_t expo;       // of the power
+	uint64_t base_len;  // fingerprint of the base
+	uint64_t base_sum;
+	uint32_t base_negative;
+	uint32_t unused;
+	int64_t left;       // exponent left
+	uint64_t prod_offset;
+	uint64_t b_offset;
+};
+
+static const char * path = NULL;
+static double interval = CHECKPOINT_INTERVAL;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static const struct checkpoint * owner = NULL; // power writing the file
+
+// state of `checkpoint_resume`, for the next matching power
+static struct {
+	int set;
+	struct checkpoint_file h;
+	struct big_int * prod;
+	struct big_int * b;
+} resumed;
+
+
+static double now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static off_t page_up(off_t offset) {
+	long page = sysconf(_SC_PAGESIZE);
+	return (offset + page - 1) / page * page;
+}
+
+// in `tmp` then renamed, the file is always a whole checkpoint
+static int write_file(const struct checkpoint_file * h, const struct big_int * prod, const struct big_int * b) {
+
+	char tmp[PATH_MAX];
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+	struct checkpoint_file head = *h;
+	head.prod_offset = page_up(sizeof(head));
+	long n = -1;
+	if (lseek(fd, head.prod_offset, SEEK_SET) >= 0) {
+		n = big_int_save(prod, fd);
+	}
+	if (n >= 0) {
+		head.b_offset = page_up(head.prod_offset + n);
+		n = -1;
+		if (lseek(fd, head.b_offset, SEEK_SET) >= 0) { // a hole before
+			n = big_int_save(b, fd);
+		}
+	}
+	if ((n < 0) || (pwrite(fd, &head, sizeof(head), 0) != sizeof(head)) || (fsync(fd) < 0)) {
+		int errsv = errno;
+		close(fd);
+		unlink(tmp);
+		errno = errsv;
+		return -1;
+	}
+	close(fd);
+	return rename(tmp, path);
+}
+
+
+void checkpoint_set(const char * file, double seconds) {
+	path     = file;
+	interval = seconds;
+}
+
+int checkpoint_resume(const char * file) {
+
+	int fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	struct checkpoint_file h;
+	if (pread(fd, &h, sizeof(h), 0) != sizeof(h)) {
+		close(fd);
+		errno = EILSEQ;
+		return -1;
+	}
+	if ((memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) || (h.version != CHECKPOINT_VERSION)
+		|| (h.left < 1) || (h.left > h.expo)) {
+		log_warn("no checkpoint in '%s'", file);
+		close(fd);
+		errno = EILSEQ;
+		return -1;
+	}
+	struct big_int * prod = big_int_load(fd, h.prod_offset);
+	struct big_int * b = (prod != NULL ? big_int_load(fd, h.b_offset) : NULL);
+	// the squarings read them all anyway, a mapped one is checked here
+	if ((b != NULL) && ((big_int_verify(prod, fd, h.prod_offset) < 0) || (big_int_verify(b, fd, h.b_offset) < 0))) {
+		int errsv = errno;
+		big_int_free(b);
+		b = NULL;
+		errno = errsv;
+	}
+	int errsv = errno;
+	close(fd);
+	if (b == NULL) {
+		if (prod != NULL) {
+			big_int_free(prod);
+		}
+		errno = errsv;
+		return -1;
+	}
+
+	pthread_mutex_lock(&lock);
+	if (resumed.set) { // never taken
+		big_int_free(resumed.prod);
+		big_int_free(resumed.b);
+	}
+	resumed.set  = 1;
+	resumed.h    = h;
+	resumed.prod = prod;
+	resumed.b    = b;
+	pthread_mutex_unlock(&lock);
+	log_info("checkpoint of ^ %ld resumed at bit %u", (long) h.expo, h.bit);
+	return 0;
+}
+
+
+void checkpoint_begin(struct checkpoint * c, const struct big_int * base, long expo) {
+	c->on = (path != NULL);
+	if (!c->on) {
+		return;
+	}
+	const unsigned char * bytes;
+	int len;
+	c->expo     = expo;
+	c->base_negative = big_int_bytes(base, &bytes, &len);
+	c->base_len = len;
+	c->base_sum = big_int_checksum(base);
+	c->last     = now();
+}
+
+int checkpoint_take(struct checkpoint * c, struct big_int ** prod, struct big_int ** b, long * expo, int * bit) {
+	if (!c->on) {
+		return 0;
+	}
+	pthread_mutex_lock(&lock);
+	int match = (resumed.set && (owner == NULL) && (resumed.h.expo == c->expo) && (resumed.h.base_len == c->base_len)
+		&& (resumed.h.base_sum == c->base_sum) && (resumed.h.base_negative == c->base_negative));
+	if (match) {
+		big_int_free(*b);
+		*prod = resumed.prod;
+		*b    = resumed.b;
+		*expo = resumed.h.left;
+		*bit  = resumed.h.bit;
+		resumed.set = 0;
+		owner = c; // and its file
+	}
+	pthread_mutex_unlock(&lock);
+	return match;
+}
+
+void checkpoint_step(struct checkpoint * c, const struct big_int * prod, const struct big_int * b, long expo, int bit) {
+	if (!c->on || (now() - c->last < interval)) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	if ((owner == NULL) && !resumed.set) { // the file of a resume is kept until taken
+		owner = c;
+	}
+	int mine = (owner == c);
+	pthread_mutex_unlock(&lock);
+	if (!mine) {
+		return;
+	}
+
+	struct checkpoint_file h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+	h.version  = CHECKPOINT_VERSION;
+	h.bit      = bit;
+	h.expo     = c->expo;
+	h.base_len = c->base_len;
+	h.base_sum = c->base_sum;
+	h.base_negative = c->base_negative;
+	h.left     = expo;
+	double start = now();
+	if (write_file(&h, prod, b) < 0) {
+		log_warn("checkpoint: '%s': %s", path, strerror(errno));
+	}
+	else {
+		log_info("checkpoint of ^ %ld at bit %d in %.3f s", c->expo, bit, now() - start);
+	}
+	c->last = now();
+}
+
+void checkpoint_end(struct checkpoint * c, int done) {
+	if (!c->on) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	if (owner == c) {
+		owner = NULL;
+		if (done) {
+			unlink(path);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+void test_checkpoint() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("CHECKPOINT:\n");
+	char file[] = "/tmp/calcul-checkpoint-XXXXXX";
+	int fd = mkstemp(file);
+	assert(fd >= 0);
+	close(fd);
+	struct stat st;
+	struct big_int * ref = big_int_pow(long_to_big(3), 1000);
+	assert(ref != NULL);
+
+
+	printf(" checkpoints\n"); // at every step
+	checkpoint_set(file, 0);
+	struct big_int * pow = big_int_pow(long_to_big(3), 1000);
+	assert(big_int_cmp(pow, ref) == 0);
+	big_int_free(pow);
+	assert((stat(file, &st) < 0) && (errno == ENOENT)); // removed when done
+
+
+	printf(" resume\n");
+	struct checkpoint c;
+	struct big_int * three = long_to_big(3);
+	checkpoint_begin(&c, three, 1000);
+	struct big_int * prod = big_int_pow(long_to_big(3), 8); // 1000 is 0b1111101000
+	struct big_int * b = big_int_pow(long_to_big(3), 16);
+	checkpoint_step(&c, prod, b, 62, 4);
+	checkpoint_end(&c, 0);
+	assert(stat(file, &st) == 0);
+	assert(checkpoint_resume(file) == 0);
+	pow = big_int_pow(long_to_big(5), 1000); // not this one
+	big_int_free(pow);
+	assert(stat(file, &st) == 0);
+	pow = big_int_pow(three, 1000);
+	assert(big_int_cmp(pow, ref) == 0);
+	big_int_free(pow);
+	assert((stat(file, &st) < 0) && (errno == ENOENT));
+
+	checkpoint_begin(&c, ref, 1000); // really from the saved state: 2 * b ^ 62
+	struct big_int * two = long_to_big(2);
+	checkpoint_step(&c, two, b, 62, 4);
+	checkpoint_end(&c, 0);
+	assert(checkpoint_resume(file) == 0);
+	pow = big_int_pow(big_int_copy(ref), 1000);
+	struct big_int * expected = big_int_mul(big_int_pow(big_int_copy(b), 62), two);
+	assert(big_int_cmp(pow, expected) == 0);
+	big_int_free(pow);
+	big_int_free(expected);
+	big_int_free(two);
+	big_int_free(prod);
+	big_int_free(b);
+
+
+	printf(" errors\n");
+	assert((checkpoint_resume(file) < 0) && (errno == ENOENT));
+	FILE * f = fopen(file, "w");
+	assert(f != NULL);
+	fputs("3 ^ 1000\n", f);
+	fclose(f);
+	assert((checkpoint_resume(file) < 0) && (errno == EILSEQ));
+	unlink(file);
+	checkpoint_set(NULL, CHECKPOINT_INTERVAL);
+	big_int_free(ref);
+
+
+	printf("done\n\n");
+	#endif
+}
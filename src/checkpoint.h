@@ -0,0 +1,70 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "big_int.h"
+#include "config.h"
+#include "log.h"
+
+
+/*
+	Checkpoints of the long powers
+
+A power of hours loses everything with the process. With a checkpoint file
+(`checkpoint_set`), `big_int_pow` writes its state between two steps of the
+exponent, at most every `interval` seconds: the product so far, the current
+power of the base and the exponent left (each one as `big_int_save`). The
+file is replaced atomically, and removed when the power is done.
+
+After a crash, `checkpoint_resume` loads the file: the next power of the same
+base by the same exponent (like the same batch run again) continues from the
+saved state instead of the start. One power at a time owns the file.
+*/
+
+
+struct big_int; // (big_int.h includes this header)
+
+// state of one call of `big_int_pow`
+struct checkpoint {
+	int on;            // a checkpoint file is set
+	long expo;         // of the power
+	uint64_t base_len; // fingerprint of the base
+	uint64_t base_sum;
+	int base_negative;
+	double last;       // time of the start or of the last checkpoint
+};
+
+
+// checkpoint the powers in `path` at most every `interval` seconds, NULL disables
+// (`path` has to stay valid)
+void checkpoint_set(const char * path, double interval);
+
+// load the state saved in `path` for the next matching power
+// return 0, -1 on failure: with the error set if no memory, see `errno` otherwise
+// (`EILSEQ` if it isn't a checkpoint or it is corrupted)
+int checkpoint_resume(const char * path);
+
+
+// start of the power `base` ^ `expo` (before any change of `base`)
+void checkpoint_begin(struct checkpoint * c, const struct big_int * base, long expo);
+
+// if a resumed state matches the power, replace `*b` (freed) and set the state
+// return 1 if resumed, 0 otherwise
+int checkpoint_take(struct checkpoint * c, struct big_int ** prod, struct big_int ** b, long * expo, int * bit);
+
+// between two steps, after `bit` steps: `prod` * `b` ^ `expo` is the power
+void checkpoint_step(struct checkpoint * c, const struct big_int * prod, const struct big_int * b, long expo, int bit);
+
+// end of the power, the file is removed if `done`
+void checkpoint_end(struct checkpoint * c, int done);
+
+
+void test_checkpoint();
+
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,597 @@
+#define _POSIX_C_SOURCE 200809L // PATH_MAX, O_CLOEXEC, strndup
+#include "command.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static const char * skip_blank(const char * s) {
+	while ((*s == ' ') || (*s == '\t')) {
+		s++;
+	}
+	return s;
+}
+
+// end of the word at `s` (blank, '\n' or '\0')
+static const char * word_end(const char * s) {
+	while ((*s != '\0') && !isspace((unsigned char) *s)) {
+		s++;
+	}
+	return s;
+}
+
+// the file argument at `s` in `file`
+// return the end of the argument, NULL on error
+static const char * file_arg(struct calc_ctx * ctx, const char * s, char file[PATH_MAX]) {
+	const char * end = word_end(s);
+	if (end == s) {
+		ctx_error_set(ctx, BAD_COMMAND, s, NULL, 0);
+		return NULL;
+	}
+	if (end - s >= PATH_MAX) {
+		ctx_error_set(ctx, BAD_COMMAND, NULL, s, end - s);
+		return NULL;
+	}
+	memcpy(file, s, end - s);
+	file[end - s] = '\0';
+	return end;
+}
+
+// nothing after the arguments, at `s`
+// return 0, -1 on error
+static int args_end(struct calc_ctx * ctx, const char * s) {
+	s = skip_blank(s);
+	if ((*s != '\0') && (*s != '\n')) {
+		ctx_error_set(ctx, BAD_COMMAND, s, NULL, 0);
+		return -1;
+	}
+	return 0;
+}
+
+// evaluate the expression argument at `s` in `result`
+// return 0, -1 on error (or without expression)
+static int expression_arg(struct calc_ctx * ctx, const char * s, struct number * result) {
+	int res = eval_str(ctx, s, result);
+	if (res == 0) {
+		ctx_error_set(ctx, BAD_COMMAND, skip_blank(s), NULL, 0);
+	}
+	return (res > 0 ? 0 : -1);
+}
+
+static int run_write(struct calc_ctx * ctx, struct command_state * st, const char * args, FILE * out, struct number * value) {
+
+	char file[PATH_MAX];
+	const char * path_end = file_arg(ctx, args, file);
+	if (path_end == NULL) {
+		return -1;
+	}
+	const char * base_str = skip_blank(path_end);
+	const char * base_end = word_end(base_str);
+	if (base_str == base_end) {
+		ctx_error_set(ctx, BAD_COMMAND, base_str, NULL, 0);
+		return -1;
+	}
+	char * end;
+	long base = strtol(base_str, &end, 10);
+	if ((end != base_end) || ((base != 2) && (base != 4) && (base != 8) && (base != 16))) {
+		ctx_error_set(ctx, BAD_COMMAND, NULL, base_str, base_end - base_str);
+		return -1;
+	}
+
+	struct number result;
+	if (expression_arg(ctx, base_end, &result) < 0) {
+		return -1;
+	}
+	long written = number_write_file(file, &result, (int) base);
+	number_free(result);
+	if (written < 0) {
+		log_warn("command: can't write '%s': %s", file, strerror(errno));
+		ctx_error_set(ctx, WRITE_FAILED, NULL, args, path_end - args);
+		return -1;
+	}
+	fprintf(out, "wrote %ld bytes in '%s'", written, file);
+	return 0;
+}
+
+static int run_save(struct calc_ctx * ctx, struct command_state * st, const char * args, FILE * out, struct number * value) {
+
+	char file[PATH_MAX];
+	const char * path_end = file_arg(ctx, args, file);
+	if (path_end == NULL) {
+		return -1;
+	}
+	struct number result;
+	if (expression_arg(ctx, path_end, &result) < 0) {
+		return -1;
+	}
+	long written = -1;
+	int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd >= 0) {
+		written = number_save(&result, fd);
+		if ((close(fd) < 0) && (written >= 0)) {
+			written = -1;
+		}
+	}
+	number_free(result);
+	if (written < 0) {
+		log_warn("command: can't save in '%s': %s", file, strerror(errno));
+		ctx_error_set(ctx, WRITE_FAILED, NULL, args, path_end - args);
+		return -1;
+	}
+	fprintf(out, "saved %ld bytes in '%s'", written, file);
+	return 0;
+}
+
+static int run_load(struct calc_ctx * ctx, struct command_state * st, const char * args, FILE * out, struct number * value) {
+
+	char file[PATH_MAX];
+	const char * path_end = file_arg(ctx, args, file);
+	if (path_end == NULL) {
+		return -1;
+	}
+	if (args_end(ctx, path_end) < 0) {
+		return -1;
+	}
+
+	struct number num;
+	int res = -1;
+	ctx_error_reset(ctx);
+	int fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		ctx_bind(ctx); // for the memory of the number
+		res = number_load(fd, 0, &num);
+		ctx_bind(NULL);
+		int errsv = errno;
+		close(fd); // a mapping keeps the file
+		errno = errsv;
+	}
+	if (res < 0) {
+		if (ctx_error(ctx)) {
+			ctx_error_set(ctx, ctx_error(ctx), NULL, args, path_end - args);
+			return -1;
+		}
+		if (errno == EILSEQ) {
+			ctx_error_set(ctx, BAD_FILE, NULL, args, path_end - args);
+			return -1;
+		}
+		log_warn("command: can't load '%s': %s", file, strerror(errno));
+		ctx_error_set(ctx, READ_FAILED, NULL, args, path_end - args);
+		return -1;
+	}
+	unsigned char small[sizeof(long)];
+	const unsigned char * bytes;
+	int len;
+	int negative = number_bytes(&num, small, &bytes, &len);
+	fprintf(out, "loaded a %s value of %d bytes", (negative ? "negative" : "positive"), len); // never its digits
+	if (value == NULL) {
+		number_free(num);
+		return 0;
+	}
+	*value = num;
+	return 1;
+}
+
+static int run_snapshot(struct calc_ctx * ctx, struct command_state * st, const char * args, FILE * out, struct number * value) {
+
+	char file[PATH_MAX];
+	const char * path_end = file_arg(ctx, args, file);
+	if ((path_end == NULL) || (args_end(ctx, path_end) < 0)) {
+		return -1;
+	}
+	long written = session_snapshot(st->session, file);
+	if (written < 0) {
+		log_warn("command: can't write the snapshot '%s': %s", file, strerror(errno));
+		ctx_error_set(ctx, WRITE_FAILED, NULL, args, path_end - args);
+		return -1;
+	}
+	fprintf(out, "snapshot of %ld bytes in '%s'", written, file);
+	return 0;
+}
+
+// the name argument at `s`, its length in `*len`
+// return the end of the argument, NULL on error
+static const char * name_arg(struct calc_ctx * ctx, const char * s, int * len) {
+	const char * end = word_end(s);
+	if (end == s) {
+		ctx_error_set(ctx, BAD_COMMAND, s, NULL, 0);
+		return NULL;
+	}
+	*len = end - s;
+	return end;
+}
+
+// prepared expression `name` (`len` bytes), NULL if none, lock held
+static struct prepared * find_prepared(const struct command_state * cmd, const char * name, int len) {
+	for (int i = 0; i < cmd->prepared_len; i++) {
+		if ((strlen(cmd->prepared[i].name) == (size_t) len) && (strncmp(cmd->prepared[i].name, name, len) == 0)) {
+			return &cmd->prepared[i];
+		}
+	}
+	return NULL;
+}
+
+static int run_prepare(struct calc_ctx * ctx, struct command_state * cmd, const char * args, FILE * out, struct number * value) {
+
+	int len;
+	const char * name_end = name_arg(ctx, args, &len);
+	if (name_end == NULL) {
+		return -1;
+	}
+	struct program * p = program_compile(ctx, name_end, strcspn(name_end, "\n"));
+	if (p == NULL) {
+		if (!ctx_error(ctx)) { // no expression
+			ctx_error_set(ctx, BAD_COMMAND, skip_blank(name_end), NULL, 0);
+		}
+		return -1;
+	}
+
+	pthread_mutex_lock(&cmd->lock);
+	struct prepared * old = find_prepared(cmd, args, len);
+	if (old != NULL) {
+		program_free(old->p);
+		old->p = p;
+	}
+	else {
+		struct prepared * list = realloc(cmd->prepared, sizeof(struct prepared) * (cmd->prepared_len + 1));
+		char * name = strndup(args, len);
+		if ((list == NULL) || (name == NULL)) {
+			if (list != NULL) {
+				cmd->prepared = list;
+			}
+			pthread_mutex_unlock(&cmd->lock);
+			free(name);
+			program_free(p);
+			ctx_error_set(ctx, OUT_OF_MEM, NULL, args, len);
+			return -1;
+		}
+		cmd->prepared = list;
+		cmd->prepared[cmd->prepared_len].name = name;
+		cmd->prepared[cmd->prepared_len].p = p;
+		cmd->prepared_len++;
+	}
+	pthread_mutex_unlock(&cmd->lock);
+	fprintf(out, "prepared '%.*s' in %d instructions", len, args, p->len);
+	return 0;
+}
+
+static int run_run(struct calc_ctx * ctx, struct command_state * cmd, const char * args, FILE * out, struct number * value) {
+
+	int len;
+	const char * name_end = name_arg(ctx, args, &len);
+	if ((name_end == NULL) || (args_end(ctx, name_end) < 0)) { // one name
+		return -1;
+	}
+	pthread_mutex_lock(&cmd->lock);
+	struct prepared * prep = find_prepared(cmd, args, len);
+	if (prep == NULL) {
+		pthread_mutex_unlock(&cmd->lock);
+		ctx_error_set(ctx, NO_PROGRAM, NULL, args, len);
+		return -1;
+	}
+	struct number result;
+	int res = program_run(ctx, prep->p, &result);
+	pthread_mutex_unlock(&cmd->lock);
+	if (res < 0) { // the error is in the prepared expression, at its name here
+		ctx_error_set(ctx, ctx_error(ctx), NULL, args, len);
+		return -1;
+	}
+	if (value == NULL) {
+		number_fprint(out, &result);
+		number_free(result);
+		return 0;
+	}
+	*value = result;
+	return 2;
+}
+
+
+typedef int (* command_fn)(struct calc_ctx * ctx, struct command_state * st, const char * args, FILE * out, struct number * value);
+
+static const struct command {
+	const char * name;
+	command_fn run;
+	const char * usage; // in the message of `BAD_COMMAND`
+} commands[] = {
+	{COMMAND_WRITE,    run_write,    COMMAND_WRITE " <file> <base 2, 4, 8 or 16> <expression>"},
+	{COMMAND_SAVE,     run_save,     COMMAND_SAVE " <file> <expression>"},
+	{COMMAND_LOAD,     run_load,     COMMAND_LOAD " <file>"},
+	{COMMAND_SNAPSHOT, run_snapshot, COMMAND_SNAPSHOT " <file>"},
+	{COMMAND_PREPARE,  run_prepare,  COMMAND_PREPARE " <name> <expression>"},
+	{COMMAND_RUN,      run_run,      COMMAND_RUN " <name>"},
+};
+
+// command of `line`, NULL if it isn't one
+static const struct command * command_find(const char * line) {
+	line = skip_blank(line);
+	for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		size_t n = strlen(commands[i].name);
+		if ((strncmp(line, commands[i].name, n) == 0) && ((line[n] == '\0') || isspace((unsigned char) line[n]))) {
+			return &commands[i];
+		}
+	}
+	return NULL;
+}
+
+
+void command_state_init(struct command_state * cmd, const struct session * s) {
+	cmd->session = s;
+	pthread_mutex_init(&cmd->lock, NULL);
+	cmd->prepared = NULL;
+	cmd->prepared_len = 0;
+}
+
+void command_state_free(struct command_state * cmd) {
+	for (int i = 0; i < cmd->prepared_len; i++) {
+		program_free(cmd->prepared[i].p);
+		free(cmd->prepared[i].name);
+	}
+	free(cmd->prepared);
+	pthread_mutex_destroy(&cmd->lock);
+}
+
+int command_is(const char * line) {
+	return (command_find(line) != NULL);
+}
+
+int command_run(struct calc_ctx * ctx, struct command_state * cmd, const char * line, FILE * out, struct number * value) {
+	const struct command * c = command_find(line);
+	assert(c != NULL);
+	int res = c->run(ctx, cmd, skip_blank(skip_blank(line) + strlen(c->name)), out, value);
+	if ((res < 0) && (ctx_error(ctx) == BAD_COMMAND)) {
+		ctx->error.usage = c->usage;
+	}
+	return res;
+}
+
+
+
+/*
+	TEST
+*/
+
+
+// run `line` and return the content of the file `path` (to free), NULL on error
+static char * run_read(struct calc_ctx * ctx, struct command_state * cmd, const char * line, const char * path) {
+
+	char report[PATH_MAX + 64];
+	FILE * out = fmemopen(report, sizeof(report), "w");
+	assert(out != NULL);
+	int res = command_run(ctx, cmd, line, out, NULL);
+	fclose(out);
+	if (res < 0) {
+		return NULL;
+	}
+	struct stat st;
+	assert(stat(path, &st) == 0);
+	char * text = malloc(st.st_size + 1);
+	CHECK_MALLOC(text, "test command");
+	FILE * in = fopen(path, "r");
+	assert(in != NULL);
+	assert(fread(text, 1, st.st_size, in) == (size_t) st.st_size);
+	text[st.st_size] = '\0';
+	fclose(in);
+	char expected[64];
+	snprintf(expected, sizeof(expected), "wrote %ld bytes in ", (long) st.st_size);
+	assert(strncmp(report, expected, strlen(expected)) == 0);
+	return text;
+}
+
+void test_command() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("COMMAND:\n");
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "test command");
+	struct session session;
+	session_init(&session);
+	struct command_state cmd;
+	command_state_init(&cmd, &session);
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/calcul-test-%d.txt", (int) getpid());
+	char line[256];
+	char * text;
+
+
+	printf(" command_is\n");
+	assert(command_is(COMMAND_WRITE " f 16 1"));
+	assert(command_is("  " COMMAND_WRITE "\n"));
+	assert(command_is(COMMAND_SAVE " f 1") && command_is(COMMAND_LOAD " f"));
+	assert(command_is(COMMAND_SNAPSHOT " f"));
+	assert(command_is(COMMAND_PREPARE " p 1") && command_is(COMMAND_RUN " p"));
+	assert(!command_is(COMMAND_WRITE "r f 16 1"));
+	assert(!command_is("1 + 1"));
+
+
+	printf(" bases\n");
+	snprintf(line, sizeof(line), COMMAND_WRITE " %s 16 2 ^ 64\n", path);
+	text = run_read(ctx, &cmd, line, path);
+	assert((text != NULL) && (strcmp(text, "0x10000000000000000\n") == 0));
+	free(text);
+
+	snprintf(line, sizeof(line), COMMAND_WRITE " %s 2 -5", path);
+	text = run_read(ctx, &cmd, line, path);
+	assert((text != NULL) && (strcmp(text, "-2x101\n") == 0));
+	free(text);
+
+	snprintf(line, sizeof(line), COMMAND_WRITE "\t%s  8  8 * 8", path);
+	text = run_read(ctx, &cmd, line, path);
+	assert((text != NULL) && (strcmp(text, "8x100\n") == 0));
+	free(text);
+
+
+	printf(" blocks\n");
+	int n = 2 * OUTPUT_BUFFER; // digits, more than the buffer
+	snprintf(line, sizeof(line), COMMAND_WRITE " %s 2 2 ^ %d", path, n - 1);
+	text = run_read(ctx, &cmd, line, path);
+	assert(text != NULL);
+	assert((int) strlen(text) == 2 + n + 1);
+	assert(strncmp(text, "2x1000", 6) == 0);
+	assert(strspn(text + 3, "0") == (size_t) n - 1);
+	free(text);
+
+
+	printf(" save and load\n");
+	char bin[64];
+	snprintf(bin, sizeof(bin), "/tmp/calcul-test-%d.bin", (int) getpid());
+	const char * values[] = {"-3 ^ 301", "12345", "-1", "2 ^ 64"};
+	for (int i = 0; i < 4; i++) {
+		snprintf(line, sizeof(line), COMMAND_SAVE " %s %s", bin, values[i]);
+		char report[256];
+		FILE * out = fmemopen(report, sizeof(report), "w");
+		assert(command_run(ctx, &cmd, line, out, NULL) == 0);
+		fclose(out);
+		assert(strncmp(report, "saved ", 6) == 0);
+
+		char loaded[256];
+		char expected[256];
+		snprintf(line, sizeof(line), COMMAND_LOAD " %s\n", bin);
+		out = fmemopen(loaded, sizeof(loaded), "w");
+		struct number value;
+		assert(command_run(ctx, &cmd, line, out, &value) == 1);
+		fclose(out);
+
+		struct number result;
+		assert(eval_str(ctx, values[i], &result) == 1);
+		unsigned char small[sizeof(long)];
+		const unsigned char * bytes;
+		int len;
+		int negative = number_bytes(&result, small, &bytes, &len);
+		snprintf(expected, sizeof(expected), "loaded a %s value of %d bytes", (negative ? "negative" : "positive"), len);
+		assert(strcmp(loaded, expected) == 0);
+
+		number_free(result);
+
+		ctx->last = &value; // usable in the next expressions
+		struct number next;
+		assert(eval_str(ctx, CONSOLE_LAST " + 1", &next) == 1);
+		ctx->last = NULL;
+		number_free(value);
+		char plus_one[64];
+		snprintf(plus_one, sizeof(plus_one), "(%s) + 1", values[i]);
+		assert(eval_str(ctx, plus_one, &result) == 1);
+		out = fmemopen(loaded, sizeof(loaded), "w");
+		number_fprint(out, &next);
+		fclose(out);
+		out = fmemopen(expected, sizeof(expected), "w");
+		number_fprint(out, &result);
+		fclose(out);
+		assert(strcmp(loaded, expected) == 0);
+		number_free(next);
+		number_free(result);
+
+		out = fmemopen(loaded, sizeof(loaded), "w"); // without a last result
+		assert(command_run(ctx, &cmd, line, out, NULL) == 0);
+		fclose(out);
+		assert(strncmp(loaded, "loaded ", 7) == 0);
+	}
+	FILE * file = fopen(bin, "r+");
+	assert(file != NULL);
+	fseek(file, -1, SEEK_END);
+	fputc(0x42, file);
+	fclose(file);
+	snprintf(line, sizeof(line), COMMAND_LOAD " %s", bin);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == BAD_FILE);
+	assert(error_column(&ctx->error, line) == (int) strlen(COMMAND_LOAD) + 1);
+	unlink(bin);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == READ_FAILED);
+	snprintf(line, sizeof(line), COMMAND_LOAD " %s 1", bin);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+	snprintf(line, sizeof(line), COMMAND_SAVE " %s", bin);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+
+
+	printf(" snapshot\n");
+	snprintf(line, sizeof(line), COMMAND_SNAPSHOT " %s\n", bin);
+	char report[PATH_MAX + 64];
+	FILE * out = fmemopen(report, sizeof(report), "w");
+	assert(command_run(ctx, &cmd, line, out, NULL) == 0);
+	fclose(out);
+	assert(strncmp(report, "snapshot of ", 12) == 0);
+	struct session restored;
+	session_init(&restored);
+	assert((session_restore(&restored, bin) == 0) && !restored.has_last);
+	session_free(&restored);
+	snprintf(line, sizeof(line), COMMAND_SNAPSHOT " %s 1", bin);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+	assert(run_read(ctx, &cmd, COMMAND_SNAPSHOT " /nonexistent/dir/f", path) == NULL);
+	assert(ctx_error(ctx) == WRITE_FAILED);
+	unlink(bin);
+
+
+	printf(" prepare and run\n");
+	out = fmemopen(report, sizeof(report), "w");
+	assert(command_run(ctx, &cmd, COMMAND_PREPARE " next " CONSOLE_LAST " * 3 + 1\n", out, NULL) == 0);
+	fclose(out);
+	assert(strcmp(report, "prepared 'next' in 5 instructions") == 0);
+	struct number last = str_to_number(1, "4");
+	ctx->last = &last;
+	struct number value;
+	assert(command_run(ctx, &cmd, COMMAND_RUN " next", stdout, &value) == 2); // nothing written
+	assert((value.type == INTEGER) && (value.data.integer == 13));
+	ctx->last = NULL;
+	number_free(last);
+	out = fmemopen(report, sizeof(report), "w");
+	assert(command_run(ctx, &cmd, COMMAND_PREPARE " next 2 ^ 64", out, NULL) == 0); // replaced
+	fclose(out);
+	out = fmemopen(report, sizeof(report), "w");
+	assert(command_run(ctx, &cmd, COMMAND_RUN " next\n", out, NULL) == 0);
+	fclose(out);
+	assert(strcmp(report, "0x10000000000000000") == 0);
+	out = fmemopen(report, sizeof(report), "w");
+	assert(command_run(ctx, &cmd, COMMAND_RUN " other", out, &value) < 0);
+	assert(ctx_error(ctx) == NO_PROGRAM);
+	assert(command_run(ctx, &cmd, COMMAND_RUN " next 1", out, &value) < 0);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+	assert(command_run(ctx, &cmd, COMMAND_PREPARE " empty ", out, &value) < 0);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+	assert(command_run(ctx, &cmd, COMMAND_PREPARE " last 1 + " CONSOLE_LAST, out, NULL) == 0);
+	snprintf(line, sizeof(line), COMMAND_RUN " last");
+	assert(command_run(ctx, &cmd, line, out, &value) < 0); // no last result
+	assert(error_column(&ctx->error, line) == (int) strlen(COMMAND_RUN) + 1);
+	fclose(out);
+
+
+	printf(" errors\n");
+	assert(run_read(ctx, &cmd, COMMAND_WRITE, path) == NULL);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+	char message[256];
+	out = fmemopen(message, sizeof(message), "w");
+	error_fprint(out, &ctx->error);
+	fclose(out);
+	assert(strcmp(message, "Command: usage " COMMAND_WRITE " <file> <base 2, 4, 8 or 16> <expression>") == 0);
+	assert(run_read(ctx, &cmd, COMMAND_RUN, path) == NULL);
+	out = fmemopen(message, sizeof(message), "w");
+	error_fprint(out, &ctx->error);
+	fclose(out);
+	assert(strcmp(message, "Command: usage " COMMAND_RUN " <name>") == 0); // only the one of the command
+	snprintf(line, sizeof(line), COMMAND_WRITE " %s 10 1", path);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+	assert(error_column(&ctx->error, line) == (int) strlen(line) - 4);
+	snprintf(line, sizeof(line), COMMAND_WRITE " %s 16", path);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == BAD_COMMAND);
+	snprintf(line, sizeof(line), COMMAND_WRITE " %s 16 1 # 2", path);
+	assert(run_read(ctx, &cmd, line, path) == NULL);
+	assert(ctx_error(ctx) == UNKNOWN_SYM);
+	assert(run_read(ctx, &cmd, COMMAND_WRITE " /nonexistent/dir/f 16 1", path) == NULL);
+	assert(ctx_error(ctx) == WRITE_FAILED);
+
+
+	unlink(path);
+	command_state_free(&cmd);
+	session_free(&session);
+	ctx_free(ctx);
+	printf("done\n\n");
+	#endif
+}
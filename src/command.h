@@ -0,0 +1,82 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+#include "program.h"
+#include "session.h"
+
+
+/*
+	Commands of the console and the batch
+
+A line starting with the name of a command isn't an expression:
+
+	:write <file> <base> <expression>
+	:save <file> <expression>
+	:load <file>
+	:snapshot <file>
+	:prepare <name> <expression>
+	:run <name>
+
+`:write` evaluates the expression and writes its digits in base 2, 4, 8 or 16
+(with the prefix of the lexer, like `0x2a`) in the file, block by block: the
+digits of a huge result are never all in memory.
+`:save` writes the result in binary (see `big_int_save`), `:load` takes a saved
+result without parsing it and replies with its sign and its size, in the console
+it is the last result from then on (`CONSOLE_LAST`).
+`:snapshot` saves the session (see session.h), in the batch its configuration only.
+`:prepare` compiles the expression once (see program.h) and `:run` evaluates it
+again, its result is the last result of the console. The workers of the batch
+share the prepared expressions, a run holds them (a program is run by one thread
+at a time).
+*/
+
+
+// an expression of `:prepare`
+struct prepared {
+	char * name;
+	struct program * p;
+};
+
+// what the commands of a console or a batch share
+struct command_state {
+	const struct session * session; // saved by `:snapshot`
+	pthread_mutex_t lock;       // of the prepared expressions
+	struct prepared * prepared;
+	int prepared_len;
+};
+
+
+// `s` is saved by `:snapshot`, no prepared expression
+void command_state_init(struct command_state * cmd, const struct session * s);
+
+void command_state_free(struct command_state * cmd);
+
+
+// return 1 if `line` is a command
+int command_is(const char * line);
+
+// run the command `line` (up to '\n' or '\0') and write its report (without '\n') in `out`
+// the value of `:load` and the result of `:run` go in `*value` (to free), without `value`
+// the value is freed and the result is written in `out`
+// return 0, 1 if `*value` is set, 2 if it is set to a result not written, -1 on error
+// (the error of `ctx` points in `line`)
+int command_run(struct calc_ctx * ctx, struct command_state * cmd, const char * line, FILE * out, struct number * value);
+
+
+void test_command();
+
+
+#endif // COMMAND_H
@@ -16,6 +16,81 @@
 #define CONSOLE_QUIT_WORD "q"
 #define CONSOLE_INTRO_MSG "\nHi!\nJust type '"CONSOLE_QUIT_WORD"' to leave the program\n"
 #define CONSOLE_QUIT_MSG  "Bye!\n"
+#define CONSOLE_LAST "_" // name of the last result in the expressions
+
+
+// COMMAND
+#define COMMAND_WRITE ":write" // <file> <base> <expression>, write the digits of the result in a file
+#define COMMAND_SAVE  ":save"  // <file> <expression>, save the result in binary
+#define COMMAND_LOAD  ":load"  // <file>, result saved by COMMAND_SAVE
+#define COMMAND_SNAPSHOT ":snapshot" // <file>, save the session (see `session.h`)
+#define COMMAND_PREPARE ":prepare" // <name> <expression>, compile the expression once (see `program.h`)
+#define COMMAND_RUN     ":run"     // <name>, evaluate a prepared expression
+
+
+// STREAM
+#define STREAM_CHUNK   (64 << 10) // bytes of a line read at once
+#define STREAM_LITERAL (64 << 10) // literals from that many bytes are converted while read, not kept as text
+#define STREAM_NAME "_" // then its index, name of a streamed literal in the line
+
+
+// BATCH
+#define BATCH_BLOCK_SIZE (1 << 20) // bytes read (and buffered in output) at once
+#define BATCH_CHUNK_SIZE (64 << 10) // bytes of lines given at once to a worker thread
+#define BATCH_QUEUE   4 // chunks in flight per worker thread
+#define BATCH_THREADS 0 // worker threads (0 is one per core)
+#define BATCH_POOL_THREADS 4 // from that many threads chunks on a pool, under it a pipeline of the stages of the lines
+#define BATCH_PIPELINE_DEPTH 64  // lines between two stages of the pipeline
+#define BATCH_PIPELINE_SPIN  1000 // checks of the next stage before sleeping on the futex
+
+
+// SERVER
+#define SERVER_PIPELINE 256 // requests of a connection evaluated at once
+#define SERVER_READ_SIZE (64 << 10) // bytes read at once from a connection
+#define SERVER_OUT_MAX (1 << 20) // stop reading a connection with that many bytes of replies not sent
+#define SERVER_BACKLOG 128 // connections waiting to be accepted
+#define SERVER_EVENTS  64  // epoll events handled at once
+#define SERVER_STATS ":stats" // request of the statistics of the scheduler
+
+
+// SCHED
+#define SCHED_TINY_COST 1e6 // byte operations (estimated) of the longest tiny evaluation, about a millisecond
+#define SCHED_BUCKETS   32  // of the histogram of the waits, in powers of 2 microseconds
+
+
+// RING
+#define RING_SLOTS     64   // expressions in flight in the shared memory
+#define RING_SLOT_SIZE 4096 // bytes of a slot (expression or result)
+#define RING_SPIN      1000 // checks of the other side before sleeping on the futex
+
+
+// ALLOC
+#define ALLOC_MAP_THRESHOLD (4 << 20) // blocks from 4 MiB are mmap-ed
+#define ALLOC_SPILL_THRESHOLD ((size_t) 1 << 30) // and from 1 GiB in a scratch file (if any)
+#define ALLOC_EVAL_BUDGET 0    // bytes per evaluation (0 is unlimited)
+#define ALLOC_PROCESS_BUDGET 0 // bytes for the whole process (0 is unlimited)
+
+
+// ESTIMATE
+#define ESTIMATE_MAX_SIZE ((size_t) 1 << 32) // refuse results estimated over 4 GiB (0 is no limit)
+#define ESTIMATE_RESERVE_MIN 64 // pre-size operands for results from 64 bytes
+
+
+// CANCEL
+#define CANCEL_TIMEOUT 0  // seconds per evaluation (0 is no limit)
+#define CANCEL_BLOCK   64 // iterations of a kernel loop between two checks
+
+
+// OUTPUT
+#define OUTPUT_BUFFER (64 << 10) // bytes of digits formatted before a write
+
+
+// PROGRESS
+#define PROGRESS_INTERVAL 0.5 // seconds between two progress lines
+
+
+// CHECKPOINT
+#define CHECKPOINT_INTERVAL 600 // seconds between two checkpoints of a long power
 
 
 // LOG
@@ -25,16 +25,16 @@ static void print_leave_msg() {
 	printf(CONSOLE_QUIT_MSG);
 }
 
-static void print_error(const char * input_line) {
+static void print_error(const struct calc_ctx * ctx, const char * input_line) {
 
 	int n = strlen(CONSOLE_PROMPT);
 	for (int i = 0; i < n; i++) {
 		printf(" ");
 	}
 	
-	error_underline(input_line);
+	error_underline(&ctx->error, input_line);
 	printf("\n");
-	error_message();
+	error_fprint(stdout, &ctx->error);
 	printf("\n\n");
 }
 
@@ -43,66 +43,72 @@ static void print_error(const char * input_line) {
 	CONSOLE
 */
 
-void console() {
+void console(struct session * s) {
 
-	size_t linecap = CONSOLE_LINE_SIZE;
-	char *line = malloc(linecap);
-	CHECK_MALLOC(line, "line in console\n");
+	struct stream in; // a line of a huge literal is never kept as a whole
+	if (stream_init(&in) < 0) {
+		CHECK_MALLOC(NULL, "line in console\n");
+	}
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "console context");
+	struct command_state commands;
+	command_state_init(&commands, s);
 
+	cancel_catch_sigint(); // Ctrl-C interrupts the evaluation
 	print_intro_msg();
 
 	while (1) {
 
 		print_prompt();
-		if (getline(&line, &linecap, stdin) < 0) {
-			log_fatal("getline error");
+		stream_reset(ctx, &in);
+		if (stream_read(ctx, &in, stdin) == 0) {
+			log_fatal("end of the input");
 			break;
 		}
+		char * line = in.text;
+		if (stream_check(ctx, &in) < 0) {
+			print_error(ctx, line);
+			continue;
+		}
 		if (check_leave_cmd(line)) {
 			break;
 		}
 
-		// lexer
-		struct expr e1 = lexer(line);
-		if (error_get()) {
-			print_error(line);
-			token_free_expr(&e1);
-			continue;
-		}
-		if (e1.len == 0) {
-			token_free_expr(&e1);
+		ctx->last = (s->has_last ? &s->last : NULL);
+		if (command_is(line)) {
+			struct number value;
+			int res = command_run(ctx, &commands, line, stdout, &value);
+			if (res < 0) {
+				print_error(ctx, line);
+				continue;
+			}
+			if (res == 2) { // `:run`, as an expression
+				number_print(&value);
+			}
+			if (res > 0) { // `:load` or `:run`, the value is the last result
+				session_set_last(s, value);
+			}
+			printf("\n\n");
 			continue;
 		}
 
-		// parser
-		struct expr e2 = lexer_to_parser(&e1);
-		token_free_expr(&e1);
-		if (error_get()) {
-			print_error(line);
-			token_free_expr(&e2);
+		struct number result;
+		int res = eval_str(ctx, line, &result);
+		if (res < 0) {
+			print_error(ctx, line);
 			continue;
 		}
-		if (parser_check_syntax(e2)) {
-			print_error(line);
-			token_free_expr(&e2);
-			continue;
-		}
-
-		// eval
-		struct number result = eval(e2);
-		token_free_expr(&e2);
-		if (error_get()) {
-			print_error(line);
-			number_free(result);
+		if (res == 0) { // empty line
 			continue;
 		}
 
 		number_print(&result);
-		number_free(result);
+		session_set_last(s, result);
 		printf("\n\n");
 	}
 	print_leave_msg();
-	LOG_FREE(line);
-	free(line);
+	command_state_free(&commands);
+	stream_reset(ctx, &in);
+	ctx_free(ctx);
+	stream_free(&in);
 }
-
@@ -2,20 +2,29 @@
 #define CONSOLE_H
 
 #include <assert.h>
+#include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "cancel.h"
+#include "command.h"
 #include "config.h"
+#include "context.h"
 #include "eval.h"
 #include "error.h"
 #include "lexer.h"
 #include "log.h"
 #include "number.h"
 #include "parser.h"
+#include "program.h"
+#include "session.h"
+#include "stream.h"
 #include "token.h"
 
 
-void console();
+// `s` keeps the last result
+void console(struct session * s);
 
 
 #endif // CONSOLE_H
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "context.h"
+
+
+static struct calc_config defaults = {ESTIMATE_MAX_SIZE, ALLOC_EVAL_BUDGET, CANCEL_TIMEOUT};
+
+
+void ctx_set_default(const struct calc_config * config) {
+	defaults = *config;
+}
+
+struct calc_ctx * ctx_new() {
+	struct calc_ctx * ctx = alloc_malloc(sizeof(struct calc_ctx));
+	log_trace("malloc %p: context", ctx);
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	error_state_set(&ctx->error, NO_ERROR, NULL, NULL, 0);
+	ctx->config = defaults;
+	ctx->alloc.budget = 0;
+	ctx->alloc.used   = 0;
+	ctx->alloc.heap   = NULL;
+	ctx->max_cost  = 0;
+	ctx->last      = NULL;
+	ctx->literal   = NULL;
+	ctx->literals  = 0;
+	ctx->literal_cap = 0;
+	ctx->operators = NULL;
+	ctx->est       = NULL;
+	ctx->est_cap   = 0;
+	ctx->lit       = NULL;
+	ctx->lit_cap   = 0;
+	return ctx;
+}
+
+void ctx_free(struct calc_ctx * ctx) {
+	ctx_free_literals(ctx);
+	LOG_FREE(ctx->literal);
+	alloc_free(ctx->literal);
+	if (ctx->operators != NULL) {
+		stack_free(ctx->operators);
+	}
+	LOG_FREE(ctx->est);
+	alloc_free(ctx->est);
+	LOG_FREE(ctx->lit);
+	alloc_free(ctx->lit);
+	LOG_FREE(ctx);
+	alloc_free(ctx);
+}
+
+
+int ctx_error(const struct calc_ctx * ctx) {
+	return (int) ctx->error.type;
+}
+
+void ctx_error_set(struct calc_ctx * ctx, enum error_type err, const char * cursor, const char * word, int len) {
+	error_state_set(&ctx->error, err, cursor, word, len);
+}
+
+void ctx_error_reset(struct calc_ctx * ctx) {
+	error_state_set(&ctx->error, NO_ERROR, NULL, NULL, 0);
+}
+
+
+// index of a streamed literal named `str`, -1 if none
+static int literal_index(const struct calc_ctx * ctx, const char * str, int len) {
+	int n = strlen(STREAM_NAME);
+	if ((len <= n) || (len > n + 9) || (strncmp(str, STREAM_NAME, n) != 0)) {
+		return -1;
+	}
+	int i = 0;
+	for (int k = n; k < len; k++) {
+		if (!isdigit((unsigned char) str[k])) {
+			return -1;
+		}
+		i = 10 * i + (str[k] - '0');
+	}
+	return (i < ctx->literals ? i : -1);
+}
+
+const struct number * ctx_name(const struct calc_ctx * ctx, const char * str, int len) {
+	if ((ctx->last != NULL) && (len == (int) strlen(CONSOLE_LAST)) && (strncmp(str, CONSOLE_LAST, len) == 0)) {
+		return ctx->last;
+	}
+	int i = literal_index(ctx, str, len);
+	return (i >= 0 ? &ctx->literal[i] : NULL);
+}
+
+int ctx_take_name(struct calc_ctx * ctx, const char * str, int len, struct number * num) {
+	int i = literal_index(ctx, str, len);
+	if (i >= 0) {
+		*num = ctx->literal[i];
+		ctx->literal[i].type = INTEGER; // taken
+		ctx->literal[i].data.integer = 0;
+		return 1;
+	}
+	const struct number * last = ctx_name(ctx, str, len);
+	if (last == NULL) {
+		return 0;
+	}
+	*num = number_dup(last);
+	return 1;
+}
+
+int ctx_add_literal(struct calc_ctx * ctx, struct number num) {
+	if (ctx->literals == ctx->literal_cap) {
+		int cap = (ctx->literal_cap > 0 ? 2 * ctx->literal_cap : 4);
+		struct number * literal = alloc_realloc(ctx->literal, sizeof(struct number) * cap);
+		if (literal == NULL) {
+			number_free(num);
+			return -1;
+		}
+		ctx->literal = literal;
+		ctx->literal_cap = cap;
+	}
+	ctx->literal[ctx->literals] = num;
+	return ctx->literals++;
+}
+
+void ctx_free_literals(struct calc_ctx * ctx) {
+	for (int i = 0; i < ctx->literals; i++) {
+		number_free(ctx->literal[i]);
+	}
+	ctx->literals = 0;
+}
+
+
+void ctx_bind(struct calc_ctx * ctx) {
+	error_bind(ctx != NULL ? &ctx->error : NULL);
+	alloc_bind(ctx != NULL ? &ctx->alloc : NULL);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+void test_context() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("CONTEXT:\n");
+
+
+	printf(" ctx_new\n");
+	struct calc_ctx * c1 = ctx_new();
+	struct calc_ctx * c2 = ctx_new();
+	assert(ctx_error(c1) == NO_ERROR);
+	assert(c1->config.max_size == ESTIMATE_MAX_SIZE);
+
+
+	printf(" ctx_bind\n");
+	error_reset();
+	ctx_bind(c1);
+	error_set(POW_NEG, NULL, NULL, 0);
+	assert(ctx_error(c1) == POW_NEG);
+	assert(ctx_error(c2) == NO_ERROR);
+
+	ctx_bind(c2);
+	assert(error_get() == NO_ERROR);
+	void * block = alloc_malloc(100);
+	assert(c2->alloc.used == 100);
+	assert(c1->alloc.used == 0);
+	alloc_free(block);
+	assert(c2->alloc.used == 0);
+
+	ctx_bind(NULL);
+	assert(error_get() == NO_ERROR); // the thread's own state
+	ctx_error_reset(c1);
+	assert(ctx_error(c1) == NO_ERROR);
+
+
+	printf(" ctx_set_default\n");
+	struct calc_config config = {10, 20, 1.5};
+	ctx_set_default(&config);
+	struct calc_ctx * c3 = ctx_new();
+	assert(c3->config.eval_budget == 20);
+	assert(c1->config.eval_budget == ALLOC_EVAL_BUDGET);
+	config = (struct calc_config) {ESTIMATE_MAX_SIZE, ALLOC_EVAL_BUDGET, CANCEL_TIMEOUT};
+	ctx_set_default(&config);
+
+
+
+	printf(" names\n");
+	struct number last = str_to_number(2, "42");
+	c1->last = &last;
+	assert(ctx_name(c1, CONSOLE_LAST, strlen(CONSOLE_LAST)) == &last);
+	assert(ctx_name(c1, STREAM_NAME "0", strlen(STREAM_NAME) + 1) == NULL);
+	assert(ctx_add_literal(c1, str_to_number(20, "18446744073709551616")) == 0); // 2 ^ 64
+	assert(ctx_add_literal(c1, str_to_number(1, "7")) == 1);
+	const struct number * lit = ctx_name(c1, STREAM_NAME "0", strlen(STREAM_NAME) + 1);
+	assert((lit != NULL) && (lit->type == BIG));
+	struct number num;
+	assert(ctx_take_name(c1, STREAM_NAME "1", strlen(STREAM_NAME) + 1, &num) == 1);
+	assert((num.type == INTEGER) && (num.data.integer == 7));
+	assert(ctx_take_name(c1, STREAM_NAME "2", strlen(STREAM_NAME) + 1, &num) == 0);
+	assert(ctx_take_name(c1, "x", 1, &num) == 0);
+	ctx_free_literals(c1);
+	assert(ctx_name(c1, STREAM_NAME "0", strlen(STREAM_NAME) + 1) == NULL);
+
+	ctx_free(c1);
+	ctx_free(c2);
+	ctx_free(c3);
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,91 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "alloc.h"
+#include "config.h"
+#include "error.h"
+#include "log.h"
+#include "number.h"
+#include "stack.h"
+
+
+/*
+	Evaluation context
+
+Everything an evaluation needs besides its input: the error state, the
+configuration, the memory counter given to the allocator and scratch buffers
+kept from an evaluation to the next one. `lexer`, `lexer_to_parser`,
+`parser_check_syntax`, `shunting_yard` and `eval` take the context explicitly.
+During `eval`, the context is bound to the thread for the number layer (see
+`ctx_bind`).
+
+A context is used by one thread at a time, two contexts evaluate concurrently.
+*/
+
+
+struct calc_config {
+	size_t max_size;    // refuse results estimated bigger (0 is no limit)
+	size_t eval_budget; // memory of one evaluation in bytes (0 is unlimited)
+	double timeout;     // time of one evaluation in seconds (0 is no limit)
+};
+
+struct calc_ctx {
+	struct error_state error;
+	struct calc_config config;
+	struct alloc_eval alloc; // memory of the running evaluation
+	double max_cost; // stop with `DEFERRED` before an evaluation estimated longer (0 is no limit)
+	const struct number * last; // value of the name `CONSOLE_LAST`, NULL if none
+	struct number * literal;    // converted while read (see stream.h), named `STREAM_NAME` and their index
+	int literals;
+	int literal_cap;
+
+	// scratch buffers
+	struct stack * operators; // of `shunting_yard`
+	struct estimate * est;    // of `eval`
+	int est_cap;
+	struct number * lit;      // of `eval`, its literals converted before the evaluation
+	int lit_cap;
+};
+
+
+// configuration of the next contexts
+void ctx_set_default(const struct calc_config * config);
+
+// return NULL if no memory
+struct calc_ctx * ctx_new();
+
+void ctx_free(struct calc_ctx * ctx);
+
+
+int ctx_error(const struct calc_ctx * ctx);
+
+void ctx_error_set(struct calc_ctx * ctx, enum error_type err, const char * cursor, const char * word, int len);
+
+void ctx_error_reset(struct calc_ctx * ctx);
+
+
+// value of the name `str` (`len` bytes): `CONSOLE_LAST` or a streamed literal, NULL if unknown
+const struct number * ctx_name(const struct calc_ctx * ctx, const char * str, int len);
+
+// value of the name for an evaluation: a copy of `CONSOLE_LAST`, a streamed literal itself (once)
+// return 0 if unknown (`num` is set, with the error if no memory, otherwise)
+int ctx_take_name(struct calc_ctx * ctx, const char * str, int len, struct number * num);
+
+// name `num` after the streamed literals, return its index, -1 if no memory (`num` is freed)
+int ctx_add_literal(struct calc_ctx * ctx, struct number num);
+
+// free the streamed literals (not taken by an evaluation)
+void ctx_free_literals(struct calc_ctx * ctx);
+
+
+// `error_get`, `error_set` and the allocator use `ctx` in the calling thread (NULL to unbind)
+void ctx_bind(struct calc_ctx * ctx);
+
+
+void test_context();
+
+
+#endif // CONTEXT_H
@@ -1,28 +1,34 @@
 #include "error.h" 
 
 
-// global variable for error management
+// state used by `error_get`, `error_set`, `error_reset` (see `error_bind`)
+static __thread struct error_state own = {NO_ERROR, NULL, NULL, 0, NULL};
+static __thread struct error_state * bound = NULL;
 
-enum error_type   error = NO_ERROR;
+static struct error_state * current() {
+	return (bound != NULL ? bound : &own);
+}
 
-struct error_expr {
-	const char * character;
-	const char * word;
-	int length;
-} err_data;
 
+void error_bind(struct error_state * state) {
+	bound = state;
+}
 
+void error_state_set(struct error_state * state, enum error_type err, const char * cursor, const char * word, int len) {
+	state->type      = err;
+	state->character = cursor;
+	state->word      = word;
+	state->length    = len;
+	state->usage     = NULL;
+}
 
 
 int error_get() {
-	return (int) error;
+	return (int) current()->type;
 }
 
 void error_set(enum error_type err, const char * cursor, const char * word, int len) {
-	error = err;
-	err_data.character = cursor;
-	err_data.word      = word;
-	err_data.length    = len;
+	error_state_set(current(), err, cursor, word, len);
 }
 
 void error_reset() {
@@ -67,66 +73,120 @@ static void underline_all(int idc, int idw, int len) {
 	word(idc + 1, idw + len - idc - 1);
 }
 
-void error_underline(const char * input) {
+void error_underline(const struct error_state * e, const char * input) {
 
-	if (err_data.character != NULL) {
-		if (err_data.word != NULL) {
-			underline_all(err_data.character - input, err_data.word - input, err_data.length);
+	if (e->character != NULL) {
+		if (e->word != NULL) {
+			underline_all(e->character - input, e->word - input, e->length);
 			return;
 		}
-		cursor(err_data.character - input);
+		cursor(e->character - input);
 		return;
 	} 
-	if (err_data.word != NULL) {
-		word(err_data.word - input, err_data.length);
+	if (e->word != NULL) {
+		word(e->word - input, e->length);
 	}
 }
 
 
-void error_message() {
+int error_column(const struct error_state * e, const char * input) {
+	if (e->character != NULL) {
+		return e->character - input;
+	}
+	if (e->word != NULL) {
+		return e->word - input;
+	}
+	return -1;
+}
 
-	switch (error) {
+
+void error_fprint(FILE * out, const struct error_state * e) {
+
+	switch (e->type) {
 		case NO_ERROR:
-			printf("NO error has occured");
+			fprintf(out, "NO error has occured");
 			break;
 		// lexer
 		case UNKNOWN_SYM:
-			printf("Lexer: Unknown symbol '%.*s'", 1, err_data.character);
+			fprintf(out, "Lexer: Unknown symbol '%.*s'", 1, e->character);
 			break;
 		case WRONG_BASE:
-			printf("Lexer: Number %c-based contains digit '%c' (wrong base)", *err_data.word, *err_data.character);
+			fprintf(out, "Lexer: Number %c-based contains digit '%c' (wrong base)", *e->word, *e->character);
+			break;
+		case TOO_LONG:
+			fprintf(out, "Lexer: expression longer than 4 GiB");
 			break;
 		// parser
 		case UNKNOWN_TOK:
-			printf("Parser: Unknown token '%.*s'", err_data.length, err_data.word);
+			fprintf(out, "Parser: Unknown token '%.*s'", e->length, e->word);
 			break;
 		case MIS_PARENT:
-			printf("Syntax: Mismatch parenthesis %.*s", 1, err_data.character);
+			fprintf(out, "Syntax: Mismatch parenthesis %.*s", 1, e->character);
 			break;
 		case UNEXP_TOK:
-			printf("Syntax: Unexpected token '%.*s'", err_data.length, err_data.word);
+			fprintf(out, "Syntax: Unexpected token '%.*s'", e->length, e->word);
 			break;
 		case MIS_ARG_SEP:
-			printf("Syntax: Misplace comma");
-			if (err_data.word != NULL) {
-				printf(" in function '%.*s'", err_data.length, err_data.word);
+			fprintf(out, "Syntax: Misplace comma");
+			if (e->word != NULL) {
+				fprintf(out, " in function '%.*s'", e->length, e->word);
 			}
 			break;
 		// eval
 		case UNMANAGED:
-			printf("Eval: Unmanaged feature");
-			if (err_data.word != NULL) {
-				printf(" '%.*s' ", err_data.length, err_data.word);
-			} else if (err_data.character) {
-				printf(" '%c' ", *err_data.character);
+			fprintf(out, "Eval: Unmanaged feature");
+			if (e->word != NULL) {
+				fprintf(out, " '%.*s' ", e->length, e->word);
+			} else if (e->character) {
+				fprintf(out, " '%c' ", *e->character);
 			}
-			printf("(yet)");
+			fprintf(out, "(yet)");
 			break;
 		case POW_BIG:
-			printf("Eval: exponent too big, it must fit in a long integer");
+			fprintf(out, "Eval: exponent too big, it must fit in a long integer");
 			break;
 		case POW_NEG:
-			printf("Eval: negative exponent isn't allowed");
+			fprintf(out, "Eval: negative exponent isn't allowed");
+			break;
+		case TOO_BIG:
+			fprintf(out, "Eval: the result is estimated bigger than the size limit");
+			break;
+		case CANCELLED:
+			fprintf(out, "Eval: cancelled");
+			break;
+		case TIMEOUT:
+			fprintf(out, "Eval: time limit exceeded");
+			break;
+		case DEFERRED:
+			fprintf(out, "Eval: deferred, estimated too long for this worker");
+			break;
+		// memory
+		case OUT_OF_MEM:
+			fprintf(out, "Memory: allocation failed (out of memory)");
+			break;
+		case MEM_BUDGET:
+			fprintf(out, "Memory: the expression exceeds the memory budget");
+			break;
+		// command
+		case BAD_COMMAND:
+			fprintf(out, "Command: ");
+			if (e->usage != NULL) {
+				fprintf(out, "usage %s", e->usage);
+			} else {
+				fprintf(out, "wrong arguments");
+			}
+			break;
+		case WRITE_FAILED:
+			fprintf(out, "Command: can't write the file '%.*s'", e->length, e->word);
+			break;
+		case READ_FAILED:
+			fprintf(out, "Command: can't read the file '%.*s'", e->length, e->word);
+			break;
+		case BAD_FILE:
+			fprintf(out, "Command: the file '%.*s' isn't a saved number (or is corrupted)", e->length, e->word);
+			break;
+		case NO_PROGRAM:
+			fprintf(out, "Command: no expression prepared as '%.*s'", e->length, e->word);
 			break;
 	}
 }
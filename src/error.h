@@ -2,6 +2,8 @@
 #define ERROR_H
 
 #include <assert.h>
+#include <stdio.h>
+#include "config.h"
 #include "log.h"
 
 
@@ -10,6 +12,7 @@ enum error_type {
 	// lexer
 	UNKNOWN_SYM,
  	WRONG_BASE,
+	TOO_LONG,
 	// parser
 	UNKNOWN_TOK,
 	MIS_PARENT,
@@ -19,18 +22,50 @@ enum error_type {
 	UNMANAGED,
 	POW_BIG,
 	POW_NEG,
+	TOO_BIG,
+	CANCELLED,
+	TIMEOUT,
+	DEFERRED,
+	// memory
+	OUT_OF_MEM,
+	MEM_BUDGET,
+	// command
+	BAD_COMMAND,
+	WRITE_FAILED,
+	READ_FAILED,
+	BAD_FILE,
+	NO_PROGRAM,
 };
 
 
+struct error_state {
+	enum error_type type;
+	const char * character; // position of the error (cursor), or NULL
+	const char * word;      // word of the error (underlined), or NULL
+	int length;             // of the word
+	const char * usage;     // of the command of a `BAD_COMMAND`, or NULL
+};
+
+
+// error of the calling thread: its own state or the bound one (see `error_bind`)
 int error_get();
 
 void error_set(enum error_type err, const char * cursor, const char * word, int len);
 
 void error_reset();
 
-void error_underline(const char * input_expr);
+// `error_get`, `error_set` and `error_reset` use `state` in the calling thread (NULL for its own)
+void error_bind(struct error_state * state);
+
+void error_state_set(struct error_state * state, enum error_type err, const char * cursor, const char * word, int len);
+
+
+void error_underline(const struct error_state * e, const char * input_expr);
+
+void error_fprint(FILE * out, const struct error_state * e);
 
-void error_message();
+// position of the error in `input_expr`, -1 if none
+int error_column(const struct error_state * e, const char * input_expr);
 
 
 
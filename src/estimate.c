@@ -0,0 +1,356 @@
+#include "estimate.h"
+
+
+static void estimate_copy(const struct estimate * const src, struct estimate * const dst) {
+	*dst = *src;
+}
+
+static struct estimate known_estimate(long value, double cost) {
+	struct estimate e;
+	double abs = fabs((double) value);
+	e.bits  = (abs < 1 ? 1 : log2(abs) + 1);
+	e.cost  = cost;
+	e.value = value;
+	e.known = 1;
+	return e;
+}
+
+static struct estimate unknown_estimate(double bits, double cost) {
+	struct estimate e;
+	e.bits  = bits;
+	e.cost  = cost;
+	e.value = 0;
+	e.known = 0;
+	return e;
+}
+
+
+/*
+	ESTIMATE on each token
+*/
+
+// of the conversion of `len` digits to `bits`
+static double digits_cost(int len, int base, double bits) {
+	if ((base & (base - 1)) == 0) { // `str_to_big` puts the bits in place
+		return len;
+	}
+	return bits * len / 256; // a step of Horner on the bytes every 9 digits or so
+}
+
+// `len` digits (before any '.') times 10 ^ expo in base 10, 2 ^ expo otherwise
+static struct estimate scaled_estimate(const struct token * t, int len, int base, long expo) {
+	double digits = (base == 1 ? log2(len + 1) : len * log2(base));
+	if (expo == LONG_MAX) { // `eval` fails on this exponent
+		return unknown_estimate(HUGE_VAL, len);
+	}
+	if (base != 10) {
+		double bits = digits + expo;
+		if (bits < 62) {
+			struct number num = str_to_number(t->len, t->str);
+			if (num.type == INTEGER) {
+				return known_estimate(num.data.integer, len);
+			}
+			number_free(num);
+		}
+		return unknown_estimate(bits + 1, digits_cost(len, base, digits) + bits / 8); // a shift
+	}
+	double bits = digits + expo * log2(10);
+	if (bits < 62) {
+		struct number num = str_to_number(t->len, t->str);
+		if (num.type == INTEGER) {
+			return known_estimate(num.data.integer, len + expo);
+		}
+		number_free(num);
+	}
+	double five = expo * log2(5) / 8; // bytes of the power of 5
+	return unknown_estimate(bits + 1, digits_cost(len, base, digits) + (4 * five * five / 3) + bits / 8);
+}
+
+static struct estimate literal_estimate(const struct token * t) {
+
+	const char * str = t->str;
+	int len  = t->len;
+	int base = 10;
+
+	if ((len >= 2) && (str[1] == 'x')) { // same prefix as `str_to_number`
+		base = (str[0] == '0' ? 16 : str[0] - '0');
+		str += 2;
+		len -= 2;
+	}
+	long expo = number_exponent(str, &len, base);
+	const char * point = memchr(str, '.', len);
+	if (point != NULL) { // no float (yet)
+		len = point - str;
+	}
+	if (expo >= 0) {
+		return scaled_estimate(t, len, base, expo);
+	}
+	if (base == 1) {
+		return known_estimate(len, len);
+	}
+	if (len == 0) {
+		return known_estimate(0, 0);
+	}
+
+	double bits = len * log2(base);
+	if (bits < 62) { // fit in a long, that's cheap to know it
+		struct number num = str_to_number(t->len, t->str);
+		assert(num.type == INTEGER);
+		return known_estimate(num.data.integer, len);
+	}
+	return unknown_estimate(bits + 1, digits_cost(len, base, bits));
+}
+
+static struct estimate name_estimate(const struct number * num) {
+	if (num->type == INTEGER) {
+		return known_estimate(num->data.integer, 1);
+	}
+	unsigned char small[sizeof(long)];
+	const unsigned char * bytes;
+	int len;
+	number_bytes(num, small, &bytes, &len);
+	return unknown_estimate(8.0 * len, len); // copied (`CONSOLE_LAST`)
+}
+
+static struct estimate add_estimate(const struct estimate * a, const struct estimate * b, int sub) {
+	double cost = a->cost + b->cost;
+
+	long res;
+	if (a->known && b->known) {
+		int overflow = (sub ? __builtin_ssubl_overflow(a->value, b->value, &res) : __builtin_saddl_overflow(a->value, b->value, &res));
+		if (!overflow) {
+			return known_estimate(res, cost + 1);
+		}
+	}
+	double bits = (a->bits > b->bits ? a->bits : b->bits) + 1;
+	return unknown_estimate(bits, cost + bits / 8);
+}
+
+static struct estimate mul_estimate(const struct estimate * a, const struct estimate * b) {
+	double cost = a->cost + b->cost;
+
+	long res;
+	if (a->known && b->known && !__builtin_smull_overflow(a->value, b->value, &res)) {
+		return known_estimate(res, cost + 1);
+	}
+	return unknown_estimate(a->bits + b->bits, cost + (a->bits / 8) * (b->bits / 8)); // schoolbook
+}
+
+static struct estimate pow_estimate(const struct estimate * a, const struct estimate * e) {
+	double cost = a->cost + e->cost;
+
+	if (!e->known || (e->value < 0)) { // `eval` fails on this exponent
+		return unknown_estimate(a->bits, cost);
+	}
+	if (e->value == 0) {
+		return known_estimate(1, cost);
+	}
+
+	double bits;
+	if (a->known) {
+		if ((-1 <= a->value) && (a->value <= 1)) {
+			return known_estimate(((a->value == -1) && (e->value % 2 == 0) ? 1 : a->value), cost);
+		}
+		bits = e->value * log2(fabs((double) a->value)) + 1;
+		if (bits < 62) {
+			long res = 1;
+			for (long i = 0; i < e->value; i++) {
+				res *= a->value;
+			}
+			return known_estimate(res, cost + e->value);
+		}
+	}
+	else {
+		bits = e->value * a->bits;
+	}
+	double bytes = bits / 8;
+	return unknown_estimate(bits, cost + (4 * bytes * bytes / 3)); // the squares dominate
+}
+
+static struct estimate neg_estimate(const struct estimate * a) {
+	if (a->known && (a->value != LONG_MIN)) {
+		return known_estimate(-a->value, a->cost + 1);
+	}
+	return unknown_estimate(a->bits, a->cost + 1);
+}
+
+
+
+int estimate_rpn(const struct calc_ctx * ctx, const struct expr * e, const struct stack * rpn, struct estimate * est, size_t limit) {
+
+	int n = stack_size(rpn);
+	double max_bits = 8 * (double) limit;
+	struct stack * operands = stack_malloc(sizeof(struct estimate), n, (stack_copy_elem) estimate_copy);
+	if (operands == NULL) { // no memory, the error is set
+		return -1;
+	}
+	struct estimate a;
+	struct estimate b;
+
+	for (int i = n - 1; i >= 0; i--) { // the top of the stack is evaluated first
+
+		const struct token tok = token_get(e, *(int *) stack_get(rpn, i));
+		const struct token * t = &tok;
+		switch (t->type) {
+
+			case NUM_OPERAND:
+				est[i] = literal_estimate(t);
+				break;
+
+			case PLUS:
+			case MINUS:
+				stack_pop(operands, &b);
+				stack_pop(operands, &a);
+				est[i] = add_estimate(&a, &b, (t->type == MINUS));
+				break;
+			case ASTERISK:
+				stack_pop(operands, &b);
+				stack_pop(operands, &a);
+				est[i] = mul_estimate(&a, &b);
+				break;
+			case POW:
+				stack_pop(operands, &b);
+				stack_pop(operands, &a);
+				est[i] = pow_estimate(&a, &b);
+				break;
+
+			case UNARY_PLUS:
+				stack_pop(operands, &est[i]);
+				break;
+			case UNARY_MINUS:
+				stack_pop(operands, &a);
+				est[i] = neg_estimate(&a);
+				break;
+
+			case VAR_OPERAND:
+				if (ctx_name(ctx, t->str, t->len) != NULL) {
+					est[i] = name_estimate(ctx_name(ctx, t->str, t->len));
+					break;
+				}
+				// fall through, unknown from here
+			default: // function
+				for (int j = i; j >= 0; j--) {
+					est[j] = unknown_estimate(0, 0);
+				}
+				stack_free(operands);
+				return -1;
+		}
+		log_debug("estimate '%.*s' %.0f bits, cost %.0f", t->len, t->str, est[i].bits, est[i].cost);
+		stack_push(operands, &est[i]);
+
+		if ((limit != 0) && (est[i].bits > max_bits)) {
+			log_info("estimate '%.*s' %.0f bits > limit %zu bytes", t->len, t->str, est[i].bits, limit);
+			stack_free(operands);
+			return i;
+		}
+	}
+	stack_free(operands);
+	return -1;
+}
+
+long estimate_bytes(const struct estimate * est) {
+	double bytes = ceil(est->bits / 8);
+	return (bytes < (double) LONG_MAX ? (long) bytes : LONG_MAX);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+static const struct number * test_last = NULL; // value of `CONSOLE_LAST`
+
+// estimate of the whole expression in `res`, return as `estimate_rpn`
+static int estimate_str(const char * str, struct estimate * res, size_t limit) {
+
+	struct calc_ctx * ctx = ctx_new();
+	ctx->last = test_last;
+	struct expr lex  = lexer(ctx, str);
+	struct expr pars = lexer_to_parser(ctx, &lex);
+	token_free_expr(&lex);
+	assert(!parser_check_syntax(ctx, pars));
+
+	struct stack * rpn = shunting_yard(ctx, &pars);
+	struct estimate est[stack_size(rpn)];
+	int too_big = estimate_rpn(ctx, &pars, rpn, est, limit);
+	*res = est[0];
+
+	stack_free(rpn);
+	token_free_expr(&pars);
+	ctx_free(ctx);
+	return too_big;
+}
+
+void test_estimate() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("ESTIMATE:\n");
+	struct estimate e;
+
+
+	printf(" known values\n");
+	assert(estimate_str("3 * 4 + -1", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(e.known);
+	assert(e.value == 11);
+
+	assert(estimate_str("2 ^ 3 ^ 2", &e, ESTIMATE_MAX_SIZE) == -1); // (2 ^ 3) ^ 2, as `shunting_yard` does
+	assert(e.known);
+	assert(e.value == 64);
+
+	assert(estimate_str("0x10 - 2x101", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(e.known);
+	assert(e.value == 11);
+
+
+	printf(" bit length\n");
+	assert(estimate_str("10 ^ 100", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(!e.known);
+	assert((333 < e.bits) && (e.bits < 336));
+
+	assert(estimate_str("123456789012345678901234567890 * 0xFFFFFFFFFFFFFFFFFFFF", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(!e.known);
+	assert((99 + 80 < e.bits) && (e.bits < 99 + 80 + 4));
+
+	assert(estimate_str("1e100 + 2.5e3", &e, ESTIMATE_MAX_SIZE) == -1); // exponents
+	assert(!e.known);
+	assert((333 < e.bits) && (e.bits < 340));
+	assert(estimate_str("2.5e3 + 0x1p8", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(e.known && (e.value == 2756));
+	assert(estimate_str("0e5 + 00e3 + 0x0p5", &e, ESTIMATE_MAX_SIZE) == -1); // zero at any scale
+	assert(e.known && (e.value == 0));
+	assert(estimate_str("2x11p64", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(!e.known && (66 <= e.bits) && (e.bits < 68));
+
+
+	printf(" limit\n");
+	assert(estimate_str("1 + 2 ^ (2 ^ 40)", &e, ESTIMATE_MAX_SIZE) == 1); // index of the outer `^`
+	assert(estimate_str("2 ^ 100", &e, 10) == 0);
+	assert(estimate_str("2 ^ 70", &e, 10) == -1);
+	assert(estimate_str("2 ^ (2 ^ 40)", &e, 0) == -1); // no limit
+	assert(estimate_str("1 + 1e100000000000", &e, ESTIMATE_MAX_SIZE) == 1);
+	assert(estimate_str("1e99999999999999999999", &e, ESTIMATE_MAX_SIZE) == 0); // over a long
+
+
+	printf(" names\n");
+	assert(estimate_str(CONSOLE_LAST " + 1", &e, ESTIMATE_MAX_SIZE) == -1); // unknown
+	assert(!e.known && (e.bits == 0));
+	struct number last = str_to_number(30, "123456789012345678901234567890"); // 97 bits, 13 bytes
+	test_last = &last;
+	assert(estimate_str(CONSOLE_LAST " ^ 3", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(!e.known && (e.bits == 3 * 8 * 13));
+	assert(estimate_str(CONSOLE_LAST " ^ 3", &e, 20) == 0);
+	number_free(last);
+	last = str_to_number(2, "42");
+	assert(estimate_str("-" CONSOLE_LAST " * 2", &e, ESTIMATE_MAX_SIZE) == -1);
+	assert(e.known && (e.value == -84));
+	test_last = NULL;
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,46 @@
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "context.h"
+#include "lexer.h"  // for test
+#include "log.h"
+#include "number.h"
+#include "parser.h" // for test
+#include "shunting_yard.h"
+#include "stack.h"
+#include "token.h"
+
+
+/*
+	`estimate_rpn` bounds the size of every intermediate result of a RPN stack
+	(from `shunting_yard`) before any evaluation, from the length of the literals
+	and the value of the exponents.
+*/
+
+
+struct estimate {
+	double bits; // bit length (upper bound) of the intermediate result
+	double cost; // approximate number of byte operations to compute it
+	long value;  // exact value, if `known`
+	int known;
+};
+
+// `est` has one estimate per token of `rpn` (same index, the tokens of `e`), the names known by `ctx` by their value
+// return the index of the first token whose result is over `limit` bytes (0 is no limit), -1 otherwise
+// (or if no memory, then the error is set)
+int estimate_rpn(const struct calc_ctx * ctx, const struct expr * e, const struct stack * rpn, struct estimate * est, size_t limit);
+
+// size of the result in bytes
+long estimate_bytes(const struct estimate * est);
+
+
+void test_estimate();
+
+
+#endif // ESTIMATE_H
@@ -3,66 +3,80 @@
 
 typedef void (bin_op)(struct number * n1, struct number * n2);
 
-static struct number binary_op(struct stack * operands, bin_op operation) {
+// the result is stored in n1, pre-sized for `bytes`
+static struct number binary_op(struct calc_ctx * ctx, struct stack * operands, bin_op operation, long bytes) {
 
 	struct number n2;
 	stack_pop(operands, &n2);
 	struct number n1;
 	stack_pop(operands, &n1);
-	operation(&n1, &n2);
+	number_reserve(&n1, bytes);
+	if (!ctx_error(ctx)) {
+		operation(&n1, &n2);
+	}
 	number_free(n2);
 	return n1;
 }
 
 
-static void eval_token(const struct token exp_token, struct stack * operands) {
+// pop 2 operands, push the result and put the cursor on the operator on error
+static void binary_token(struct calc_ctx * ctx, const struct token exp_token, struct stack * operands, bin_op operation, const struct estimate * est) {
+	struct number res = binary_op(ctx, operands, operation, estimate_bytes(est));
+	stack_push(operands, &res);
+	if (ctx_error(ctx)) {
+		ctx_error_set(ctx, ctx_error(ctx), exp_token.str, NULL, 0); // cursor on the operator
+	}
+}
+
+// `*lit` is the next literal converted by `compile_literals`
+static void eval_token(struct calc_ctx * ctx, const struct token exp_token, struct stack * operands, const struct estimate * est, struct number ** lit) {
 
 	switch (exp_token.type) {
 
-		case NUM_OPERAND: {
-			struct number num = str_to_number(exp_token.len, exp_token.str);
-			stack_push(operands, &num);
+		case NUM_OPERAND:
+			stack_push(operands, *lit);
+			(*lit)++;
 			return;
-		}
 
-		case VAR_OPERAND:
+		case VAR_OPERAND: {
+			struct number num;
+			if (ctx_take_name(ctx, exp_token.str, exp_token.len, &num)) {
+				stack_push(operands, &num);
+				if (ctx_error(ctx)) {
+					ctx_error_set(ctx, ctx_error(ctx), NULL, exp_token.str, exp_token.len);
+				}
+				return;
+			}
 			// log_error("Unknown variable '%.*s' (no variable yet)", exp_token.len, exp_token.str);
-			error_set(UNMANAGED, NULL, exp_token.str, exp_token.len);
+			ctx_error_set(ctx, UNMANAGED, NULL, exp_token.str, exp_token.len);
 			return;
+		}
 		case FUNC_NAME:
 			// log_error("Unknown function '%.*s' (no function yet) ", exp_token.len, exp_token.str);
-			error_set(UNMANAGED, NULL, exp_token.str, exp_token.len);
+			ctx_error_set(ctx, UNMANAGED, NULL, exp_token.str, exp_token.len);
 			return;
 
-		case PLUS: {
-			struct number res = binary_op(operands, number_add);
-			stack_push(operands, &res);
+		case PLUS:
+			binary_token(ctx, exp_token, operands, number_add, est);
 			return;
-		}
-		case MINUS: {
-			struct number res = binary_op(operands, number_sub);
-			stack_push(operands, &res);
+		case MINUS:
+			binary_token(ctx, exp_token, operands, number_sub, est);
 			return;
-		}
-		case ASTERISK: {
-			struct number res = binary_op(operands, number_mul);
-			stack_push(operands, &res);
+		case ASTERISK:
+			binary_token(ctx, exp_token, operands, number_mul, est);
 			return;
-		}
-		case POW: {
-			struct number res = binary_op(operands, number_pow);
-			stack_push(operands, &res);
-			if (error_get()) {
-				error_set(error_get(), exp_token.str, NULL, 0); // cursor on the operator
-			}
+		case POW:
+			binary_token(ctx, exp_token, operands, number_pow, est);
 			return;
-		}
 
 		case UNARY_PLUS: // nothing to todo
 			return;
 		case UNARY_MINUS: {
 			struct number * num = stack_peek(operands);
 			number_neg(num);
+			if (ctx_error(ctx)) {
+				ctx_error_set(ctx, ctx_error(ctx), exp_token.str, NULL, 0);
+			}
 			return;
 		}
 
@@ -71,21 +85,113 @@ static void eval_token(const struct token exp_token, struct stack * operands) {
 	}
 }
 
+// free the operands left on the stack (after an error)
+static void free_operands(struct stack * operands) {
+	while (!stack_empty(operands)) {
+		struct number num;
+		stack_pop(operands, &num);
+		number_free(num);
+	}
+	stack_free(operands);
+}
 
-struct number eval(const struct expr e) {
+// free the literals from `lit` to `end` (excluded)
+static void free_literals(struct number * lit, const struct number * end) {
+	for (; lit < end; lit++) {
+		number_free(*lit);
+	}
+}
+
+
+// convert the literals of `rpn` in `ctx->lit`, in the order of the evaluation (the top first)
+// return the number of literals, -1 on error (set on the literal)
+static int compile_literals(struct calc_ctx * ctx, const struct expr * e, const struct stack * rpn, const struct estimate * est) {
+
+	int size = stack_size(rpn);
+	int count = 0;
+	for (int i = 0; i < size; i++) {
+		count += (token_type(e, *(int *) stack_get(rpn, i)) == NUM_OPERAND);
+	}
+	if (ctx->lit_cap < count) {
+		struct number * lit = alloc_realloc(ctx->lit, sizeof(struct number) * count);
+		if (lit == NULL) {
+			return -1;
+		}
+		ctx->lit = lit;
+		ctx->lit_cap = count;
+	}
 
-	struct stack * stack_exp = shunting_yard(e.len, e.list);
-	// print_rpn_stack(stack_exp);
+	struct number * lit = ctx->lit;
+	for (int i = size - 1; i >= 0; i--) {
+		int index = *(int *) stack_get(rpn, i);
+		if (token_type(e, index) != NUM_OPERAND) {
+			continue;
+		}
+		*lit = eval_literal(ctx, e, index, &est[i]);
+		if (ctx_error(ctx)) {
+			free_literals(ctx->lit, lit);
+			return -1;
+		}
+		lit++;
+	}
+	return count;
+}
+
+static struct number eval_rpn(struct calc_ctx * ctx, const struct expr e) {
+
+	struct stack * stack_exp = shunting_yard(ctx, &e);
+	if (stack_exp == NULL) {
+		return str_to_number(1, "0");
+	}
+	// print_rpn_stack(&e, stack_exp);
 	int size = stack_size(stack_exp);
+
+	// refuse too big results before any computation (estimates kept in the context)
+	if (ctx->est_cap < size) {
+		struct estimate * est = alloc_realloc(ctx->est, sizeof(struct estimate) * size);
+		if (est == NULL) {
+			stack_free(stack_exp);
+			return str_to_number(1, "0");
+		}
+		ctx->est = est;
+		ctx->est_cap = size;
+	}
+	struct estimate * est = ctx->est;
+	int too_big = estimate_rpn(ctx, &e, stack_exp, est, ctx->config.max_size);
+	if (too_big >= 0) {
+		ctx_error_set(ctx, TOO_BIG, token_get(&e, *(int *) stack_get(stack_exp, too_big)).str, NULL, 0);
+	}
+	else if ((ctx->max_cost > 0) && (est[0].cost > ctx->max_cost)) { // for another worker (see `scheduler.h`)
+		ctx_error_set(ctx, DEFERRED, NULL, NULL, 0);
+	}
+	if (ctx_error(ctx)) {
+		stack_free(stack_exp);
+		return str_to_number(1, "0");
+	}
+	log_info("eval estimate %.0f bits, cost %.0f", est[0].bits, est[0].cost);
+
+	int literals = compile_literals(ctx, &e, stack_exp, est);
+	if (literals < 0) {
+		stack_free(stack_exp);
+		return str_to_number(1, "0");
+	}
+	struct number * lit = ctx->lit;
+
 	struct stack * operands = stack_malloc(sizeof(struct number), size, (stack_copy_elem) number_copy);
+	if (operands == NULL) {
+		free_literals(lit, ctx->lit + literals);
+		stack_free(stack_exp);
+		return str_to_number(1, "0");
+	}
 
 	while (!stack_empty(stack_exp)) {
-		struct token exp_token;
-		stack_pop(stack_exp, &exp_token);
-		eval_token(exp_token, operands);
-		if (error_get()) {
+		int index;
+		stack_pop(stack_exp, &index);
+		eval_token(ctx, token_get(&e, index), operands, &est[stack_size(stack_exp)], &lit);
+		if (ctx_error(ctx)) {
+			free_literals(lit, ctx->lit + literals); // not pushed yet
 			stack_free(stack_exp);
-			stack_free(operands);
+			free_operands(operands);
 			return str_to_number(1, "0"); // why not
 		}
 	}
@@ -99,3 +205,68 @@ struct number eval(const struct expr e) {
 	return result;
 }
 
+struct number eval_literal(struct calc_ctx * ctx, const struct expr * e, int index, const struct estimate * est) {
+	if (est->known) {
+		struct number num;
+		num.type = INTEGER;
+		num.data.integer = est->value;
+		return num;
+	}
+	const struct token t = token_get(e, index);
+	struct number num = str_to_number(t.len, t.str);
+	if (ctx_error(ctx)) {
+		ctx_error_set(ctx, ctx_error(ctx), NULL, t.str, t.len);
+	}
+	return num;
+}
+
+struct number eval(struct calc_ctx * ctx, const struct expr e) {
+
+	ctx->alloc.budget = ctx->config.eval_budget;
+	ctx->alloc.used   = 0;
+	ctx_bind(ctx); // for the number layer
+	cancel_begin(ctx->config.timeout);
+	progress_begin();
+
+	struct number result = eval_rpn(ctx, e);
+
+	progress_end();
+	cancel_end();
+	ctx_bind(NULL);
+	return result;
+}
+
+int eval_parse(struct calc_ctx * ctx, const char * str, struct expr * e) {
+
+	// lexer
+	struct expr e1 = lexer(ctx, str);
+	if (ctx_error(ctx) || (e1.len == 0)) {
+		token_free_expr(&e1);
+		return (ctx_error(ctx) ? -1 : 0);
+	}
+
+	// parser
+	*e = lexer_to_parser(ctx, &e1);
+	token_free_expr(&e1);
+	if (ctx_error(ctx) || parser_check_syntax(ctx, *e)) {
+		token_free_expr(e);
+		return -1;
+	}
+	return 1;
+}
+
+int eval_str(struct calc_ctx * ctx, const char * str, struct number * result) {
+
+	struct expr e;
+	int res = eval_parse(ctx, str, &e);
+	if (res <= 0) {
+		return res;
+	}
+	*result = eval(ctx, e);
+	token_free_expr(&e);
+	if (ctx_error(ctx)) {
+		number_free(*result);
+		return -1;
+	}
+	return 1;
+}
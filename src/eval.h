@@ -3,14 +3,34 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include "alloc.h"
+#include "cancel.h"
+#include "context.h"
 #include "error.h"
+#include "estimate.h"
+#include "lexer.h"
 #include "log.h"
 #include "number.h"
+#include "parser.h"
+#include "progress.h"
 #include "shunting_yard.h"
 #include "stack.h"
 
 
-struct number eval(const struct expr e);
+struct number eval(struct calc_ctx * ctx, const struct expr e);
+
+// value of the literal token `index` of `e`, whose estimate is `est`: a literal known by its
+// estimate isn't parsed again
+// return 0 on error (set on the literal)
+struct number eval_literal(struct calc_ctx * ctx, const struct expr * e, int index, const struct estimate * est);
+
+// lex and parse `str` in `e` (for `eval`, then `token_free_expr`), the tokens point in `str`
+// return 1 on success, 0 if there is no expression, -1 on error (`e` is not set)
+int eval_parse(struct calc_ctx * ctx, const char * str, struct expr * e);
+
+// lex, parse and evaluate `str` in `result`
+// return 1 on success, 0 if there is no expression, -1 on error (`result` is not set)
+int eval_str(struct calc_ctx * ctx, const char * str, struct number * result);
 
 
 #endif // EVAL_H
\ No newline at end of file
@@ -2,9 +2,10 @@
 
 
 
+// an expression ends at the end of its line
 static const char * eat_whitespace(const char * string) {
 	int i = 0;
-	while (isspace(string[i])) {
+	while (isspace(string[i]) && (string[i] != '\n')) {
 		i++;
 	}
 	return &string[i];
@@ -24,6 +25,7 @@ static int try_special(const char * str, struct token * t) {
 			t->type = ARG_SEP;
 			break;
 		case '\0':
+		case '\n': // the input may be a whole file (see `batch`)
 			t->type = END;
 			break;
 		default:
@@ -71,30 +73,45 @@ static int try_name(const char * str, struct token * t) {
 	About NUMBER
 */
 
-// return 1 if `c` is a valid digit, 0 otherwise
-typedef int (* check_digit)(int c);
+// return 1 if `c` is a valid digit in `base`, 0 otherwise
+typedef int (* check_digit)(int c, int base);
 
-static int eat_number(const char * str, check_digit digit, struct token * t) {
-	if (!digit(str[0])) {
+// integer exponent (decimal digits): `e` of 10 in base 10, `p` of 2 in a prefixed base (without '.')
+// return its length, 0 if none
+static int eat_exponent(const char * str, int base, int point) {
+	char marker = (base == 10 ? 'e' : 'p');
+	if ((tolower(str[0]) != marker) || !isdigit(str[1]) || (point && (base != 10))) {
+		return 0;
+	}
+	int i = 2;
+	while (isdigit(str[i])) {
+		i++;
+	}
+	return i;
+}
+
+static int eat_number(const char * str, check_digit digit, int base, struct token * t) {
+	if (!digit(str[0], base)) {
 		return 0;
 	}
 
 	int i = 1;
-	while (digit(str[i])) { // integer part
+	while (digit(str[i], base)) { // integer part
 		i++;
 	}
 
 	if (str[i] != '.') { // not a float
 		t->type = NUMBER;
 		t->str  = str;
-		t->len  = i;
+		t->len  = i + eat_exponent(&str[i], base, 0);
 		return 1;
 	}
 	i++; // skip the '.' index
 	
-	while (digit(str[i])) { // decimal part
+	while (digit(str[i], base)) { // decimal part
 		i++;
 	}
+	i += eat_exponent(&str[i], base, 1);
 
 	t->type = NUMBER;
 	t->str = str;
@@ -102,9 +119,15 @@ static int eat_number(const char * str, check_digit digit, struct token * t) {
 	return 1;
 }
 
-static int base = 0;
+static int isdigit_dec(int c, int base) {
+	return isdigit(c);
+}
+
+static int isdigit_hex(int c, int base) {
+	return isxdigit(c);
+}
 
-static int isdigit_base(int c) {
+static int isdigit_base(int c, int base) {
 	if (isdigit(c)) {
 		if ((c - '0') < base) {
 			return 1;	
@@ -114,22 +137,22 @@ static int isdigit_base(int c) {
 	return 0;
 }
 
-static int try_number(const char * str, struct token * t) {
+static int try_number(struct calc_ctx * ctx, const char * str, struct token * t) {
 
 	if (!isdigit(str[0])) {
 		return 0;
 	}
 	if (str[1] != 'x') { // no prefix, then assume it's a decimal number
-		return eat_number(str, isdigit, t);
+		return eat_number(str, isdigit_dec, 10, t);
 	}
 	
 	// retrieve the base of the prefix
-	base = str[0] - '0';
+	int base = str[0] - '0';
 	assert((0 <= base) && (base < 10));
 	const char * num_core = str + 2;
 
 	if (base == 0) { // hexadicimal
-		if (eat_number(num_core, isxdigit, t)) {
+		if (eat_number(num_core, isdigit_hex, 16, t)) {
 			t->str = str;
 			t->len = t->len + 2;
 			log_debug("Find hex num '%.*s'", t->len, t->str);
@@ -138,10 +161,10 @@ static int try_number(const char * str, struct token * t) {
 		return 0;
 	}
 
-	eat_number(num_core, isdigit_base, t);
+	eat_number(num_core, isdigit_base, base, t);
 	// check next char to see if it stops because of base
 	if (isxdigit(num_core[t->len])) {
-		error_set(WRONG_BASE, &str[2 + t->len], str, 2);
+		ctx_error_set(ctx, WRONG_BASE, &str[2 + t->len], str, 2);
 		return 0;
 	}
 	t->str = str;
@@ -152,7 +175,7 @@ static int try_number(const char * str, struct token * t) {
 
 
 // get token from string
-static void next_token(const char * string, struct token * t) {
+static void next_token(struct calc_ctx * ctx, const char * string, struct token * t) {
 
 	const char *str = eat_whitespace(string);
 	assert(str == eat_whitespace(str));
@@ -166,50 +189,64 @@ static void next_token(const char * string, struct token * t) {
 	if (try_name(str, t)) {
 		return;
 	}
-	if (try_number(str, t)) {
+	if (try_number(ctx, str, t)) {
 		return;
 	}
 	// Assume the token is unknown
 	t->type = END;
-	if (!error_get()) {
-		error_set(UNKNOWN_SYM, str, NULL, 0);
+	if (!ctx_error(ctx)) {
+		ctx_error_set(ctx, UNKNOWN_SYM, str, NULL, 0);
 	}
 }
 
 
-static int count_token(const char * string) {
+static int count_token(struct calc_ctx * ctx, const char * string) {
 
 	struct token token;
-	next_token(string, &token);
+	next_token(ctx, string, &token);
 	int count = 1; // number of token, at least one END
 
 	while (token.type != END) {
 		string = &(token.str[token.len]);
-		next_token(string, &token);
+		next_token(ctx, string, &token);
 		count++;
 	}
 	assert(count > 0);
 	return count - 1; // without END
 }
 
-struct expr lexer(const char * string) {
-	error_reset();
+struct expr lexer(struct calc_ctx * ctx, const char * string) {
+	ctx_error_reset(ctx);
 
-	int count = count_token(string);
-	if (error_get()) {
-		return token_expr(0);
+	int count = count_token(ctx, string);
+	if (ctx_error(ctx)) {
+		return token_expr(string, 0);
 	}
 	log_debug("Lexer %d token found", count);
-	struct expr e = token_expr(count);
+	struct expr e = token_expr(string, count);
+	if (e.len < count) {
+		ctx_error_set(ctx, OUT_OF_MEM, NULL, NULL, 0);
+		return e;
+	}
 
 	struct token tmp;
+	const char * str = string;
 	for (int i = 0; i < e.len; i++) {
-		next_token(string, &tmp);
-		string = &(tmp.str[tmp.len]);
-		e.list[i] = tmp;
+		next_token(ctx, str, &tmp);
+		str = &(tmp.str[tmp.len]);
+		if (tmp.str - string > TOKEN_OFFSET_MAX) { // the offsets are 32 bits
+			ctx_error_set(ctx, TOO_LONG, tmp.str, NULL, 0);
+			e.len = i;
+			return e;
+		}
+		if (token_set(&e, i, &tmp) < 0) {
+			ctx_error_set(ctx, OUT_OF_MEM, NULL, NULL, 0);
+			e.len = i;
+			return e;
+		}
 	}
 
-	log_debug("expr, token[] in %p", e.list);
+	log_debug("expr, token[] in %p", e.offset);
 	return e;
 }
 
@@ -227,6 +264,7 @@ void test_lexer() {
 	exit(1);
 	#else
 	printf("LEXER: \n");
+	struct calc_ctx * ctx = ctx_new();
 
 
 	printf(" eat_whitespace\n");
@@ -261,115 +299,140 @@ void test_lexer() {
 	printf(" try_number\n");
 	struct token t2;
 
-	assert(try_number("123", &t2));
+	assert(try_number(ctx, "123", &t2));
 	assert(t2.type == NUMBER);
 	assert(t2.len  == 3);
 
-	assert(try_number("123aa", &t2));
+	assert(try_number(ctx, "123aa", &t2));
 	assert(t2.type == NUMBER);
 	assert(t2.len  == 3);
 
-	assert(try_number("123.", &t2));
+	assert(try_number(ctx, "123.", &t2));
 	assert(t2.type == NUMBER);
 	assert(t2.len  == 4);
 
-	assert(try_number("123.45", &t2));
+	assert(try_number(ctx, "123.45", &t2));
 	assert(t2.type == NUMBER);
 	assert(t2.len  == 6);
 
-	assert(!try_number(".123", &t2));
+	assert(!try_number(ctx, ".123", &t2));
 
-	assert(try_number("0x1234A", &t2));
+	assert(try_number(ctx, "0x1234A", &t2));
 	assert(t2.type == NUMBER);
 	assert(t2.len  == 7);
 
-	assert(try_number("2x010101", &t2));
+	assert(try_number(ctx, "2x010101", &t2));
 	assert(t2.type == NUMBER);
 	assert(t2.len  == 8);
 
-	assert(!try_number("2x020101", &t2));
-	assert(error_get() == WRONG_BASE);
-	error_reset();
+	assert(!try_number(ctx, "2x020101", &t2));
+	assert(ctx_error(ctx) == WRONG_BASE);
+	ctx_error_reset(ctx);
 
-	assert(try_number("3x0201.01", &t2));
-	assert(error_get() == NO_ERROR);
+	assert(try_number(ctx, "3x0201.01", &t2));
+	assert(ctx_error(ctx) == NO_ERROR);
 	assert(t2.type == NUMBER);
 	assert(t2.len  == 9);
 
 
+	printf(" exponents\n");
+	assert(try_number(ctx, "1e1000", &t2));
+	assert(t2.len == 6);
+	assert(try_number(ctx, "2.5E30 ", &t2));
+	assert(t2.len == 6);
+	assert(try_number(ctx, "3e", &t2));
+	assert(t2.len == 1); // then a name
+	assert(try_number(ctx, "3p5", &t2));
+	assert(t2.len == 1);
+	assert(try_number(ctx, "0x1e5p64", &t2));
+	assert(t2.len == 8);
+	assert(try_number(ctx, "2x101p4096", &t2));
+	assert(t2.len == 10);
+	assert(try_number(ctx, "2x1.1p4", &t2));
+	assert(t2.len == 5); // no exponent after a '.' in a prefixed base
+	assert(try_number(ctx, "0e5", &t2));
+	assert(t2.len == 3);
+	assert(try_number(ctx, "00e3", &t2));
+	assert(t2.len == 4);
+	assert(try_number(ctx, "0x0p5", &t2));
+	assert(t2.len == 5);
+	assert(ctx_error(ctx) == NO_ERROR);
+
+
 	printf(" next_token\n");
 	struct token t3;
 
-	next_token(" 123", &t3);
+	next_token(ctx, " 123", &t3);
 	assert(t3.type == NUMBER);
 	assert(t3.len  == 3);
 
-	next_token("  123.0", &t3);
+	next_token(ctx, "  123.0", &t3);
 	assert(t3.type == NUMBER);
 	assert(t3.len  == 5);
 
-	next_token(" _Aa1", &t3);
+	next_token(ctx, " _Aa1", &t3);
 	assert(t3.type == NAME);
 	assert(t3.len  == 4);
 
-	next_token(" +", &t3);
+	next_token(ctx, " +", &t3);
 	assert(t3.type == SYMBOL);
 	assert(t3.len  == 1);
 
-	next_token(" *", &t3);
+	next_token(ctx, " *", &t3);
 	assert(t3.type == SYMBOL);
 	assert(t3.len  == 1);
 
-	next_token("-", &t3);
+	next_token(ctx, "-", &t3);
 	assert(t3.type == SYMBOL);
 	assert(t3.len  == 1);
 
-	next_token("   (", &t3);
+	next_token(ctx, "   (", &t3);
 	assert(t3.type == LPARENT);
 	assert(t3.len  == 1);
 
-	next_token(")", &t3);
+	next_token(ctx, ")", &t3);
 	assert(t3.type == RPARENT);
 	assert(t3.len  == 1);
 
-	next_token("   ,", &t3);
+	next_token(ctx, "   ,", &t3);
 	assert(t3.type == ARG_SEP);
 	assert(t3.len  == 1);
 
-	next_token("  ", &t3);
+	next_token(ctx, "  ", &t3);
 	assert(t3.type == END);
 	assert(t3.len  == 1);
 
 
 	printf(" count_token\n");
-	assert(count_token("1 2 3") == 3);
-	assert(error_get() == NO_ERROR);
-	assert(count_token("1 § 3") == 1); // stops at § UNKNONW
-	assert(error_get() == UNKNOWN_SYM);
+	assert(count_token(ctx, "1 2 3") == 3);
+	assert(ctx_error(ctx) == NO_ERROR);
+	assert(count_token(ctx, "1 § 3") == 1); // stops at § UNKNONW
+	assert(ctx_error(ctx) == UNKNOWN_SYM);
 
 
 	printf(" lexer\n");
-	struct expr res = lexer("12 +  ( 3.0 * 4 +   18.18)  + (3*4 )");
+	struct expr res = lexer(ctx, "12 +  ( 3.0 * 4 +   18.18)  + (3*4 )");
 
-	assert(error_get() == NO_ERROR);
+	assert(ctx_error(ctx) == NO_ERROR);
 	assert(res.len == 15);
-	assert(res.list[0].type  == NUMBER);
-	assert(res.list[1].type  == SYMBOL);
-	assert(res.list[2].type  == LPARENT);
-	assert(res.list[3].type  == NUMBER);
-	assert(res.list[4].type  == SYMBOL);
-	assert(res.list[5].type  == NUMBER);
-	assert(res.list[6].type  == SYMBOL);
-	assert(res.list[7].type  == NUMBER);
-	assert(res.list[8].type  == RPARENT);
-	assert(res.list[9].type  == SYMBOL);
-	assert(res.list[10].type == LPARENT);
-	assert(res.list[11].type == NUMBER);
-	assert(res.list[12].type == SYMBOL);
-	assert(res.list[13].type == NUMBER);
-	assert(res.list[14].type == RPARENT);
+	assert(token_type(&res, 0) == NUMBER);
+	assert(token_type(&res, 1) == SYMBOL);
+	assert(token_type(&res, 2) == LPARENT);
+	assert(token_type(&res, 3) == NUMBER);
+	assert(token_type(&res, 4) == SYMBOL);
+	assert(token_type(&res, 5) == NUMBER);
+	assert(token_type(&res, 6) == SYMBOL);
+	assert(token_type(&res, 7) == NUMBER);
+	assert(token_type(&res, 8) == RPARENT);
+	assert(token_type(&res, 9) == SYMBOL);
+	assert(token_type(&res, 10)== LPARENT);
+	assert(token_type(&res, 11)== NUMBER);
+	assert(token_type(&res, 12)== SYMBOL);
+	assert(token_type(&res, 13)== NUMBER);
+	assert(token_type(&res, 14)== RPARENT);
 
 	token_free_expr(&res);
+	ctx_free(ctx);
 
 
 	printf("done\n\n");
@@ -6,12 +6,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "config.h"
+#include "context.h"
 #include "error.h"
 #include "log.h"
 #include "token.h"
 
 
-struct expr lexer(const char * string);
+// tokens of `string` up to '\0' or '\n', they point in `string`
+struct expr lexer(struct calc_ctx * ctx, const char * string);
 
 void test_lexer();
 
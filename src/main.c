@@ -1,8 +1,61 @@
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "alloc.h"
+#include "batch.h"
+#include "cancel.h"
+#include "checkpoint.h"
 #include "console.h"
 #include "config.h"
+#include "context.h"
+#include "estimate.h"
 #include "log.h"
+#include "progress.h"
+#include "ring.h"
+#include "server.h"
+#include "session.h"
+
+
+static void usage(const char * exec) {
+	printf("usage: %s [-s scratch_dir] [-S spill_size] [-m eval_budget] [-M process_budget] [-L max_size] [-t seconds] [-p] [-c checkpoint] [-C seconds] [--resume checkpoint] [-R snapshot] [-j threads] [-l socket] [-P port] [-r ring] [-b [file...]]\n", exec);
+	printf("  -s dir   spill huge numbers in (unlinked) files of 'dir'\n");
+	printf("  -S size  spill numbers from 'size' bytes (suffix K, M or G)\n");
+	printf("  -m size  memory budget of one evaluation\n");
+	printf("  -M size  memory budget of the whole process\n");
+	printf("  -L size  refuse results estimated bigger than 'size' (0 is no limit)\n");
+	printf("  -t sec   time limit of one evaluation in seconds\n");
+	printf("  -p       report the progress of long evaluations on stderr\n");
+	printf("  -c file  (--checkpoint) save the state of a long power in 'file'\n");
+	printf("  -C sec   seconds between two checkpoints (default %d)\n", CHECKPOINT_INTERVAL);
+	printf("  --resume file  continue the power saved in the checkpoint 'file' (then checkpointed\n");
+	printf("           in it), run the same expressions again\n");
+	printf("  -R file  (--restore) restore the session of '" COMMAND_SNAPSHOT "', the options after it\n");
+	printf("           override its settings\n");
+	printf("  -b       evaluate every line of the files (or stdin) without the console,\n");
+	printf("           the default when stdin is not a terminal\n");
+	printf("  -j n     worker threads of the batch or the server (default one per core)\n");
+	printf("  -l path  serve the evaluations on the Unix socket 'path'\n");
+	printf("  -P port  serve the evaluations on localhost:'port'\n");
+	printf("  -r name  serve the evaluations on the shared memory ring 'name' (as shm_open)\n");
+}
+
+// size in bytes with an optional suffix K, M or G, return 0 if wrong
+static size_t parse_size(const char * str) {
+	char * end;
+	unsigned long long size = strtoull(str, &end, 10);
+
+	switch (*end) {
+		case 'G': size <<= 10; // fall through
+		case 'M': size <<= 10; // fall through
+		case 'K': size <<= 10;
+			end++;
+			break;
+	}
+	return (*end == '\0' ? (size_t) size : 0);
+}
 
 
 int main(int argc, char *argv[]) {
@@ -10,13 +63,135 @@ int main(int argc, char *argv[]) {
 	#ifdef NDEBUG // release
 	log_set_quiet(1);
 	#endif
-	
+
 	#ifdef LOG_LEVEL
 	log_set_quiet(0);
 	log_set_level(LOG_LEVEL);
 	#endif
 
-	console();
-	
+	static struct session session; // settings and last result
+	session_init(&session);
+	FILE * progress = NULL;
+	const char * checkpoint = NULL;
+	const char * resume = NULL;
+	double checkpoint_interval = CHECKPOINT_INTERVAL;
+	int batch_mode  = !isatty(STDIN_FILENO);
+	int threads = BATCH_THREADS;
+	const char * sock_path = NULL;
+	int port = 0;
+	const char * ring_name = NULL;
+	int nfiles = 0;
+	char ** files = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc)) {
+			snprintf(session.scratch, sizeof(session.scratch), "%s", argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-S") == 0) && (i + 1 < argc) && (parse_size(argv[i + 1]) > 0)) {
+			session.spill = parse_size(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-m") == 0) && (i + 1 < argc) && (parse_size(argv[i + 1]) > 0)) {
+			session.config.eval_budget = parse_size(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-M") == 0) && (i + 1 < argc) && (parse_size(argv[i + 1]) > 0)) {
+			session.process_budget = parse_size(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-L") == 0) && (i + 1 < argc)) {
+			session.config.max_size = parse_size(argv[++i]); // 0 is no limit
+		}
+		else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc) && (atof(argv[i + 1]) > 0)) {
+			session.config.timeout = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-p") == 0) {
+			progress = stderr;
+		}
+		else if (((strcmp(argv[i], "-c") == 0) || (strcmp(argv[i], "--checkpoint") == 0)) && (i + 1 < argc)) {
+			checkpoint = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-C") == 0) && (i + 1 < argc) && (atof(argv[i + 1]) > 0)) {
+			checkpoint_interval = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--resume") == 0) && (i + 1 < argc)) {
+			resume = argv[++i];
+		}
+		else if (((strcmp(argv[i], "-R") == 0) || (strcmp(argv[i], "--restore") == 0)) && (i + 1 < argc)) {
+			if (session_restore(&session, argv[++i]) < 0) {
+				fprintf(stderr, "error %s: ", argv[i]);
+				if (error_get()) { // no memory for the last result
+					error_fprint(stderr, &(struct error_state) {error_get(), NULL, NULL, 0, NULL});
+					fputc('\n', stderr);
+				}
+				else if (errno == EILSEQ) {
+					fprintf(stderr, "not a snapshot (or corrupted)\n");
+				}
+				else {
+					perror(NULL);
+				}
+				return 1;
+			}
+		}
+		else if ((strcmp(argv[i], "-j") == 0) && (i + 1 < argc) && (atoi(argv[i + 1]) > 0)) {
+			threads = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-l") == 0) && (i + 1 < argc)) {
+			sock_path = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-P") == 0) && (i + 1 < argc) && (atoi(argv[i + 1]) > 0)) {
+			port = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+			ring_name = argv[++i];
+		}
+		else if (strcmp(argv[i], "-b") == 0) { // the rest are files
+			batch_mode = 1;
+			nfiles = argc - i - 1;
+			files  = &argv[i + 1];
+			break;
+		}
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	alloc_set_scratch((session.scratch[0] != '\0' ? session.scratch : NULL), session.spill);
+	alloc_set_budget(session.process_budget);
+	ctx_set_default(&session.config);
+	progress_set_output(progress);
+	if ((resume != NULL) && (checkpoint_resume(resume) < 0)) {
+		fprintf(stderr, "error %s: ", resume);
+		if (error_get()) { // no memory for the saved state
+			error_fprint(stderr, &(struct error_state) {error_get(), NULL, NULL, 0, NULL});
+			fputc('\n', stderr);
+		}
+		else if (errno == EILSEQ) {
+			fprintf(stderr, "not a checkpoint (or corrupted)\n");
+		}
+		else {
+			perror(NULL);
+		}
+		return 1;
+	}
+	checkpoint_set((checkpoint != NULL ? checkpoint : resume), checkpoint_interval);
+
+	if (ring_name != NULL) {
+		struct ring * ring = ring_create(ring_name, RING_SLOTS, RING_SLOT_SIZE);
+		if (ring == NULL) {
+			return 1;
+		}
+		ring_catch_signals(ring);
+		ring_serve(ring);
+		ring_close(ring);
+		return 0;
+	}
+	if ((sock_path != NULL) || (port > 0)) {
+		server_catch_signals();
+		return (server(sock_path, port, threads) < 0);
+	}
+	if (batch_mode) {
+		return (batch_files(&session, nfiles, files, threads) > 0);
+	}
+	console(&session);
+	session_free(&session);
+
 	return 0;
-}
\ No newline at end of file
+}
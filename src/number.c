@@ -1,13 +1,21 @@
+#define _POSIX_C_SOURCE 200809L // open, O_CLOEXEC
 #include "number.h"
 
+#include <fcntl.h>
+#include <unistd.h>
 
 
+
+// on failure, `num` stays an integer and the error is set
 static void integer_to_big(struct number * num) {
 	assert(num->type == INTEGER);
-	long tmp_log = num->data.integer;
+	struct big_int * big = long_to_big(num->data.integer);
+	if (big == NULL) {
+		return;
+	}
+	log_info("int %ld -> big_int @%p", num->data.integer, big);
 	num->type = BIG;
-	num->data.big = long_to_big(num->data.integer);
-	log_info("int %ld -> big_int @%p", tmp_log, num->data.big);
+	num->data.big = big;
 }
 
 static struct number long_to_number(long l) {
@@ -17,6 +25,96 @@ static struct number long_to_number(long l) {
 	return num;
 }
 
+// 8 decimal digits at once (SWAR): the byte `i` of `w` is the digit `i` of the string
+// return -1 if one of them isn't a digit
+static long eight_digits(uint64_t w) {
+	uint64_t low  = w - 0x3030303030303030;                // '0' to 0
+	uint64_t high = w + 0x4646464646464646;                // over '9' to 0x80 and more
+	if ((low | high) & 0x8080808080808080) {
+		return -1;
+	}
+	low = (low * 10) + (low >> 8);                         // pairs of digits in the even bytes
+	low = (((low & 0x000000ff000000ff) * (100 + (1000000ULL << 32)))
+		+ (((low >> 16) & 0x000000ff000000ff) * (1 + (10000ULL << 32)))) >> 32;
+	return (long) low;
+}
+
+// `len` decimal digits (up to 18, always in a long), 8 at a time
+// return 0 if one of them isn't a digit, 1 otherwise
+static int decimal_to_long(int len, const char * str, long * res) {
+	assert(len <= 18);
+	long value = 0;
+	int i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w = 0;
+		for (int j = 0; j < 8; j++) { // a single load, in any byte order
+			w |= (uint64_t) (unsigned char) str[i + j] << (8 * j);
+		}
+		long eight = eight_digits(w);
+		if (eight < 0) {
+			return 0;
+		}
+		value = value * 100000000 + eight;
+	}
+	for (; i < len; i++) {
+		if (!isdigit((unsigned char) str[i])) {
+			return 0;
+		}
+		value = value * 10 + (str[i] - '0');
+	}
+	*res = value;
+	return 1;
+}
+
+// `len` digits of `base` (and its decimals in base 10) times 10 ^ expo in base 10,
+// 2 ^ expo otherwise: the value is built by a power kernel, never as digits
+static struct number scaled_number(int len, const char * str, int base, long expo) {
+
+	if (expo == LONG_MAX) {
+		error_set(POW_BIG, NULL, NULL, 0);
+		return long_to_number(0);
+	}
+	const char * point = memchr(str, '.', len);
+	int whole = (point != NULL ? point - str : len);
+
+	struct big_int_conv c;
+	if (big_int_conv_begin(&c, base, whole) < 0) {
+		return long_to_number(0);
+	}
+	int res = big_int_conv_digits(&c, str, whole);
+	if ((res == 0) && (point != NULL) && (base == 10)) { // the decimals before the exponent are digits
+		int decimals = len - whole - 1;
+		int n = (decimals < expo ? decimals : (int) expo);
+		if (n < decimals) {
+			log_warn("sorry, no float yet (%.*s truncated after %d decimals)", len, str, n);
+		}
+		res = big_int_conv_digits(&c, point + 1, n);
+		expo -= n;
+	}
+	if (res < 0) {
+		big_int_conv_free(&c);
+		return long_to_number(0);
+	}
+	struct big_int * big = big_int_conv_end(&c);
+	if (big == NULL) {
+		return long_to_number(0);
+	}
+	const unsigned char * bytes;
+	int n;
+	big_int_bytes(big, &bytes, &n);
+	if ((n == 1) && (bytes[0] == 0)) { // zero at any scale, no power is computed
+		big_int_free(big);
+		return long_to_number(0);
+	}
+	big = (base == 10 ? big_int_pow10(big, expo) : big_int_shl(big, expo));
+	if (error_get()) {
+		big_int_free(big);
+		return long_to_number(0);
+	}
+	log_info("big '%.*s' [base %d] scaled by %ld = @%p", len, str, base, expo, big);
+	return number_of_big(big);
+}
+
 static struct number str_to_number_base(int len, const char * str, int base) {
 	assert(str != NULL);
 	assert(len > 0);
@@ -24,7 +122,12 @@ static struct number str_to_number_base(int len, const char * str, int base) {
 
 	log_debug("struct number from '%.*s' [base %d]", len, str, base);
 
-	char * point = strchr(str, '.');
+	long expo = number_exponent(str, &len, base);
+	if (expo >= 0) {
+		return scaled_number(len, str, base, expo);
+	}
+
+	const char * point = memchr(str, '.', len); // the literal may not end the string (mapped file)
 	if ((point != NULL) && (point < str + len)) { // if there is a point
 		log_warn("sorry, no float yet (float %.*s -> int %.*s) [base %d]", len, str, point - str, str, base);
 		len = point - str; // for now NO FLOAT
@@ -37,7 +140,15 @@ static struct number str_to_number_base(int len, const char * str, int base) {
 	}
 	assert(base >= 2);
 
+	// the common case, without `strtol` and its checks
+	if ((base == 10) && (0 < len) && (len <= 18) && decimal_to_long(len, str, &num.data.integer)) {
+		log_info("int %ld ", num.data.integer);
+		num.type = INTEGER;
+		return num;
+	}
+
 	// try to fit in an `long`
+	errno = 0; // may be left by any previous call
 	num.data.integer = strtol(str, NULL, base);
 	if (!errno) {
 		log_info("int %ld ", num.data.integer);
@@ -51,11 +162,35 @@ static struct number str_to_number_base(int len, const char * str, int base) {
 
 	// try in a `struct big_int`
 	num.data.big = str_to_big(len, str, base);
+	if (num.data.big == NULL) { // no memory
+		return long_to_number(0);
+	}
 	log_info("big '%.*s' [base %d] = @%p", len, str, base, num.data.big);
 	num.type = BIG;
 	return num;
 }
 
+long number_exponent(const char * digits, int * len, int base) {
+	char marker = (base == 10 ? 'e' : 'p');
+	int i = *len;
+	while ((i > 0) && isdigit((unsigned char) digits[i - 1])) {
+		i--;
+	}
+	if ((i == *len) || (i < 2) || (tolower((unsigned char) digits[i - 1]) != marker)) { // a digit before it
+		return -1;
+	}
+	long expo = 0;
+	for (int j = i; j < *len; j++) {
+		if (expo > (LONG_MAX - 9) / 10) {
+			expo = LONG_MAX;
+			break;
+		}
+		expo = 10 * expo + (digits[j] - '0');
+	}
+	*len = i - 1;
+	return expo;
+}
+
 struct number str_to_number(int len, const char * str) {
 
 	if ((len >= 2) && (str[1] == 'x')) {
@@ -82,7 +217,9 @@ void number_neg(struct number * n1) {
 
 	if (n1->data.integer == LONG_MIN) { // special case
 		integer_to_big(n1);
-		big_int_neg(n1->data.big);
+		if (n1->type == BIG) {
+			big_int_neg(n1->data.big);
+		}
 		return;
 	}
 
@@ -100,6 +237,9 @@ static void convert_to_big_op(struct number * n1, struct number * n2, big_operat
 	if (n2->type == INTEGER) {
 		integer_to_big(n2);
 	}
+	if (error_get()) { // no memory
+		return;
+	}
 	assert(n1->type == BIG);
 	assert(n2->type == BIG);
 	n1->data.big = op(n1->data.big, n2->data.big);
@@ -185,40 +325,199 @@ void number_pow(struct number * n1, struct number * n2) {
 	assert(expo >= 0);
 	if (n1->type == INTEGER) {
 		integer_to_big(n1);
+		if (error_get()) { // no memory
+			return;
+		}
 	}
 	n1->data.big = big_int_pow(n1->data.big, expo);
 }
 
 
+void number_reserve(struct number * n1, long bytes) {
+	if ((bytes < ESTIMATE_RESERVE_MIN) || (bytes > INT_MAX)) {
+		return;
+	}
+	if (n1->type == INTEGER) {
+		integer_to_big(n1);
+		if (error_get()) { // no memory
+			return;
+		}
+	}
+	log_debug("reserve %ld bytes for big @%p", bytes, n1->data.big);
+	n1->data.big = big_int_reserve(n1->data.big, (int) bytes);
+}
+
+
 
-static void number_print_long(long num) {
-	if (num >= 0) {
-		printf("INT %#lx = %ld", num, num);
-	} 
-	else if (num == LONG_MIN) { // -LONG_MIN doesn't fit in a long
-		printf("INT -0x8000000000000000 = %ld", LONG_MIN);
-	} 
+static void number_write_long(struct output * o, long l) {
+	if (l >= 0) {
+		output_hex(o, l);
+	}
 	else {
-		printf("INT -%#lx = %ld", -num, num);
+		output_char(o, '-');
+		output_hex(o, -(unsigned long) l); // -LONG_MIN doesn't fit in a long
 	}
-	return;
 }
 
 void number_print(const struct number * const num) {
 
+	struct output o;
+	output_open(&o, stdout);
+
+	long l = (num->type == BIG ? big_to_long(num->data.big) : num->data.integer);
+	if ((num->type == BIG) && (l == LONG_MIN)) { // too big for an integer format
+		char head[32];
+		int len = snprintf(head, sizeof(head), "BIG [%d bytes] ", big_int_length(num->data.big));
+		output_mem(&o, head, len);
+		big_int_write(&o, num->data.big);
+	}
+	else {
+		output_mem(&o, "INT ", 4);
+		number_write_long(&o, l);
+		output_mem(&o, " = ", 3);
+		output_dec(&o, l);
+	}
+	output_close(&o);
+}
+
+void number_write(struct output * o, const struct number * const num) {
+
 	if (num->type == BIG) {
-		long r = big_to_long(num->data.big);
-		if (r != LONG_MIN) { // try to print in a integer format
-			number_print_long(r);
-			return;
-		}
-		printf("BIG [%d bytes] ", big_int_length(num->data.big));
-		big_int_print(num->data.big);
+		big_int_write(o, num->data.big);
 		return;
 	}
 	assert(num->type == INTEGER);
-	number_print_long(num->data.integer);
-	return;
+	number_write_long(o, num->data.integer);
+}
+
+void number_fprint(FILE * out, const struct number * const num) {
+	struct output o;
+	output_open(&o, out);
+	number_write(&o, num);
+	output_close(&o);
+}
+
+// bits per digit of `base`, -1 if it isn't 2, 4, 8 or 16
+static int base_bits(int base) {
+	for (int bits = 1; bits <= 4; bits++) {
+		if (base == (1 << bits)) {
+			return bits;
+		}
+	}
+	return -1;
+}
+
+int number_write_base(struct output * o, const struct number * const num, int base) {
+
+	int bits = base_bits(base);
+	if (bits < 0) {
+		return -1;
+	}
+	unsigned char small[sizeof(long)];
+	const unsigned char * bytes;
+	int len;
+	if (number_bytes(num, small, &bytes, &len)) {
+		output_char(o, '-');
+	}
+	if ((len > 1) || (bytes[0] != 0)) { // no prefix for zero, as `number_fprint`
+		output_char(o, (base == 16 ? '0' : '0' + base));
+		output_char(o, 'x');
+	}
+	output_digits(o, bytes, len, bits);
+	return 0;
+}
+
+long number_write_file(const char * path, const struct number * const num, int base) {
+
+	if (base_bits(base) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+	struct output o;
+	output_open_fd(&o, fd);
+	long written = -1;
+	if (number_write_base(&o, num, base) == 0) {
+		output_char(&o, '\n');
+		written = (output_close(&o) == 0 ? o.written : -1);
+	}
+	if ((close(fd) < 0) && (written >= 0)) {
+		written = -1;
+	}
+	return written;
+}
+
+long number_save(const struct number * const num, int fd) {
+
+	if (num->type == BIG) {
+		return big_int_save(num->data.big, fd);
+	}
+	struct big_int * big = long_to_big(num->data.integer);
+	if (big == NULL) {
+		return -1;
+	}
+	long written = big_int_save(big, fd);
+	big_int_free(big);
+	return written;
+}
+
+int number_load(int fd, off_t offset, struct number * num) {
+
+	struct big_int * big = big_int_load(fd, offset);
+	if (big == NULL) {
+		return -1;
+	}
+	*num = number_of_big(big);
+	return 0;
+}
+
+struct number number_of_big(struct big_int * big) {
+	const unsigned char * bytes;
+	int len;
+	big_int_bytes(big, &bytes, &len);
+	long l = big_to_long(big);
+	if ((l != LONG_MIN) || ((len == 1) && (bytes[0] == 0))) { // as a literal of the same value
+		big_int_free(big);
+		return long_to_number(l == LONG_MIN ? 0 : l);
+	}
+	struct number num;
+	num.type = BIG;
+	num.data.big = big;
+	return num;
+}
+
+int number_bytes(const struct number * num, unsigned char small[sizeof(long)], const unsigned char ** bytes, int * len) {
+
+	if (num->type == BIG) {
+		return big_int_bytes(num->data.big, bytes, len);
+	}
+	assert(num->type == INTEGER);
+	long l = num->data.integer;
+	unsigned long abs = (l < 0 ? -(unsigned long) l : (unsigned long) l);
+	int n = 0;
+	do { // same bytes as a big_int, at least one
+		small[n++] = (unsigned char) abs;
+		abs >>= 8;
+	} while (abs != 0);
+	*bytes = small;
+	*len   = n;
+	return (l < 0);
+}
+
+struct number number_dup(const struct number * const num) {
+	if (num->type == INTEGER) {
+		return *num;
+	}
+	struct number dup;
+	dup.type = BIG;
+	dup.data.big = big_int_copy(num->data.big);
+	if (dup.data.big == NULL) { // no memory
+		return long_to_number(0);
+	}
+	return dup;
 }
 
 void number_copy(const struct number * const src, struct number * const dst) {
@@ -266,6 +565,27 @@ void test_number() {
 	assert(sn4.data.integer == 16);
 	number_free(sn4);
 
+	struct number sn5 = str_to_number(18, "987654321012345678"); // 8 digits at once
+	assert((sn5.type == INTEGER) && (sn5.data.integer == 987654321012345678));
+	sn5 = str_to_number(10, "0012345678");
+	assert((sn5.type == INTEGER) && (sn5.data.integer == 12345678));
+	sn5 = str_to_number(11, "87654321.99");
+	assert((sn5.type == INTEGER) && (sn5.data.integer == 87654321));
+	sn5 = str_to_number(19, "9223372036854775807"); // `strtol` from 19 digits
+	assert((sn5.type == INTEGER) && (sn5.data.integer == LONG_MAX));
+	long l;
+	assert(!decimal_to_long(8, "1234:678", &l));
+	assert(!decimal_to_long(9, "12345678/", &l));
+	assert(decimal_to_long(16, "9999999999999999", &l) && (l == 9999999999999999));
+	sn5 = str_to_number(3, "0e5"); // zero at any scale is the integer 0
+	assert((sn5.type == INTEGER) && (sn5.data.integer == 0));
+	sn5 = str_to_number(4, "00e3");
+	assert((sn5.type == INTEGER) && (sn5.data.integer == 0));
+	sn5 = str_to_number(5, "0x0p5");
+	assert((sn5.type == INTEGER) && (sn5.data.integer == 0));
+	sn5 = number_of_big(long_to_big(0));
+	assert((sn5.type == INTEGER) && (sn5.data.integer == 0));
+
 
 	printf(" number_neg\n");
 	struct number ne = long_to_number(56);
@@ -2,15 +2,19 @@
 #define NUMBER_H
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "big_int.h"
+#include "config.h"
 #include "error.h"
 #include "limits.h"
 #include "log.h"
+#include "output.h"
 
 
 struct number {
@@ -26,8 +30,17 @@ struct number {
 };
 
 
+// literals like `1e1000` (times 10 ^ 1000), or `2x11p64` in a prefixed base (times 2 ^ 64)
 struct number str_to_number(int len, const char * str);
 
+// exponent of the `*len` digits of a literal (without the prefix of its base), then `*len`
+// stops before its marker
+// return -1 if none, LONG_MAX if it doesn't fit in a long
+long number_exponent(const char * digits, int * len, int base);
+
+// `big` as a literal of the same value: an INTEGER if it fits (then `big` is freed)
+struct number number_of_big(struct big_int * big);
+
 
 // n2 may be free after each operation, the result is in n1
 void number_neg(struct number * n1);
@@ -40,9 +53,41 @@ void number_mul(struct number * n1, struct number * n2);
 
 void number_pow(struct number * n1, struct number * n2);
 
+// pre-size `n1` for a result of `bytes` (small results are ignored)
+void number_reserve(struct number * n1, long bytes);
+
 
 void number_print(const struct number * const num);
 
+// only the value in hexadecimal (like `-0x1f`)
+void number_fprint(FILE * out, const struct number * const num);
+
+void number_write(struct output * o, const struct number * const num);
+
+// in base 2, 4, 8 or 16, with the prefix of the lexer (like `-8x17`)
+// return -1 if the base isn't one of them
+int number_write_base(struct output * o, const struct number * const num, int base);
+
+// write the digits (`number_write_base`) and '\n' in the file `path`, by blocks
+// return the bytes written, -1 on failure (see `errno`)
+long number_write_file(const char * path, const struct number * const num, int base);
+
+// save in `fd` from its current position (see `big_int_save`)
+// return the bytes written, -1 on failure (see `errno`)
+long number_save(const struct number * const num, int fd);
+
+// load in `num` what `number_save` wrote from `offset` in `fd`
+// return 0, -1 on failure (as `big_int_load`)
+int number_load(int fd, off_t offset, struct number * num);
+
+// bytes of the absolute value (little endian) in `*bytes`, `*len` of them
+// without copy for a big_int, in `small` for an integer
+// return 1 if `num` is negative
+int number_bytes(const struct number * num, unsigned char small[sizeof(long)], const unsigned char ** bytes, int * len);
+
+// deep copy (0 on failure, with the error set)
+struct number number_dup(const struct number * const num);
+
 void number_copy(const struct number * const src, struct number * const dst);
 
 void number_free(struct number num);
@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L // fileno, open_memstream
+#include "output.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+
+#define HEX_ROW(h) h"0" h"1" h"2" h"3" h"4" h"5" h"6" h"7" h"8" h"9" h"a" h"b" h"c" h"d" h"e" h"f"
+#define DEC_ROW(d) d"0" d"1" d"2" d"3" d"4" d"5" d"6" d"7" d"8" d"9"
+
+// "00" to "ff", the digits of the byte `b` are at `2 * b`
+static const char hex_pairs[] =
+	HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3") HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+	HEX_ROW("8") HEX_ROW("9") HEX_ROW("a") HEX_ROW("b") HEX_ROW("c") HEX_ROW("d") HEX_ROW("e") HEX_ROW("f");
+
+// "00" to "99"
+static const char dec_pairs[] =
+	DEC_ROW("0") DEC_ROW("1") DEC_ROW("2") DEC_ROW("3") DEC_ROW("4")
+	DEC_ROW("5") DEC_ROW("6") DEC_ROW("7") DEC_ROW("8") DEC_ROW("9");
+
+
+static void write_all(struct output * o, const char * mem, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(o->fd, mem, len);
+		if (n > 0) {
+			mem += n;
+			len -= n;
+		}
+		else if ((n < 0) && (errno == EINTR)) {
+			continue;
+		}
+		else {
+			log_warn("output: write: %s", strerror(errno));
+			o->error = 1;
+			return;
+		}
+	}
+}
+
+// the buffer is full: from now on, the blocks skip the buffer of the stream
+static void output_flush(struct output * o) {
+	if (!o->direct && ((o->fd = fileno(o->fp)) >= 0) && (fflush(o->fp) == 0)) {
+		o->direct = 1;
+	}
+	if (o->direct) {
+		write_all(o, o->buf, o->len);
+	}
+	else if (fwrite(o->buf, 1, o->len, o->fp) != o->len) { // memory stream
+		o->error = 1;
+	}
+	o->written += o->len;
+	o->len = 0;
+}
+
+
+void output_open(struct output * o, FILE * fp) {
+	o->fp     = fp;
+	o->fd     = -1;
+	o->direct = 0;
+	o->error  = 0;
+	o->written = 0;
+	o->len    = 0;
+}
+
+void output_open_fd(struct output * o, int fd) {
+	o->fp     = NULL;
+	o->fd     = fd;
+	o->direct = 1;
+	o->error  = 0;
+	o->written = 0;
+	o->len    = 0;
+}
+
+int output_close(struct output * o) {
+	if (o->direct) {
+		write_all(o, o->buf, o->len);
+	}
+	else if (fwrite(o->buf, 1, o->len, o->fp) != o->len) {
+		o->error = 1;
+	}
+	o->written += o->len;
+	o->len = 0;
+	return (o->error ? -1 : 0);
+}
+
+
+void output_char(struct output * o, char c) {
+	if (o->len == OUTPUT_BUFFER) {
+		output_flush(o);
+	}
+	o->buf[o->len++] = c;
+}
+
+void output_mem(struct output * o, const char * mem, size_t len) {
+	while (len > 0) {
+		if (o->len == OUTPUT_BUFFER) {
+			output_flush(o);
+		}
+		size_t n = (len < OUTPUT_BUFFER - o->len ? len : OUTPUT_BUFFER - o->len);
+		memcpy(o->buf + o->len, mem, n);
+		o->len += n;
+		mem += n;
+		len -= n;
+	}
+}
+
+void output_hex(struct output * o, unsigned long l) {
+	if (l == 0) {
+		output_char(o, '0');
+		return;
+	}
+	char digits[2 + 2 * sizeof(long)];
+	int i = sizeof(digits);
+	while (l > 0xf) {
+		i -= 2;
+		memcpy(&digits[i], &hex_pairs[2 * (l & 0xff)], 2);
+		l >>= 8;
+	}
+	if (l > 0) {
+		digits[--i] = hex_pairs[2 * l + 1];
+	}
+	digits[--i] = 'x';
+	digits[--i] = '0';
+	output_mem(o, &digits[i], sizeof(digits) - i);
+}
+
+void output_dec(struct output * o, long l) {
+	unsigned long u = (l < 0 ? -(unsigned long) l : (unsigned long) l); // -LONG_MIN doesn't fit in a long
+	char digits[1 + 20];
+	int i = sizeof(digits);
+	while (u >= 100) {
+		i -= 2;
+		memcpy(&digits[i], &dec_pairs[2 * (u % 100)], 2);
+		u /= 100;
+	}
+	if (u >= 10) {
+		i -= 2;
+		memcpy(&digits[i], &dec_pairs[2 * u], 2);
+	}
+	else {
+		digits[--i] = '0' + u;
+	}
+	if (l < 0) {
+		digits[--i] = '-';
+	}
+	output_mem(o, &digits[i], sizeof(digits) - i);
+}
+
+void output_hex_bytes(struct output * o, const unsigned char * bytes, int len) {
+	assert(len > 0);
+
+	unsigned char first = bytes[len - 1];
+	if (first > 0xf) {
+		output_mem(o, &hex_pairs[2 * first], 2);
+	}
+	else {
+		output_char(o, hex_pairs[2 * first + 1]);
+	}
+
+	int i = len - 2; // next byte
+	while (i >= 0) {
+		if (OUTPUT_BUFFER - o->len < 2) {
+			output_flush(o);
+		}
+		int n = (OUTPUT_BUFFER - o->len) / 2; // bytes until the buffer is full
+		if (n > i + 1) {
+			n = i + 1;
+		}
+		char * p = o->buf + o->len;
+		for (int k = 0; k < n; k++) {
+			memcpy(p, &hex_pairs[2 * bytes[i - k]], 2);
+			p += 2;
+		}
+		o->len += 2 * n;
+		i -= n;
+	}
+}
+
+void output_digits(struct output * o, const unsigned char * bytes, int len, int bits) {
+	assert((1 <= bits) && (bits <= 4));
+
+	while ((len > 1) && (bytes[len - 1] == 0)) {
+		len--;
+	}
+	if (bits == 4) {
+		output_hex_bytes(o, bytes, len);
+		return;
+	}
+	long nbits = 8L * (len - 1);
+	for (unsigned char top = bytes[len - 1]; top != 0; top >>= 1) {
+		nbits++;
+	}
+	long digits = (nbits + bits - 1) / bits;
+	if (digits == 0) {
+		output_char(o, '0');
+		return;
+	}
+	unsigned mask = (1U << bits) - 1;
+	for (long d = digits - 1; d >= 0; d--) { // from the most significant
+		long bit  = d * bits;
+		long byte = bit >> 3;
+		int shift = bit & 7;
+		unsigned v = bytes[byte] >> shift;
+		if ((shift + bits > 8) && (byte + 1 < len)) { // across two bytes (base 8)
+			v |= (unsigned) bytes[byte + 1] << (8 - shift);
+		}
+		output_char(o, hex_pairs[2 * (v & mask) + 1]);
+	}
+}
+
+
+
+/*
+	TEST
+*/
+
+
+void test_output() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("OUTPUT:\n");
+	char * res;
+	size_t res_len;
+	char expected[64];
+	struct output * o = malloc(sizeof(struct output));
+	CHECK_MALLOC(o, "test output");
+
+
+	printf(" integers\n");
+	long values[] = {0, 1, 9, 10, 15, 16, 99, 100, 255, 256, 4096, 123456789, LONG_MAX, -1, -100, LONG_MIN};
+	int n = sizeof(values) / sizeof(long);
+	for (int i = 0; i < n; i++) {
+		FILE * mem = open_memstream(&res, &res_len);
+		output_open(o, mem);
+		output_hex(o, (unsigned long) values[i]);
+		output_char(o, ' ');
+		output_dec(o, values[i]);
+		assert(output_close(o) == 0);
+		fclose(mem);
+		snprintf(expected, sizeof(expected), "%#lx %ld", (unsigned long) values[i], values[i]);
+		assert(strcmp(res, expected) == 0);
+		free(res);
+	}
+
+
+	printf(" bytes\n");
+	unsigned char bytes[] = {0x05, 0x00, 0xab, 0x0c};
+	FILE * mem = open_memstream(&res, &res_len);
+	output_open(o, mem);
+	output_hex_bytes(o, bytes, 4);
+	output_char(o, ' ');
+	output_hex_bytes(o, bytes, 3);
+	output_close(o);
+	fclose(mem);
+	assert(strcmp(res, "cab0005 ab0005") == 0);
+	free(res);
+
+
+	printf(" digits\n");
+	unsigned char value[] = {0x05, 0x00, 0xab}; // 0xab0005
+	for (int bits = 1; bits <= 4; bits++) {
+		mem = open_memstream(&res, &res_len);
+		output_open(o, mem);
+		output_digits(o, value, 3, bits);
+		output_close(o);
+		fclose(mem);
+		char digits[32];
+		int i = sizeof(digits) - 1;
+		digits[i] = '\0';
+		for (unsigned long v = 0xab0005; v != 0; v >>= bits) {
+			digits[--i] = "0123456789abcdef"[v & ((1 << bits) - 1)];
+		}
+		assert(strcmp(res, &digits[i]) == 0);
+		free(res);
+	}
+	unsigned char zero[] = {0, 0};
+	mem = open_memstream(&res, &res_len);
+	output_open(o, mem);
+	output_digits(o, zero, 2, 1);
+	output_close(o);
+	fclose(mem);
+	assert(strcmp(res, "0") == 0);
+	free(res);
+
+
+	printf(" blocks\n"); // longer than the buffer, around the lines of the stream
+	int len = OUTPUT_BUFFER + 1000;
+	unsigned char * big = malloc(len);
+	char * text = malloc(2 * len + 16);
+	assert((big != NULL) && (text != NULL));
+	for (int i = 0; i < len; i++) {
+		big[i] = (unsigned char) (i * 7 + 1);
+	}
+	FILE * file = tmpfile();
+	assert(file != NULL);
+	fputs("before\n", file);
+	output_open(o, file);
+	output_hex_bytes(o, big, len);
+	assert(o->direct);
+	assert(output_close(o) == 0);
+	fputs("\nafter\n", file);
+	rewind(file);
+	assert(fgets(text, 2 * len + 16, file) != NULL);
+	assert(strcmp(text, "before\n") == 0);
+	assert(fgets(text, 2 * len + 16, file) != NULL);
+	char pair[3];
+	int w = sprintf(pair, "%hhx", big[len - 1]);
+	assert(strncmp(text, pair, w) == 0);
+	for (int i = len - 2; i >= 0; i--) {
+		sprintf(pair, "%02hhx", big[i]);
+		assert(strncmp(&text[w + 2 * (len - 2 - i)], pair, 2) == 0);
+	}
+	assert(text[w + 2 * (len - 1)] == '\n');
+	assert(fgets(text, 2 * len + 16, file) != NULL);
+	assert(strcmp(text, "after\n") == 0);
+	fclose(file);
+	free(big);
+	free(text);
+	free(o);
+
+
+	printf("done\n\n");
+	#endif
+}
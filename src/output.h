@@ -0,0 +1,66 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "log.h"
+
+
+/*
+	Buffered writer of the results
+
+The digits are formatted in a buffer of `OUTPUT_BUFFER` bytes (on the stack of
+the caller) with tables of digit pairs, without `printf`. A short result is
+given to the stream as one block, so it stays in its buffer with the lines
+around it. A result longer than the buffer is written to the file descriptor
+of the stream (after flushing the stream) block by block.
+
+On a file descriptor (`output_open_fd`), every block is written directly: the
+memory stays bounded whatever the length of the result.
+*/
+
+
+struct output {
+	FILE * fp;  // NULL for a file descriptor only
+	int fd;
+	int direct; // the blocks go to `fd`
+	int error;  // a write failed
+	long written; // bytes out of the buffer
+	size_t len;
+	char buf[OUTPUT_BUFFER];
+};
+
+
+void output_open(struct output * o, FILE * fp);
+
+void output_open_fd(struct output * o, int fd);
+
+// write what is left, return -1 if a write failed, 0 otherwise
+int output_close(struct output * o);
+
+
+void output_char(struct output * o, char c);
+
+void output_mem(struct output * o, const char * mem, size_t len);
+
+// as `printf("%#lx")`
+void output_hex(struct output * o, unsigned long l);
+
+// as `printf("%ld")`
+void output_dec(struct output * o, long l);
+
+// bytes of a big-endian number stored little endian (`bytes[len - 1]` first)
+// without the leading zero of the first byte, as `printf("%hhx")` then `"%02hhx"`
+void output_hex_bytes(struct output * o, const unsigned char * bytes, int len);
+
+// same in base 2^`bits` (1 to 4), without leading zeros ("0" for zero)
+void output_digits(struct output * o, const unsigned char * bytes, int len, int bits);
+
+
+void test_output();
+
+
+#endif // OUTPUT_H
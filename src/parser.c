@@ -9,34 +9,36 @@
 	INTERFACE lexer/parser
 */
 
-static int is_binary_op(int i, const struct token * list) {
-	assert(list[i].type == SYMBOL);
+// on the types of the lexer
+static int is_binary_op(int i, const struct expr * e) {
+	assert(token_type(e, i) == SYMBOL);
 
 	if (i == 0) { // first token
 		return 0;
 	}
 	assert(i > 0);
-	enum token_type previous = list[i - 1].type;
+	enum token_type previous = token_type(e, i - 1);
 	return ((previous == NUMBER) || (previous == NAME) || (previous == RPARENT)); // juste AFTER is an operand
 }
 
-static enum token_type convert_token(int i, int n, const struct token * t) {
+// the token `i` of the lexer, the tokens after it may be converted already
+static enum token_type convert_token(int i, const struct expr * e) {
 
-	struct token token = t[i];
+	struct token token = token_get(e, i);
 	switch (token.type) {
 
 		case NAME:
-			if ((i + 1 < n) && (t[i + 1].type == LPARENT)) { // if there is a '(' after NAME
+			if ((i + 1 < e->len) && (token_type(e, i + 1) == LPARENT)) { // if there is a '(' after NAME
 				return FUNC_NAME;
 			}
 			return VAR_OPERAND;
 
 		case SYMBOL: {
 			if (strncmp(token.str, "+", token.len) == 0) {
-				return (is_binary_op(i, t) ? PLUS : UNARY_PLUS);
+				return (is_binary_op(i, e) ? PLUS : UNARY_PLUS);
 			}
 			if (strncmp(token.str, "-", token.len) == 0) {
-				return (is_binary_op(i, t) ? MINUS : UNARY_MINUS);
+				return (is_binary_op(i, e) ? MINUS : UNARY_MINUS);
 			}
 			if (strncmp(token.str, "*", token.len) == 0) {
 				return ASTERISK;
@@ -58,22 +60,25 @@ static enum token_type convert_token(int i, int n, const struct token * t) {
 	}
 }
 
-struct expr lexer_to_parser(const struct expr * e) {
+// in place, from the last token: a token is converted once the ones before it are read
+struct expr lexer_to_parser(struct calc_ctx * ctx, struct expr * e) {
 
-	struct expr result = token_expr(e->len);
-	enum token_type tmp;
+	struct expr result = *e;
+	*e = token_expr(e->src, 0); // moved
+	int unknown = -1; // the first one
 
-	for (int i = 0; i < e->len; i++) {
-
-		tmp = convert_token(i, e->len, e->list);
-		if (tmp == UNKNOWN) {
-			error_set(UNKNOWN_TOK, NULL, e->list[i].str, e->list[i].len);
-			return result;
+	for (int i = result.len - 1; i >= 0; i--) {
+		enum token_type type = convert_token(i, &result);
+		if (type == UNKNOWN) {
+			unknown = i;
+			continue;
 		}
-		result.list[i]      = e->list[i];
-		result.list[i].type = tmp;
+		token_set_type(&result, i, type);
+	}
+	if (unknown >= 0) {
+		struct token t = token_get(&result, unknown);
+		ctx_error_set(ctx, UNKNOWN_TOK, NULL, t.str, t.len);
 	}
-
 	return result;
 }
 
@@ -87,20 +92,21 @@ Otherwise, returns 1 and edits the `struct pexpr` with the corresponding error.
 
 */
 
-#define TOKEN_STACK(size) stack_malloc(sizeof(struct token), size, (stack_copy_elem) token_copy);
+#define INDEX_STACK(size) stack_malloc(sizeof(int), size, (stack_copy_elem) token_copy_index);
 
 // check parenthesis by counting them (no allocation)
 // return 0 if correct, otherwise the max(lp, rp)
-static int correct_parenthesis(int n, const struct token * l) {
+static int correct_parenthesis(const struct expr * e) {
 	int lp = 0;
 	int rp = 0;
 
-	for (int i = 0; i < n; i++) {
+	for (int i = 0; i < e->len; i++) {
 
-		if (l[i].type == LPARENT) {
+		enum token_type type = token_type(e, i);
+		if (type == LPARENT) {
 			lp++;
 		}
-		else if (l[i].type == RPARENT) {
+		else if (type == RPARENT) {
 			rp++;
 			if (rp > lp) { // more RP than LP
 				return rp;
@@ -111,24 +117,28 @@ static int correct_parenthesis(int n, const struct token * l) {
 }
 
 // call `correct_parenthesis` and then find the wrong one (using stack)
-static int check_parenthesis(int n, const struct token * list) {
+static int check_parenthesis(struct calc_ctx * ctx, const struct expr * e) {
 
-	int size = correct_parenthesis(n, list);
+	int size = correct_parenthesis(e);
 	if (size == 0) {
 		return 0;
 	}
 
-	struct stack * stack = TOKEN_STACK(size);
-	struct token tmp;
+	struct stack * stack = INDEX_STACK(size);
+	if (stack == NULL) {
+		ctx_error_set(ctx, OUT_OF_MEM, NULL, NULL, 0);
+		return 1;
+	}
+	int tmp;
 
-	for (int i = 0; i < n; i++) {
+	for (int i = 0; i < e->len; i++) {
 
-		if (list[i].type == LPARENT) {
-			stack_push(stack, &list[i]);
+		if (token_type(e, i) == LPARENT) {
+			stack_push(stack, &i);
 		}
-		else if (list[i].type == RPARENT) {
+		else if (token_type(e, i) == RPARENT) {
 			if (stack_empty(stack)) { // no corresponding LPARENT
-				stack_push(stack, &list[i]);
+				stack_push(stack, &i);
 				break;
 			}
 			stack_pop(stack, &tmp);
@@ -138,7 +148,7 @@ static int check_parenthesis(int n, const struct token * list) {
 
 	stack_pop(stack, &tmp);
 	stack_free(stack);
-	error_set(MIS_PARENT, tmp.str, NULL, 0);
+	ctx_error_set(ctx, MIS_PARENT, token_get(e, tmp).str, NULL, 0);
 	return 1;
 }
 
@@ -168,30 +178,32 @@ static int correct_next_token(enum token_type curr, enum token_type next) {
 }
 
 // check basic rules about order of token of a math expression
-static int check_token_order(int n, const struct token * list) {
+static int check_token_order(struct calc_ctx * ctx, const struct expr * e) {
 
+	int n = e->len;
 	if (n <= 0) { // no token to check
 		return 0;
 	}
 
-	enum token_type init = list[0].type;
+	enum token_type init = token_type(e, 0);
 	if (!( OPERAND(init) || UNARY(init) || (init == FUNC_NAME) || (init == LPARENT) )) { // check first token
-		error_set(UNEXP_TOK, NULL, list[0].str, list[0].len);
+		struct token t = token_get(e, 0);
+		ctx_error_set(ctx, UNEXP_TOK, NULL, t.str, t.len);
 		return 1;
 	}
 
 	for (int i = 1; i < n; i++) {
-		const struct token t1 = list[i - 1];
-		const struct token t2 = list[i];
-		if (!correct_next_token(t1.type, t2.type)) {
-			error_set(UNEXP_TOK, NULL, t2.str, t2.len);
+		if (!correct_next_token(token_type(e, i - 1), token_type(e, i))) {
+			struct token t2 = token_get(e, i);
+			ctx_error_set(ctx, UNEXP_TOK, NULL, t2.str, t2.len);
 			return 1;
 		}
 	}
 
-	enum token_type last = list[n - 1].type; // check last token
+	enum token_type last = token_type(e, n - 1); // check last token
 	if (!( OPERAND(last) || (last == RPARENT) )) {
-		error_set(UNEXP_TOK, NULL, list[n - 1].str, list[n - 1].len);
+		struct token t = token_get(e, n - 1);
+		ctx_error_set(ctx, UNEXP_TOK, NULL, t.str, t.len);
 		return 1;
 	}
 	return 0;
@@ -199,40 +211,45 @@ static int check_token_order(int n, const struct token * list) {
 
 
 
-static struct token * find_last_function(struct stack * scope) {
-	struct token dump; 	
+// index of the last function of the scope, -1 if none
+static int find_last_function(const struct expr * e, struct stack * scope) {
+	int dump;
 	while (!stack_empty(scope)) {
 
-		struct token * top = (struct token *) stack_peek(scope);
-		if (top->type == FUNC_NAME) {
+		int top = *(int *) stack_peek(scope);
+		if (token_type(e, top) == FUNC_NAME) {
 			return top;
 		}
 		stack_pop(scope, &dump);
 	}
-	return NULL;
+	return -1;
 }
 
 // assume `correct_parenthesis` to not check this again
 //    and `check_token_order` to assure FUNC_NAME is followed by LPARENT
 // check ARG_SEP are in the right penrenthesis scope (using stack)
-static int check_arg_sep(int n, const struct token * list) {
-	assert(correct_parenthesis(n, list) == 0);
-	assert(check_token_order(n, list) == 0);
+static int check_arg_sep(struct calc_ctx * ctx, const struct expr * e) {
+	assert(correct_parenthesis(e) == 0);
+	assert(check_token_order(ctx, e) == 0);
 
-	struct stack * scope = TOKEN_STACK(n); // scope are functions or parenthesis
-	struct token dump;
+	struct stack * scope = INDEX_STACK(e->len); // scope are functions or parenthesis
+	if (scope == NULL) {
+		ctx_error_set(ctx, OUT_OF_MEM, NULL, NULL, 0);
+		return 1;
+	}
+	int dump;
 
 	int i = 0;
-	while (i < n) {
-		switch (list[i].type) {
+	while (i < e->len) {
+		switch (token_type(e, i)) {
 
 			case FUNC_NAME:
-				stack_push(scope, &list[i]); 		// function scope
+				stack_push(scope, &i); 				// function scope
 				i += 2; 							// skip the (
 				break;
 
 			case LPARENT:
-				stack_push(scope, &list[i]);		// math expression (not a function call)
+				stack_push(scope, &i);				// math expression (not a function call)
 				i++;
 				break;
 
@@ -242,13 +259,15 @@ static int check_arg_sep(int n, const struct token * list) {
 				break;
 
 			case ARG_SEP: {							// check that the last scope is a function
-				if (stack_empty(scope) || (((struct token *) stack_peek(scope))->type != FUNC_NAME)) {
+				if (stack_empty(scope) || (token_type(e, *(int *) stack_peek(scope)) != FUNC_NAME)) {
 					
-					struct token * func = find_last_function(scope);
-					if (func != NULL) {
-						error_set(MIS_ARG_SEP, list[i].str, func->str, func->len);
+					int func = find_last_function(e, scope);
+					const char * sep = token_get(e, i).str;
+					if (func >= 0) {
+						struct token f = token_get(e, func);
+						ctx_error_set(ctx, MIS_ARG_SEP, sep, f.str, f.len);
 					} else {
-						error_set(MIS_ARG_SEP, list[i].str, NULL, 0);
+						ctx_error_set(ctx, MIS_ARG_SEP, sep, NULL, 0);
 					}
 					stack_free(scope);
 					return 1;
@@ -273,16 +292,16 @@ static int check_arg_sep(int n, const struct token * list) {
 	check_syntax
 */
 
-int parser_check_syntax(const struct expr e) {
+int parser_check_syntax(struct calc_ctx * ctx, const struct expr e) {
 
-	if (check_parenthesis(e.len, e.list)) {
+	if (check_parenthesis(ctx, &e)) {
 		return 1;
 	}
-	if (check_token_order(e.len, e.list)) {
+	if (check_token_order(ctx, &e)) {
 		return 1;
 	}
 	// and sorry, I failed to check the syntaxe without additional allocation
-	if (check_arg_sep(e.len, e.list)) {
+	if (check_arg_sep(ctx, &e)) {
 		return 1;
 	}
 	return 0;
@@ -300,76 +319,72 @@ void test_parser() {
 	exit(1);
 	#else
 	printf("PARSER: \n");
+	struct calc_ctx * ctx = ctx_new();
 
 
 	printf(" is_binary_op\n");
-	struct expr lex1 = lexer("-3 + -2 * f(-1)");
-	assert(!is_binary_op(0, lex1.list));
-	assert(is_binary_op (2, lex1.list));
-	assert(!is_binary_op(3, lex1.list));
-	assert(is_binary_op (5, lex1.list));
-	assert(!is_binary_op(8, lex1.list));
+	struct expr lex1 = lexer(ctx, "-3 + -2 * f(-1)");
+	assert(!is_binary_op(0, &lex1));
+	assert(is_binary_op (2, &lex1));
+	assert(!is_binary_op(3, &lex1));
+	assert(is_binary_op (5, &lex1));
+	assert(!is_binary_op(8, &lex1));
 	token_free_expr(&lex1);
 
 
 	printf(" convert_token\n");
-	struct expr lex2 = lexer("12 + -(13.0 * +var_1 - max(-1, 2))");
-	assert(error_get() == NO_ERROR);
+	struct expr lex2 = lexer(ctx, "12 + -(13.0 * +var_1 - max(-1, 2))");
+	assert(ctx_error(ctx) == NO_ERROR);
 	assert(lex2.len == 17);
 
-	int size2 = lex2.len;
-	assert(convert_token(0,  size2, lex2.list) == NUM_OPERAND);
-	assert(convert_token(1,  size2, lex2.list) == PLUS);
-	assert(convert_token(2,  size2, lex2.list) == UNARY_MINUS);
-	assert(convert_token(3,  size2, lex2.list) == LPARENT);
-	assert(convert_token(4,  size2, lex2.list) == NUM_OPERAND);
-	assert(convert_token(5,  size2, lex2.list) == ASTERISK);
-	assert(convert_token(6,  size2, lex2.list) == UNARY_PLUS);
-	assert(convert_token(7,  size2, lex2.list) == VAR_OPERAND);
-	assert(convert_token(8,  size2, lex2.list) == MINUS);
-	assert(convert_token(9,  size2, lex2.list) == FUNC_NAME);
-	assert(convert_token(10, size2, lex2.list) == LPARENT);
-	assert(convert_token(11, size2, lex2.list) == UNARY_MINUS);
-	assert(convert_token(12, size2, lex2.list) == NUM_OPERAND);
-	assert(convert_token(13, size2, lex2.list) == ARG_SEP);
-	assert(convert_token(14, size2, lex2.list) == NUM_OPERAND);
-	assert(convert_token(15, size2, lex2.list) == RPARENT);
-	assert(convert_token(16, size2, lex2.list) == RPARENT);
+	assert(convert_token(0, &lex2) == NUM_OPERAND);
+	assert(convert_token(1, &lex2) == PLUS);
+	assert(convert_token(2, &lex2) == UNARY_MINUS);
+	assert(convert_token(3, &lex2) == LPARENT);
+	assert(convert_token(4, &lex2) == NUM_OPERAND);
+	assert(convert_token(5, &lex2) == ASTERISK);
+	assert(convert_token(6, &lex2) == UNARY_PLUS);
+	assert(convert_token(7, &lex2) == VAR_OPERAND);
+	assert(convert_token(8, &lex2) == MINUS);
+	assert(convert_token(9, &lex2) == FUNC_NAME);
+	assert(convert_token(10, &lex2) == LPARENT);
+	assert(convert_token(11, &lex2) == UNARY_MINUS);
+	assert(convert_token(12, &lex2) == NUM_OPERAND);
+	assert(convert_token(13, &lex2) == ARG_SEP);
+	assert(convert_token(14, &lex2) == NUM_OPERAND);
+	assert(convert_token(15, &lex2) == RPARENT);
+	assert(convert_token(16, &lex2) == RPARENT);
 	token_free_expr(&lex2);
 
 
 	printf(" correct_parenthesis\n");
 	struct expr lex;
 	struct expr pars;
-	int size;
 
-	lex  = lexer("() () () ( () () )");
-	size = lex.len;
-	pars = lexer_to_parser(&lex);
+	lex  = lexer(ctx, "() () () ( () () )");
+	pars = lexer_to_parser(ctx, &lex);
 	token_free_expr(&lex);
-	assert(correct_parenthesis(size, pars.list) == 0);
+	assert(correct_parenthesis(&pars) == 0);
 	token_free_expr(&pars);
 
-	lex  = lexer("() () () ( () () )");
-	size = lex.len;
-	pars = lexer_to_parser(&lex);
+	lex  = lexer(ctx, "() () () ( () () )");
+	pars = lexer_to_parser(ctx, &lex);
 	token_free_expr(&lex);
-	assert(correct_parenthesis(size, pars.list) == 0);
+	assert(correct_parenthesis(&pars) == 0);
 	token_free_expr(&pars);
 
-	lex  = lexer("( () )) ((()))");
-	size = lex.len;
-	pars = lexer_to_parser(&lex);
+	lex  = lexer(ctx, "( () )) ((()))");
+	pars = lexer_to_parser(ctx, &lex);
 	token_free_expr(&lex);
-	assert(correct_parenthesis(size, pars.list) == 3);
+	assert(correct_parenthesis(&pars) == 3);
 	token_free_expr(&pars);
 
-	lex  = lexer("( () (()))");
-	size = lex.len;
-	pars = lexer_to_parser(&lex);
+	lex  = lexer(ctx, "( () (()))");
+	pars = lexer_to_parser(ctx, &lex);
 	token_free_expr(&lex);
-	assert(correct_parenthesis(size, pars.list) == 0);
+	assert(correct_parenthesis(&pars) == 0);
 	token_free_expr(&pars);
+	ctx_free(ctx);
 
 
 	printf("done\n\n");
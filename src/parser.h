@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "config.h"
+#include "context.h"
 #include "error.h"
 #include "lexer.h" // for test
 #include "log.h"
@@ -14,10 +15,11 @@
 #include "token.h"
 
 
-struct expr lexer_to_parser(const struct expr * e);
+// the tokens of `e` (moved in the result) converted for the parser
+struct expr lexer_to_parser(struct calc_ctx * ctx, struct expr * e);
 
 // return 1 if syntax is fine, 1 othewise
-int parser_check_syntax(const struct expr e);
+int parser_check_syntax(struct calc_ctx * ctx, const struct expr e);
 
 
 void test_parser();
@@ -0,0 +1,491 @@
+#include "program.h"
+
+
+typedef void (bin_op)(struct number * n1, struct number * n2);
+
+
+static int is_last(const struct token * t) {
+	return ((t->len == (int) strlen(CONSOLE_LAST)) && (strncmp(t->str, CONSOLE_LAST, t->len) == 0));
+}
+
+// the error of `ctx` pointing in `from` (`len` bytes) points in `to` instead, a copy of it
+static void move_error(struct calc_ctx * ctx, const char * from, const char * to, size_t len) {
+	const struct error_state * e = &ctx->error;
+	const char * character = e->character;
+	const char * word = e->word;
+	if ((character >= from) && (character <= from + len)) {
+		character = to + (character - from);
+	}
+	if ((word >= from) && (word <= from + len)) {
+		word = to + (word - from);
+	}
+	ctx_error_set(ctx, e->type, character, word, e->length);
+}
+
+// instructions and literals of the RPN of `p->e`, checked against the limit of the size of the results
+// return 0, -1 on error (set)
+static int compile_rpn(struct calc_ctx * ctx, struct program * p, const struct stack * rpn) {
+
+	int size = stack_size(rpn);
+	int consts = 0;
+	for (int i = 0; i < size; i++) {
+		const struct token t = token_get(&p->e, *(int *) stack_get(rpn, i));
+		if (t.type == NUM_OPERAND) {
+			consts++;
+		}
+		else if (t.type == VAR_OPERAND) {
+			consts += !is_last(&t);
+			p->names += is_last(&t);
+		}
+	}
+	p->code   = alloc_malloc(sizeof(struct instr) * (size + 1));
+	p->consts = alloc_malloc(sizeof(struct number) * (consts > 0 ? consts : 1));
+	struct estimate * est = alloc_malloc(sizeof(struct estimate) * size);
+	if ((p->code == NULL) || (p->consts == NULL) || (est == NULL)) {
+		alloc_free(est);
+		return -1;
+	}
+
+	// the value of `CONSOLE_LAST` changes, the results are checked at each run
+	int too_big = estimate_rpn(ctx, &p->e, rpn, est, ctx->config.max_size);
+	if ((too_big >= 0) && (p->names == 0)) {
+		ctx_error_set(ctx, TOO_BIG, token_get(&p->e, *(int *) stack_get(rpn, too_big)).str, NULL, 0);
+	}
+	if (ctx_error(ctx)) {
+		alloc_free(est);
+		return -1;
+	}
+
+	int depth = 0;
+	for (int i = size - 1; i >= 0; i--) { // the top of the stack is evaluated first
+		int index = *(int *) stack_get(rpn, i);
+		const struct token t = token_get(&p->e, index);
+		struct instr * ins = &p->code[p->len];
+		ins->token = index;
+		switch (t.type) {
+
+			case NUM_OPERAND:
+				p->consts[p->nconst] = eval_literal(ctx, &p->e, index, &est[i]);
+				if (ctx_error(ctx)) {
+					number_free(p->consts[p->nconst]);
+					break;
+				}
+				p->nconst++;
+				ins->op = OP_CONST;
+				depth++;
+				break;
+
+			case VAR_OPERAND:
+				if (is_last(&t)) {
+					ins->op = OP_NAME;
+				}
+				else if (ctx_take_name(ctx, t.str, t.len, &p->consts[p->nconst])) { // a streamed literal
+					p->nconst++;
+					ins->op = OP_CONST;
+				}
+				else {
+					ctx_error_set(ctx, UNMANAGED, NULL, t.str, t.len);
+					break;
+				}
+				depth++;
+				break;
+
+			case PLUS:     ins->op = OP_ADD; depth--; break;
+			case MINUS:    ins->op = OP_SUB; depth--; break;
+			case ASTERISK: ins->op = OP_MUL; depth--; break;
+			case POW:      ins->op = OP_POW; depth--; break;
+			case UNARY_MINUS: ins->op = OP_NEG; break;
+			case UNARY_PLUS:  continue; // nothing to do
+
+			default: // function
+				ctx_error_set(ctx, UNMANAGED, NULL, t.str, t.len);
+				break;
+		}
+		if (ctx_error(ctx)) {
+			alloc_free(est);
+			return -1;
+		}
+		p->len++;
+		p->depth = (depth > p->depth ? depth : p->depth);
+	}
+	alloc_free(est);
+	assert(depth == 1);
+
+	p->code[p->len].op    = OP_END;
+	p->code[p->len].token = 0;
+	p->operands = alloc_malloc(sizeof(struct number) * p->depth);
+	return (p->operands != NULL ? 0 : -1);
+}
+
+struct program * program_compile(struct calc_ctx * ctx, const char * str, size_t len) {
+
+	ctx_error_reset(ctx);
+	ctx->alloc.budget = ctx->config.eval_budget;
+	ctx->alloc.used   = 0;
+	ctx_bind(ctx); // the literals are converted as in an evaluation
+	cancel_begin(ctx->config.timeout);
+
+	struct program * p = alloc_malloc(sizeof(struct program));
+	char * src = (p != NULL ? alloc_malloc(len + 1) : NULL);
+	int res = -1;
+	if (p != NULL) {
+		memset(p, 0, sizeof(struct program));
+		p->src = src;
+	}
+	if (src != NULL) {
+		memcpy(src, str, len); // the lexer stops on the NUL
+		src[len] = '\0';
+	}
+	if ((src != NULL) && (eval_parse(ctx, src, &p->e) > 0)) {
+		struct stack * rpn = shunting_yard(ctx, &p->e);
+		if (rpn != NULL) {
+			res = compile_rpn(ctx, p, rpn);
+			stack_free(rpn);
+		}
+	}
+
+	cancel_end();
+	ctx_bind(NULL);
+	if (res < 0) {
+		if (ctx_error(ctx) && (src != NULL)) {
+			move_error(ctx, src, str, len);
+		}
+		if (p != NULL) {
+			program_free(p);
+		}
+		return NULL;
+	}
+	log_info("program of %d instructions, %d literals, %d operands", p->len, p->nconst, p->depth);
+	return p;
+}
+
+
+// log2 of the absolute value (about), -1 for 0
+static double log2_abs(const struct number * num) {
+	unsigned char small[sizeof(long)];
+	const unsigned char * bytes;
+	int len;
+	number_bytes(num, small, &bytes, &len);
+	if (bytes[len - 1] == 0) {
+		return -1;
+	}
+	return 8.0 * (len - 1) + log2(bytes[len - 1]);
+}
+
+// the result of `op` on `n1` and `n2` would be over the limit of `ctx` (as `estimate_rpn`)
+static int over_limit(const struct calc_ctx * ctx, enum opcode op, const struct number * n1, const struct number * n2) {
+	if (ctx->config.max_size == 0) {
+		return 0;
+	}
+	double bits = 0;
+	if (op == OP_MUL) {
+		bits = log2_abs(n1) + log2_abs(n2) + 2;
+	}
+	else if ((op == OP_POW) && (n2->type == INTEGER) && (n2->data.integer > 0) && (log2_abs(n1) > 0)) {
+		bits = n2->data.integer * log2_abs(n1) + 1;
+	}
+	return (bits > 8 * (double) ctx->config.max_size);
+}
+
+// `n1` `op` `n2` in `n1` (the fast cases are done by `program_run`), then `n2` is freed
+// return -1 on error (it points on the operator)
+static int binary(struct calc_ctx * ctx, const struct program * p, const struct instr * pc, struct number * n1, struct number * n2, bin_op operation) {
+	if (over_limit(ctx, pc->op, n1, n2)) {
+		ctx_error_set(ctx, TOO_BIG, NULL, NULL, 0);
+	}
+	else {
+		operation(n1, n2);
+	}
+	number_free(*n2);
+	if (ctx_error(ctx)) {
+		ctx_error_set(ctx, ctx_error(ctx), token_get(&p->e, pc->token).str, NULL, 0);
+		return -1;
+	}
+	return 0;
+}
+
+static int interpret(struct calc_ctx * ctx, struct program * p, struct number * result) {
+
+	static const void * const ops[] = {
+		[OP_CONST] = &&op_const,
+		[OP_NAME]  = &&op_name,
+		[OP_ADD]   = &&op_add,
+		[OP_SUB]   = &&op_sub,
+		[OP_MUL]   = &&op_mul,
+		[OP_POW]   = &&op_pow,
+		[OP_NEG]   = &&op_neg,
+		[OP_END]   = &&op_end,
+	};
+	#define DISPATCH() goto *ops[pc->op]
+	#define NEXT() pc++; DISPATCH()
+
+	const struct instr * pc = p->code;
+	const struct number * k = p->consts;
+	struct number * top = p->operands - 1;
+	long res;
+	DISPATCH();
+
+	op_const:
+		*++top = number_dup(k);
+		if ((k++->type == BIG) && ctx_error(ctx)) {
+			goto fail;
+		}
+		NEXT();
+
+	op_name: {
+		const struct token t = token_get(&p->e, pc->token);
+		if (!ctx_take_name(ctx, t.str, t.len, ++top)) {
+			top--;
+			ctx_error_set(ctx, UNMANAGED, NULL, t.str, t.len);
+			goto fail;
+		}
+		if (ctx_error(ctx)) {
+			ctx_error_set(ctx, ctx_error(ctx), NULL, t.str, t.len);
+			goto fail;
+		}
+		NEXT();
+	}
+
+	op_add:
+		if ((top[-1].type == INTEGER) && (top->type == INTEGER) && !__builtin_saddl_overflow(top[-1].data.integer, top->data.integer, &res)) {
+			(--top)->data.integer = res;
+			NEXT();
+		}
+		top--;
+		if (binary(ctx, p, pc, top, top + 1, number_add) < 0) {
+			goto fail;
+		}
+		NEXT();
+
+	op_sub:
+		if ((top[-1].type == INTEGER) && (top->type == INTEGER) && !__builtin_ssubl_overflow(top[-1].data.integer, top->data.integer, &res)) {
+			(--top)->data.integer = res;
+			NEXT();
+		}
+		top--;
+		if (binary(ctx, p, pc, top, top + 1, number_sub) < 0) {
+			goto fail;
+		}
+		NEXT();
+
+	op_mul:
+		if ((top[-1].type == INTEGER) && (top->type == INTEGER) && !__builtin_smull_overflow(top[-1].data.integer, top->data.integer, &res)) {
+			(--top)->data.integer = res;
+			NEXT();
+		}
+		top--;
+		if (binary(ctx, p, pc, top, top + 1, number_mul) < 0) {
+			goto fail;
+		}
+		NEXT();
+
+	op_pow:
+		top--;
+		if (binary(ctx, p, pc, top, top + 1, number_pow) < 0) {
+			goto fail;
+		}
+		NEXT();
+
+	op_neg:
+		if ((top->type == INTEGER) && (top->data.integer != LONG_MIN)) {
+			top->data.integer = -top->data.integer;
+			NEXT();
+		}
+		number_neg(top);
+		if (ctx_error(ctx)) {
+			ctx_error_set(ctx, ctx_error(ctx), token_get(&p->e, pc->token).str, NULL, 0);
+			goto fail;
+		}
+		NEXT();
+
+	op_end:
+		assert(top == p->operands);
+		*result = *top;
+		return 1;
+
+	fail:
+		for (; top >= p->operands; top--) {
+			number_free(*top);
+		}
+		return -1;
+
+	#undef NEXT
+	#undef DISPATCH
+}
+
+int program_run(struct calc_ctx * ctx, struct program * p, struct number * result) {
+
+	ctx_error_reset(ctx);
+	ctx->alloc.budget = ctx->config.eval_budget;
+	ctx->alloc.used   = 0;
+	ctx_bind(ctx); // for the number layer
+	cancel_begin(ctx->config.timeout);
+	progress_begin();
+
+	int res = interpret(ctx, p, result);
+
+	progress_end();
+	cancel_end();
+	ctx_bind(NULL);
+	return res;
+}
+
+void program_free(struct program * p) {
+	for (int i = 0; i < p->nconst; i++) {
+		number_free(p->consts[i]);
+	}
+	token_free_expr(&p->e);
+	alloc_free(p->consts);
+	alloc_free(p->code);
+	alloc_free(p->operands);
+	alloc_free(p->src);
+	LOG_FREE(p);
+	alloc_free(p);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+// compile and run `str` once, the result in `*result`
+static int run_str(struct calc_ctx * ctx, const char * str, struct number * result) {
+	struct program * p = program_compile(ctx, str, strlen(str));
+	if (p == NULL) {
+		return -1;
+	}
+	int res = program_run(ctx, p, result);
+	program_free(p);
+	return res;
+}
+
+static int run_equals(struct calc_ctx * ctx, const char * str) {
+	struct number expected;
+	struct number result;
+	assert(eval_str(ctx, str, &expected) == 1);
+	assert(run_str(ctx, str, &result) == 1);
+	unsigned char s1[sizeof(long)];
+	unsigned char s2[sizeof(long)];
+	const unsigned char * b1;
+	const unsigned char * b2;
+	int l1;
+	int l2;
+	int n1 = number_bytes(&expected, s1, &b1, &l1);
+	int n2 = number_bytes(&result, s2, &b2, &l2);
+	int equal = ((n1 == n2) && (l1 == l2) && (memcmp(b1, b2, l1) == 0));
+	number_free(expected);
+	number_free(result);
+	return equal;
+}
+
+void test_program() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("PROGRAM:\n");
+	struct calc_ctx * ctx = ctx_new();
+	assert(ctx != NULL);
+	struct number result;
+
+
+	printf(" compile\n");
+	const char * str = "1 + 2 garbage";
+	struct program * p = program_compile(ctx, str, 5); // no NUL after "1 + 2"
+	assert(p != NULL);
+	assert((p->len == 3) && (p->nconst == 2) && (p->depth == 2) && (p->names == 0));
+	assert((p->code[0].op == OP_CONST) && (p->code[2].op == OP_ADD) && (p->code[3].op == OP_END));
+	program_free(p);
+
+	p = program_compile(ctx, "+-+(4)", 6);
+	assert((p != NULL) && (p->len == 2) && (p->code[1].op == OP_NEG)); // no instruction for `+`
+	program_free(p);
+
+	assert(program_compile(ctx, "  ", 2) == NULL);
+	assert(!ctx_error(ctx));
+
+
+	printf(" run\n");
+	assert(run_equals(ctx, "34 * (2 + 3) - 18"));
+	assert(run_equals(ctx, "-(2 ^ 64) + 3 * 0x10"));
+	assert(run_equals(ctx, "9223372036854775807 + 1 - 1")); // out of a long and back
+	assert(run_equals(ctx, "-9223372036854775807 - 1 - 0 * -(-9223372036854775807 - 1)"));
+	assert(run_equals(ctx, "5x132 ^ 2x101010 - 123456789012345678901234567890 * 1e30"));
+
+	p = program_compile(ctx, "2 ^ 100 - 3 * 7", 15);
+	assert(p != NULL);
+	assert(program_run(ctx, p, &result) == 1);
+	struct number again;
+	assert(program_run(ctx, p, &again) == 1); // the literals are still there
+	assert(big_int_cmp(result.data.big, again.data.big) == 0);
+	number_free(result);
+	number_free(again);
+	program_free(p);
+
+
+	printf(" names\n");
+	struct number last = str_to_number(1, "5");
+	ctx->last = &last;
+	p = program_compile(ctx, CONSOLE_LAST " * 3 + 1", 9);
+	assert((p != NULL) && (p->names == 1));
+	for (int i = 0; i < 3; i++) { // 16, 49, 148
+		assert(program_run(ctx, p, &result) == 1);
+		last = result;
+	}
+	assert((last.type == INTEGER) && (last.data.integer == 148));
+	program_free(p);
+
+	p = program_compile(ctx, CONSOLE_LAST " ^ 2", 5); // over the limit from the second run
+	assert(p != NULL);
+	ctx->config.max_size = 2;
+	assert(program_run(ctx, p, &result) == 1);
+	assert(big_to_long(result.data.big) == 148 * 148); // a power is a big_int
+	last = result;
+	assert((program_run(ctx, p, &result) == -1) && (ctx_error(ctx) == TOO_BIG));
+	assert(ctx->error.character == p->src + 2);
+	ctx->config.max_size = ESTIMATE_MAX_SIZE;
+	program_free(p);
+	ctx->last = NULL;
+	number_free(last);
+
+	assert(ctx_add_literal(ctx, str_to_number(20, "18446744073709551616")) == 0); // a streamed literal
+	p = program_compile(ctx, STREAM_NAME "0 - 1", 6);
+	assert((p != NULL) && (p->nconst == 2));
+	assert(program_run(ctx, p, &result) == 1);
+	assert((result.type == BIG) && (big_int_length(result.data.big) == 8));
+	number_free(result);
+	assert(program_run(ctx, p, &result) == 1); // still there
+	number_free(result);
+	program_free(p);
+	ctx_free_literals(ctx);
+
+
+	printf(" errors\n");
+	str = "1 + 2 # 3";
+	assert(program_compile(ctx, str, 9) == NULL);
+	assert((ctx_error(ctx) == UNKNOWN_SYM) && (ctx->error.character == str + 6)); // in `str`
+	str = "4 + " CONSOLE_LAST;
+	p = program_compile(ctx, str, 5); // looked up at the run
+	assert(p != NULL);
+	assert((program_run(ctx, p, &result) == -1) && (ctx_error(ctx) == UNMANAGED));
+	assert(ctx->error.word == p->src + 4);
+	program_free(p);
+	str = "1 + 2 ^ (2 ^ 40)";
+	assert((program_compile(ctx, str, 16) == NULL) && (ctx_error(ctx) == TOO_BIG));
+	assert(ctx->error.character == str + 6); // the outer `^`
+
+	p = program_compile(ctx, "3 + 2 ^ -1 * 99999999999999999999999", 36); // with operands on the stack
+	assert(p != NULL);
+	assert((program_run(ctx, p, &result) == -1) && (ctx_error(ctx) == POW_NEG));
+	assert(ctx->error.character == p->src + 6);
+	assert(program_run(ctx, p, &result) == -1);
+	program_free(p);
+
+
+	ctx_free(ctx);
+	printf("done\n\n");
+	#endif
+}
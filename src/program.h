@@ -0,0 +1,84 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "cancel.h"
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "estimate.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+#include "progress.h"
+#include "shunting_yard.h"
+#include "stack.h"
+#include "token.h"
+
+
+/*
+	Prepared expressions
+
+`program_compile` runs the lexer, the parser and `shunting_yard` once, and turns
+the RPN into an array of instructions: an opcode and the index of its token (where
+its errors point). The literals are converted at compile time, in the order of
+the run. `program_run` evaluates the instructions with a threaded interpreter
+(computed goto) on an array of operands allocated at compile time, the text is
+never read again and the small integers never leave the array.
+
+The name `CONSOLE_LAST` is looked up at each run, so `_ * 3 + 1` gives a new
+result each time. The streamed literals (see stream.h) are taken at compile
+time, as the other literals. A program is run by one thread at a time.
+*/
+
+
+enum opcode {
+	OP_CONST, // push the next literal
+	OP_NAME,  // push the value of `CONSOLE_LAST`
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_POW,
+	OP_NEG,
+	OP_END,
+};
+
+struct instr {
+	uint32_t op;
+	uint32_t token; // in `e`
+};
+
+struct program {
+	char * src;       // copy of the expression, the tokens point in it
+	struct expr e;
+	struct instr * code; // ends by `OP_END`
+	int len;
+	struct number * consts; // the literals, in the order of the `OP_CONST`
+	int nconst;
+	int names;        // `OP_NAME` instructions
+	struct number * operands; // `depth` of them
+	int depth;
+};
+
+
+// compile the `len` bytes of `str` (no NUL needed)
+// return NULL on error (it points in `str`) or if there is no expression (no error)
+struct program * program_compile(struct calc_ctx * ctx, const char * str, size_t len);
+
+// evaluate `p` in `result`, with the configuration of `ctx` and its value of `CONSOLE_LAST`
+// return 1 on success, -1 on error (it points in `p->src`)
+int program_run(struct calc_ctx * ctx, struct program * p, struct number * result);
+
+void program_free(struct program * p);
+
+
+void test_program();
+
+
+#endif // PROGRAM_H
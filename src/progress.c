@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, fileno
+#include "progress.h"
+
+#include <unistd.h>
+
+
+static FILE * out = NULL;
+static int status_line = 0; // `out` is a terminal
+
+// state of the evaluation of the thread
+static __thread double start; // of the evaluation
+static __thread double last;  // last written line
+
+static __thread struct {
+	const char * what;
+	long done;
+	long total;
+} step;
+
+
+static double now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+void progress_set_output(FILE * fp) {
+	out = fp;
+	status_line = ((fp != NULL) && isatty(fileno(fp)));
+}
+
+void progress_begin() {
+	if (out == NULL) {
+		return;
+	}
+	start = now();
+	last  = start;
+	step.what = NULL;
+}
+
+void progress_end() {
+	if ((out == NULL) || (last == start)) { // nothing written
+		return;
+	}
+	if (status_line) {
+		fprintf(out, "\r\033[K"); // clear the status line
+	}
+	fprintf(out, "progress: done in %.1f s\n", now() - start);
+	fflush(out);
+}
+
+
+void progress_step(const char * what, long done, long total) {
+	step.what  = what;
+	step.done  = done;
+	step.total = total;
+	progress_report(NULL, 0, 0);
+}
+
+void progress_report(const char * what, long done, long total) {
+	if (out == NULL) {
+		return;
+	}
+	double t = now();
+	if (t - last < PROGRESS_INTERVAL) {
+		return;
+	}
+	last = t;
+
+	if (status_line) {
+		fprintf(out, "\r\033[K");
+	}
+	fprintf(out, "progress: %.1f s", t - start);
+	if (step.what != NULL) {
+		fprintf(out, " | %s %ld/%ld", step.what, step.done, step.total);
+	}
+	if ((what != NULL) && (total > 0)) {
+		fprintf(out, " | %s %.0f%%", what, (100.0 * done) / total);
+	}
+	fprintf(out, (status_line ? "" : "\n"));
+	fflush(out);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+void test_progress() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("PROGRESS:\n");
+
+
+	printf(" no output\n");
+	progress_set_output(NULL);
+	progress_begin();
+	progress_report("mul", 1, 2);
+	for (long i = 0; i < 2 * CANCEL_BLOCK; i++) {
+		if (i > 0)
+			PROGRESS_POINT("mul", i, 2 * CANCEL_BLOCK); // one statement
+		else
+			progress_report("mul", i, 2 * CANCEL_BLOCK);
+	}
+	progress_end();
+
+
+	printf(" rate limit\n");
+	FILE * fp = tmpfile();
+	assert(fp != NULL);
+	progress_set_output(fp);
+	progress_begin();
+	progress_step("pow bit", 3, 10);
+	progress_report("mul", 1, 4);
+	assert(ftell(fp) == 0); // too soon
+	struct timespec wait = {0, (long) (PROGRESS_INTERVAL * 1.1e9)};
+	nanosleep(&wait, NULL);
+	progress_report("mul", 1, 4);
+	progress_end();
+
+	char line[128];
+	rewind(fp);
+	assert(fgets(line, sizeof(line), fp) != NULL);
+	assert(strstr(line, "pow bit 3/10 | mul 25%") != NULL);
+	assert(fgets(line, sizeof(line), fp) != NULL);
+	assert(strstr(line, "done") != NULL);
+	fclose(fp);
+	progress_set_output(NULL);
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,50 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "log.h"
+
+
+/*
+	Progress of a long evaluation
+
+The kernels report their completion at the same points as the cancellation
+checks (see cancel.h), `big_int_pow` reports its position in the exponent.
+The line is written at most every `PROGRESS_INTERVAL` seconds, as a status
+line on a terminal (one line per report otherwise). Without output, a report
+costs a test.
+*/
+
+// report point for the loop counter `i` of a kernel
+#define PROGRESS_POINT(what, i, n) do {								\
+	if ((((i) % CANCEL_BLOCK) == 0)) {								\
+		progress_report((what), (i), (n));							\
+	}																\
+} while (0)
+
+
+// NULL disables the progress
+void progress_set_output(FILE * fp);
+
+// around an evaluation
+void progress_begin();
+
+void progress_end();
+
+
+// step of the whole operation (like the bits of an exponent), `what` NULL clears it
+void progress_step(const char * what, long done, long total);
+
+// completion of the current kernel
+void progress_report(const char * what, long done, long total);
+
+
+void test_progress();
+
+
+#endif // PROGRESS_H
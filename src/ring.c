@@ -0,0 +1,410 @@
+#define _GNU_SOURCE // syscall
+#include "ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+#define RING_MAGIC 0x636c6372 // "rclc"
+
+// at the start of the shared object, then the slots
+struct ring_header {
+	uint32_t magic;
+	uint32_t slots;
+	uint32_t slot_size;
+	uint32_t stop;
+
+	// written by the client
+	uint32_t submitted __attribute__((aligned(64)));
+	uint32_t client_sleeps;
+	uint32_t evaluator_bell; // futex of the evaluator (rung by the client or `ring_stop`)
+
+	// written by the evaluator
+	uint32_t completed __attribute__((aligned(64)));
+	uint32_t evaluator_sleeps;
+	uint32_t client_bell; // futex of the client
+};
+
+struct ring {
+	struct ring_header * h;
+	char * base;  // of the slots
+	size_t size;  // of the mapping
+	char * name;  // to remove the object, if created
+	uint32_t slots;     // copies of the header, the other side can't change them
+	uint32_t slot_size;
+	uint32_t released; // client side
+};
+
+
+static void futex_wait(uint32_t * word, uint32_t value) {
+	syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0); // shared, not FUTEX_PRIVATE
+}
+
+static void futex_wake(uint32_t * word) {
+	syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// wake up the other side if it sleeps (after the store of what it waits for)
+static void ring_bell(uint32_t * sleeps, uint32_t * bell) {
+	if (__atomic_load_n(sleeps, __ATOMIC_SEQ_CST)) {
+		__atomic_add_fetch(bell, 1, __ATOMIC_SEQ_CST);
+		futex_wake(bell);
+	}
+}
+
+// sleep until `*word` isn't `value` any more (or the bell rings)
+static void ring_sleep(uint32_t * sleeps, uint32_t * bell, const uint32_t * word, uint32_t value) {
+	for (int i = 0; i < RING_SPIN; i++) {
+		if (__atomic_load_n(word, __ATOMIC_ACQUIRE) != value) {
+			return;
+		}
+	}
+	uint32_t ring = __atomic_load_n(bell, __ATOMIC_SEQ_CST);
+	__atomic_store_n(sleeps, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(word, __ATOMIC_SEQ_CST) == value) { // the other side sees `sleeps` from now
+		futex_wait(bell, ring);
+	}
+	__atomic_store_n(sleeps, 0, __ATOMIC_RELAXED);
+}
+
+static struct ring_slot * slot(const struct ring * r, uint32_t i) {
+	return (struct ring_slot *) (r->base + (size_t) (i % r->slots) * r->slot_size);
+}
+
+static int slot_cap(const struct ring * r) {
+	return r->slot_size - sizeof(struct ring_slot);
+}
+
+static struct ring * ring_map(int fd, size_t size) {
+
+	void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		log_warn("ring: mmap: %s", strerror(errno));
+		return NULL;
+	}
+	struct ring * r = alloc_malloc(sizeof(struct ring));
+	log_trace("malloc %p: ring", r);
+	if (r == NULL) {
+		munmap(map, size);
+		return NULL;
+	}
+	r->h     = map;
+	r->base  = (char *) map + sizeof(struct ring_header);
+	r->size  = size;
+	r->name  = NULL;
+	r->slots = 0;
+	r->slot_size = 0;
+	r->released  = 0;
+	return r;
+}
+
+
+
+/*
+	EVALUATOR
+*/
+
+static struct ring * caught = NULL; // of `ring_catch_signals`
+
+
+struct ring * ring_create(const char * name, int slots, int slot_size) {
+
+	slot_size = (slot_size + 7) & ~7; // aligned slots
+	if ((slots <= 0) || (slot_size <= (int) sizeof(struct ring_slot))) {
+		log_warn("ring: wrong size %d x %d", slots, slot_size);
+		return NULL;
+	}
+	size_t size = sizeof(struct ring_header) + (size_t) slots * slot_size;
+
+	shm_unlink(name); // left by a previous evaluator
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if ((fd < 0) || (ftruncate(fd, size) < 0)) {
+		log_warn("ring: can't create '%s': %s", name, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			shm_unlink(name);
+		}
+		return NULL;
+	}
+	struct ring * r = ring_map(fd, size);
+	char * copy = (r != NULL ? alloc_malloc(strlen(name) + 1) : NULL);
+	if (copy == NULL) {
+		if (r != NULL) {
+			ring_close(r);
+		}
+		shm_unlink(name);
+		return NULL;
+	}
+	r->name = strcpy(copy, name);
+
+	// the object is zeroed by `ftruncate`
+	r->h->slots     = r->slots     = slots;
+	r->h->slot_size = r->slot_size = slot_size;
+	__atomic_store_n(&r->h->magic, RING_MAGIC, __ATOMIC_RELEASE);
+	log_info("ring: '%s' of %d slots of %d bytes", name, slots, slot_size);
+	return r;
+}
+
+// evaluate the expression of the slot in place, then write its result over it
+static void ring_eval(struct calc_ctx * ctx, struct ring_slot * s, int cap) {
+
+	int len = s->len;
+	if ((len < 0) || (len >= cap)) { // the client writes what it wants in the slot
+		len = (len < 0 ? 0 : cap - 1);
+	}
+	s->data[len] = '\0';
+
+	struct number result;
+	int res = eval_str(ctx, s->data, &result);
+	s->status = res;
+	s->error  = ctx_error(ctx);
+	s->column = (res < 0 ? error_column(&ctx->error, s->data) : -1);
+	s->len    = 0;
+	if (res <= 0) {
+		return;
+	}
+
+	unsigned char small[sizeof(long)];
+	const unsigned char * bytes;
+	int n;
+	s->sign = (number_bytes(&result, small, &bytes, &n) ? -1 : 1);
+	if (n <= cap) {
+		memcpy(s->data, bytes, n);
+		s->len = n;
+	}
+	else {
+		s->status = -1;
+		s->error  = TOO_BIG;
+	}
+	number_free(result);
+}
+
+long ring_serve(struct ring * r) {
+
+	struct ring_header * h = r->h;
+	struct calc_ctx * ctx = ctx_new();
+	if (ctx == NULL) {
+		return -1;
+	}
+	uint32_t done = __atomic_load_n(&h->completed, __ATOMIC_RELAXED);
+	long count = 0;
+
+	while (!__atomic_load_n(&h->stop, __ATOMIC_ACQUIRE)) {
+		uint32_t submitted = __atomic_load_n(&h->submitted, __ATOMIC_ACQUIRE);
+		if (submitted == done) {
+			ring_sleep(&h->evaluator_sleeps, &h->evaluator_bell, &h->submitted, done);
+			continue;
+		}
+		for (; done != submitted; done++) {
+			ring_eval(ctx, slot(r, done), slot_cap(r));
+			__atomic_store_n(&h->completed, done + 1, __ATOMIC_SEQ_CST);
+			ring_bell(&h->client_sleeps, &h->client_bell);
+			count++;
+		}
+	}
+	ctx_free(ctx);
+	log_info("ring: %ld evaluations", count);
+	return count;
+}
+
+void ring_stop(struct ring * r) {
+	__atomic_store_n(&r->h->stop, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&r->h->evaluator_bell, 1, __ATOMIC_SEQ_CST);
+	futex_wake(&r->h->evaluator_bell);
+}
+
+static void stop_handler(int sig) {
+	ring_stop(caught);
+}
+
+void ring_catch_signals(struct ring * r) {
+	caught = r;
+	struct sigaction act;
+	act.sa_handler = stop_handler;
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = SA_RESTART;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+}
+
+
+
+/*
+	CLIENT
+*/
+
+struct ring * ring_attach(const char * name) {
+
+	int fd = shm_open(name, O_RDWR, 0);
+	struct stat st;
+	if ((fd < 0) || (fstat(fd, &st) < 0) || ((size_t) st.st_size < sizeof(struct ring_header))) {
+		log_warn("ring: can't open '%s': %s", name, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+		}
+		return NULL;
+	}
+	struct ring * r = ring_map(fd, st.st_size);
+	if (r == NULL) {
+		return NULL;
+	}
+	struct ring_header * h = r->h;
+	if ((__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != RING_MAGIC)
+		|| (h->slots == 0) || (h->slot_size <= sizeof(struct ring_slot))
+		|| (sizeof(struct ring_header) + (size_t) h->slots * h->slot_size > r->size)) {
+		log_warn("ring: '%s' isn't a ring", name);
+		ring_close(r);
+		return NULL;
+	}
+	r->slots     = h->slots;
+	r->slot_size = h->slot_size;
+	r->released  = __atomic_load_n(&h->completed, __ATOMIC_ACQUIRE);
+	return r;
+}
+
+struct ring_slot * ring_reserve(struct ring * r, int * cap) {
+	uint32_t submitted = r->h->submitted; // only written by this side
+	if (submitted - r->released >= r->slots) {
+		return NULL;
+	}
+	*cap = slot_cap(r) - 1; // room for a NUL
+	return slot(r, submitted);
+}
+
+void ring_submit(struct ring * r, int len) {
+	struct ring_header * h = r->h;
+	uint32_t submitted = h->submitted;
+	slot(r, submitted)->len = len;
+	__atomic_store_n(&h->submitted, submitted + 1, __ATOMIC_SEQ_CST);
+	ring_bell(&h->evaluator_sleeps, &h->evaluator_bell);
+}
+
+struct ring_slot * ring_wait(struct ring * r) {
+	struct ring_header * h = r->h;
+	if (h->submitted == r->released) { // nothing to wait for
+		return NULL;
+	}
+	while (__atomic_load_n(&h->completed, __ATOMIC_ACQUIRE) == r->released) {
+		ring_sleep(&h->client_sleeps, &h->client_bell, &h->completed, r->released);
+	}
+	return slot(r, r->released);
+}
+
+void ring_release(struct ring * r) {
+	r->released++;
+}
+
+
+void ring_close(struct ring * r) {
+	munmap(r->h, r->size);
+	if (r->name != NULL) {
+		shm_unlink(r->name);
+		LOG_FREE(r->name);
+		alloc_free(r->name);
+	}
+	LOG_FREE(r);
+	alloc_free(r);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+static void * serve(void * r) {
+	ring_serve(r);
+	return NULL;
+}
+
+// submit `expr` (waiting for a free slot)
+static void submit(struct ring * client, const char * expr) {
+	int cap;
+	struct ring_slot * s = ring_reserve(client, &cap);
+	assert(s != NULL);
+	int len = strlen(expr);
+	assert(len <= cap);
+	memcpy(s->data, expr, len); // no NUL
+	ring_submit(client, len);
+}
+
+void test_ring() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("RING:\n");
+	char name[64];
+	snprintf(name, sizeof(name), "/calcul-test-%d", (int) getpid());
+	struct ring * ring = ring_create(name, 4, 64);
+	assert(ring != NULL);
+	pthread_t thread;
+	assert(pthread_create(&thread, NULL, serve, ring) == 0);
+	struct ring * client = ring_attach(name);
+	assert(client != NULL);
+	struct ring_slot * s;
+	int cap;
+
+
+	printf(" results\n");
+	submit(client, "1 + 2");
+	submit(client, "-(2 ^ 64)");
+	submit(client, "   ");
+	s = ring_wait(client);
+	assert((s->status == 1) && (s->sign == 1) && (s->len == 1) && (s->data[0] == 3));
+	ring_release(client);
+	s = ring_wait(client);
+	assert((s->status == 1) && (s->sign == -1) && (s->len == 9) && (s->data[8] == 1));
+	ring_release(client);
+	s = ring_wait(client);
+	assert(s->status == 0);
+	ring_release(client);
+	assert(ring_wait(client) == NULL);
+
+
+	printf(" errors\n");
+	submit(client, "1 # 2");
+	submit(client, "2 ^ 400"); // 51 bytes, over the slot
+	s = ring_wait(client);
+	assert((s->status == -1) && (s->error == UNKNOWN_SYM) && (s->column == 2));
+	ring_release(client);
+	s = ring_wait(client);
+	assert((s->status == -1) && (s->error == TOO_BIG));
+	ring_release(client);
+
+
+	printf(" full ring\n");
+	for (int i = 0; i < 4; i++) {
+		submit(client, "6 * 7");
+	}
+	assert(ring_reserve(client, &cap) == NULL);
+	for (long i = 0; i < 1000; i++) { // keep the ring full
+		s = ring_wait(client);
+		assert((s->status == 1) && (s->len == 1) && (s->data[0] == 42));
+		ring_release(client);
+		submit(client, "6 * 7");
+	}
+
+
+	printf(" stop\n");
+	ring_stop(ring);
+	pthread_join(thread, NULL);
+	ring_close(client);
+	ring_close(ring);
+	assert(ring_attach(name) == NULL); // removed
+
+
+	printf("done\n\n");
+	#endif
+}
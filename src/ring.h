@@ -0,0 +1,85 @@
+#ifndef RING_H
+#define RING_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+
+
+/*
+	Shared-memory ring
+
+A client on the same host submits expressions without any syscall on the
+way: the ring is a POSIX shared memory object of `slots` slots, mapped by
+the evaluator (`ring_create`, `ring_serve`) and by one client (`ring_attach`).
+
+The client writes an expression in place in a free slot (`ring_reserve`),
+then publishes it (`ring_submit`). The evaluator lexes it in the slot and
+writes the bytes of the result over it. The client reads the results in
+order (`ring_wait`) and gives the slot back (`ring_release`).
+
+Each side sleeps on a futex when there is nothing to do, the other side
+only makes the syscall to wake it up when it does sleep.
+*/
+
+
+// a slot of the ring
+struct ring_slot {
+	int32_t len;    // bytes of the expression, then of the result
+	int32_t status; // 1 result, 0 no expression, -1 error (as `eval_str`)
+	int32_t sign;   // -1 or 1 for a result
+	int32_t error;  // `enum error_type`
+	int32_t column; // of the error in the expression, -1 if none
+	char data[];    // expression, then the bytes of the absolute value of the result (little endian)
+};
+
+struct ring;
+
+
+// create the shared object `name` (as `shm_open`) of `slots` slots of `slot_size` bytes
+// return NULL on failure
+struct ring * ring_create(const char * name, int slots, int slot_size);
+
+// evaluate the submitted expressions until `ring_stop`, return the number of evaluations
+long ring_serve(struct ring * r);
+
+// async-signal-safe
+void ring_stop(struct ring * r);
+
+// `ring_stop` on SIGINT and SIGTERM
+void ring_catch_signals(struct ring * r);
+
+
+// map the ring `name` created by an evaluator, return NULL on failure
+struct ring * ring_attach(const char * name);
+
+// a free slot to write an expression of at most `*cap` bytes in `data`
+// return NULL if every slot waits for `ring_release`
+struct ring_slot * ring_reserve(struct ring * r, int * cap);
+
+// publish the expression of `len` bytes of the reserved slot
+void ring_submit(struct ring * r, int len);
+
+// wait for the result of the oldest submitted expression
+struct ring_slot * ring_wait(struct ring * r);
+
+// give back the slot of `ring_wait`
+void ring_release(struct ring * r);
+
+
+// unmap the ring (and remove the shared object if created by `ring_create`)
+void ring_close(struct ring * r);
+
+
+void test_ring();
+
+
+#endif // RING_H
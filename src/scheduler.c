@@ -0,0 +1,313 @@
+#define _GNU_SOURCE // _SC_NPROCESSORS_ONLN
+#include "scheduler.h"
+
+#include <unistd.h>
+
+
+struct queue {
+	struct sched_job * head;
+	struct sched_job ** tail;
+	long depth;
+	long taken;
+	double wait_sum;
+	double wait_max;
+	long hist[SCHED_BUCKETS]; // taken jobs by wait, bucket i is under 2^i microseconds
+};
+
+struct worker {
+	struct sched * s;
+	enum sched_class class;
+	pthread_t thread;
+};
+
+struct sched {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	struct queue queue[2]; // by `enum sched_class`
+	long waiting_tiny;     // depth of the tiny queue, read by the checks of the kernels
+	int end;
+
+	sched_run run;
+	void * data;
+	int workers;
+	struct worker * worker;
+};
+
+
+static double now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// with the lock
+static void queue_append(struct sched * s, enum sched_class class, struct sched_job * head, struct sched_job ** tail) {
+	struct queue * q = &s->queue[class];
+	double t = now();
+	for (struct sched_job * job = head; job != NULL; job = job->next) {
+		job->queued = t;
+		q->depth++;
+	}
+	*q->tail = head;
+	q->tail  = tail;
+	if (class == SCHED_TINY) {
+		__atomic_store_n(&s->waiting_tiny, q->depth, __ATOMIC_RELAXED);
+	}
+	pthread_cond_broadcast(&s->work);
+}
+
+// with the lock
+static struct sched_job * queue_pop(struct sched * s, enum sched_class class) {
+	struct queue * q = &s->queue[class];
+	struct sched_job * job = q->head;
+	q->head = job->next;
+	if (q->head == NULL) {
+		q->tail = &q->head;
+	}
+	job->next = NULL;
+	q->depth--;
+	if (class == SCHED_TINY) {
+		__atomic_store_n(&s->waiting_tiny, q->depth, __ATOMIC_RELAXED);
+	}
+
+	double wait = now() - job->queued;
+	int bucket = 0;
+	while ((bucket < SCHED_BUCKETS - 1) && (wait * 1e6 >= (double) (1L << bucket))) {
+		bucket++;
+	}
+	q->hist[bucket]++;
+	q->taken++;
+	q->wait_sum += wait;
+	if (wait > q->wait_max) {
+		q->wait_max = wait;
+	}
+	return job;
+}
+
+static void * worker(void * arg) {
+	struct worker * w = arg;
+	struct sched * s  = w->s;
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "scheduler context");
+	if (w->class == SCHED_HUGE) {
+		cancel_yield_to(&s->waiting_tiny);
+	}
+
+	pthread_mutex_lock(&s->lock);
+	while (1) {
+		enum sched_class from;
+		if ((w->class == SCHED_HUGE) && (s->queue[SCHED_HUGE].head != NULL)) {
+			from = SCHED_HUGE;
+		}
+		else if (s->queue[SCHED_TINY].head != NULL) { // the huge workers help when idle
+			from = SCHED_TINY;
+		}
+		else if (s->end) {
+			break;
+		}
+		else {
+			pthread_cond_wait(&s->work, &s->lock);
+			continue;
+		}
+		if (s->end) { // the jobs left are given back by `sched_stop`
+			break;
+		}
+		struct sched_job * job = queue_pop(s, from);
+		pthread_mutex_unlock(&s->lock);
+
+		ctx->max_cost = (from == SCHED_TINY ? SCHED_TINY_COST : 0); // every job is classified by a tiny run
+		int deferred = s->run(ctx, job, s->data);
+
+		pthread_mutex_lock(&s->lock);
+		if (deferred) {
+			queue_append(s, SCHED_HUGE, job, &job->next);
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+	cancel_yield_to(NULL);
+	ctx_free(ctx);
+	return NULL;
+}
+
+
+struct sched * sched_start(int threads, sched_run run, void * data) {
+
+	if (threads <= 0) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	int huge = (threads / 4 > 1 ? threads / 4 : 1);
+	int tiny = (threads - huge > 1 ? threads - huge : 1);
+
+	struct sched * s = malloc(sizeof(struct sched));
+	CHECK_MALLOC(s, "scheduler");
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->work, NULL);
+	memset(s->queue, 0, sizeof(s->queue));
+	for (int i = 0; i < 2; i++) {
+		s->queue[i].tail = &s->queue[i].head;
+	}
+	s->waiting_tiny = 0;
+	s->end  = 0;
+	s->run  = run;
+	s->data = data;
+	s->workers = 0;
+
+	s->worker = malloc(sizeof(struct worker) * (tiny + huge));
+	CHECK_MALLOC(s->worker, "scheduler threads");
+	for (int i = 0; i < tiny + huge; i++) {
+		struct worker * w = &s->worker[s->workers];
+		w->s = s;
+		w->class = (i < tiny ? SCHED_TINY : SCHED_HUGE);
+		if (pthread_create(&w->thread, NULL, worker, w) != 0) {
+			log_warn("scheduler: only %d worker threads", s->workers);
+			break;
+		}
+		s->workers++;
+	}
+	log_info("scheduler: %d tiny and %d huge worker threads", tiny, huge);
+	return s;
+}
+
+void sched_push(struct sched * s, struct sched_job * head, struct sched_job ** tail) {
+	pthread_mutex_lock(&s->lock);
+	queue_append(s, SCHED_TINY, head, tail);
+	pthread_mutex_unlock(&s->lock);
+}
+
+void sched_stats(struct sched * s, struct sched_stats stats[2]) {
+
+	pthread_mutex_lock(&s->lock);
+	for (int i = 0; i < 2; i++) {
+		struct queue * q = &s->queue[i];
+		stats[i].depth    = q->depth;
+		stats[i].taken    = q->taken;
+		stats[i].wait_avg = (q->taken > 0 ? q->wait_sum / q->taken : 0);
+		stats[i].wait_max = q->wait_max;
+		stats[i].wait_p99 = 0;
+		long count = 0;
+		for (int b = 0; (b < SCHED_BUCKETS) && (q->taken > 0); b++) {
+			count += q->hist[b];
+			if (count * 100 >= q->taken * 99) {
+				stats[i].wait_p99 = (double) (1L << b) * 1e-6;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+void sched_fprint_stats(FILE * out, struct sched * s) {
+
+	struct sched_stats stats[2];
+	sched_stats(s, stats);
+	const char * name[2] = {"tiny", "huge"};
+	for (int i = 0; i < 2; i++) {
+		fprintf(out, "%s%s: depth %ld, taken %ld, wait avg %.0fus p99 %.0fus max %.0fus", (i > 0 ? "; " : ""), name[i],
+			stats[i].depth, stats[i].taken, stats[i].wait_avg * 1e6, stats[i].wait_p99 * 1e6, stats[i].wait_max * 1e6);
+	}
+}
+
+struct sched_job * sched_stop(struct sched * s) {
+
+	pthread_mutex_lock(&s->lock);
+	s->end = 1;
+	pthread_cond_broadcast(&s->work);
+	pthread_mutex_unlock(&s->lock);
+
+	for (int i = 0; i < s->workers; i++) {
+		pthread_join(s->worker[i].thread, NULL);
+	}
+	struct sched_job * left = s->queue[SCHED_TINY].head;
+	*s->queue[SCHED_TINY].tail = s->queue[SCHED_HUGE].head;
+
+	pthread_mutex_destroy(&s->lock);
+	pthread_cond_destroy(&s->work);
+	LOG_FREE(s->worker);
+	free(s->worker);
+	LOG_FREE(s);
+	free(s);
+	return left;
+}
+
+
+
+/*
+	TEST
+*/
+
+
+struct test_job {
+	struct sched_job job; // first
+	const char * line;
+	int res;
+	long rank; // of completion
+};
+
+static int test_run(struct calc_ctx * ctx, struct sched_job * job, void * data) {
+	struct test_job * t = (struct test_job *) job;
+	struct number result;
+	int res = eval_str(ctx, t->line, &result);
+	if ((res < 0) && (ctx->error.type == DEFERRED)) {
+		return 1;
+	}
+	if (res > 0) {
+		number_free(result);
+	}
+	long * count = data; // completed, then published
+	t->res  = res;
+	t->rank = __atomic_fetch_add(&count[0], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&count[1], 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+void test_scheduler() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("SCHEDULER:\n");
+
+
+	printf(" tiny jobs before the huge one\n");
+	long count[2] = {0, 0};
+	struct sched * s = sched_start(2, test_run, count);
+	int n = 101;
+	struct test_job jobs[101];
+	struct sched_job * head = NULL;
+	struct sched_job ** tail = &head;
+	for (int i = 0; i < n; i++) {
+		jobs[i].line = (i == 0 ? "3 ^ 30000" : "1 + 1"); // the huge job first
+		jobs[i].res  = 0;
+		jobs[i].rank = -1;
+		*tail = &jobs[i].job;
+		tail  = &jobs[i].job.next;
+	}
+	*tail = NULL;
+	sched_push(s, head, tail);
+	while (__atomic_load_n(&count[1], __ATOMIC_ACQUIRE) < n) {
+		struct timespec wait = {0, 1000 * 1000};
+		nanosleep(&wait, NULL);
+	}
+	for (int i = 0; i < n; i++) {
+		assert(jobs[i].res == 1);
+	}
+	assert(jobs[0].rank == n - 1);
+
+
+	printf(" stats\n");
+	struct sched_stats stats[2];
+	sched_stats(s, stats);
+	assert((stats[SCHED_TINY].depth == 0) && (stats[SCHED_HUGE].depth == 0));
+	assert(stats[SCHED_TINY].taken == n); // the huge job too, before its estimate
+	assert(stats[SCHED_HUGE].taken == 1);
+	assert(stats[SCHED_TINY].wait_avg <= stats[SCHED_TINY].wait_max);
+
+
+	printf(" stop\n");
+	assert(sched_stop(s) == NULL);
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,76 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cancel.h"
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+
+
+/*
+	Scheduler of the evaluations
+
+Two queues: the tiny jobs and the huge jobs, each one with its own workers.
+Every job starts in the tiny queue. A tiny worker evaluates with a maximum
+cost (`SCHED_TINY_COST`, on the estimate of `eval`), a job estimated longer
+stops with `DEFERRED` before any computation and moves to the huge queue.
+So a huge power never blocks the `1 + 1` behind it: the huge workers also
+yield the CPU at every check of the kernels while tiny jobs are waiting.
+
+The huge workers take tiny jobs when they have nothing else to do.
+*/
+
+
+enum sched_class {
+	SCHED_TINY,
+	SCHED_HUGE,
+};
+
+// the first member of a job of the caller
+struct sched_job {
+	struct sched_job * next;
+	double queued; // time of the push (seconds)
+};
+
+// run `job` with `ctx` (`ctx->max_cost` set by the scheduler)
+// return 1 if it stopped with `DEFERRED`, then it goes to the huge queue, 0 otherwise
+typedef int (* sched_run)(struct calc_ctx * ctx, struct sched_job * job, void * data);
+
+struct sched_stats {
+	long depth;  // jobs waiting in the queue
+	long taken;  // jobs taken by a worker
+	double wait_avg; // seconds waited in the queue
+	double wait_p99; // (upper bound)
+	double wait_max;
+};
+
+struct sched;
+
+
+// `threads` workers (0 is one per core), a quarter of them (at least one) for the huge jobs
+struct sched * sched_start(int threads, sched_run run, void * data);
+
+// append the list `head` ... `*tail` to the tiny queue
+void sched_push(struct sched * s, struct sched_job * head, struct sched_job ** tail);
+
+// statistics of the tiny and huge queues
+void sched_stats(struct sched * s, struct sched_stats stats[2]);
+
+// print the statistics on one line (without '\n')
+void sched_fprint_stats(FILE * out, struct sched * s);
+
+// wait for the running jobs, return the list of the jobs never run
+struct sched_job * sched_stop(struct sched * s);
+
+
+void test_scheduler();
+
+
+#endif // SCHEDULER_H
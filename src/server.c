@@ -0,0 +1,763 @@
+#define _GNU_SOURCE // accept4, SOCK_NONBLOCK, open_memstream, _SC_NPROCESSORS_ONLN
+#include "server.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// shared with `server_stop` (signal handler or another thread)
+static int stopping = 0;
+static int wake_fd  = -1; // eventfd of the loop: replies to send or stop, kept open for the next server
+
+
+// evaluate one line (NUL-terminated) and write its reply
+// return 1 without reply if deferred to a huge worker (see `scheduler.h`)
+static int server_reply(struct calc_ctx * ctx, const char * line, FILE * out) {
+
+	struct number result;
+	int res = eval_str(ctx, line, &result);
+
+	if ((res < 0) && (ctx->error.type == DEFERRED)) {
+		return 1;
+	}
+	if (res < 0) {
+		fprintf(out, "error %d: ", error_column(&ctx->error, line) + 1);
+		error_fprint(out, &ctx->error);
+	}
+	else if (res > 0) {
+		number_fprint(out, &result);
+		number_free(result);
+	}
+	fputc('\n', out);
+	return 0;
+}
+
+static void wake_loop() {
+	int fd = __atomic_load_n(&wake_fd, __ATOMIC_ACQUIRE);
+	if (fd >= 0) {
+		uint64_t one = 1;
+		ssize_t n = write(fd, &one, sizeof(one)); // async-signal-safe
+		(void) n; // the counter can't overflow
+	}
+}
+
+
+
+/*
+	WORKERS
+
+The loop gives the requests to the scheduler, the workers give back the
+replies in any order (with their rank in the connection) and wake up the loop.
+*/
+
+struct conn;
+
+struct request {
+	struct sched_job job; // first, the workers cast it back
+	struct conn * conn;
+	long seq;   // rank of the request in the connection
+	char * line;
+	char * reply;
+	size_t reply_len;
+	struct request * next;
+};
+
+struct workers {
+	pthread_mutex_t lock;
+	struct request * done;
+	struct sched * sched;
+};
+
+
+static void request_free(struct request * r) {
+	free(r->reply); // from `open_memstream`
+	LOG_FREE(r);
+	free(r);
+}
+
+static void request_free_list(struct request * r) {
+	while (r != NULL) {
+		struct request * next = r->next;
+		request_free(r);
+		r = next;
+	}
+}
+
+// `sched_run` of the requests
+static int worker_run(struct calc_ctx * ctx, struct sched_job * job, void * data) {
+	struct workers * w = data;
+	struct request * r = (struct request *) job;
+
+	FILE * out = open_memstream(&r->reply, &r->reply_len);
+	CHECK_MALLOC(out, "server reply");
+	int deferred = 0;
+	if (strcmp(r->line, SERVER_STATS) == 0) {
+		sched_fprint_stats(out, w->sched);
+		fputc('\n', out);
+	}
+	else {
+		deferred = server_reply(ctx, r->line, out);
+	}
+	fclose(out);
+	if (deferred) { // evaluated again by a huge worker
+		free(r->reply);
+		r->reply = NULL;
+		return 1;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	r->next = w->done;
+	w->done = r;
+	pthread_mutex_unlock(&w->lock);
+	wake_loop();
+	return 0;
+}
+
+// append the list `head` ... `*tail` to the requests to evaluate
+static void workers_push(struct workers * w, struct request * head) {
+	struct sched_job * first = NULL;
+	struct sched_job ** tail = &first;
+	for (struct request * r = head; r != NULL; r = r->next) {
+		*tail = &r->job;
+		tail  = &r->job.next;
+	}
+	*tail = NULL;
+	sched_push(w->sched, first, tail);
+}
+
+// return the replies evaluated so far
+static struct request * workers_take(struct workers * w) {
+	pthread_mutex_lock(&w->lock);
+	struct request * done = w->done;
+	w->done = NULL;
+	pthread_mutex_unlock(&w->lock);
+	return done;
+}
+
+static struct workers * workers_start(int threads) {
+
+	struct workers * w = malloc(sizeof(struct workers));
+	CHECK_MALLOC(w, "server workers");
+	pthread_mutex_init(&w->lock, NULL);
+	w->done  = NULL;
+	w->sched = sched_start(threads, worker_run, w);
+	return w;
+}
+
+static void workers_stop(struct workers * w) {
+
+	struct sched_job * left = sched_stop(w->sched); // the requests left are dropped
+	while (left != NULL) {
+		struct sched_job * next = left->next;
+		request_free((struct request *) left);
+		left = next;
+	}
+	request_free_list(w->done);
+	pthread_mutex_destroy(&w->lock);
+	LOG_FREE(w);
+	free(w);
+}
+
+
+
+/*
+	CONNECTIONS
+
+The input of a connection is cut in lines, up to `SERVER_PIPELINE` requests
+are at the workers or waiting for the previous replies. The replies are put
+back in order in `out` and sent as the socket accepts them.
+*/
+
+enum source {
+	LISTENER,
+	WAKE,
+	CLIENT,
+};
+
+// what the loop gets from epoll
+struct endpoint {
+	enum source kind;
+	int fd;
+};
+
+struct conn {
+	struct endpoint ep; // first, the loop casts it back
+	char * in;
+	size_t in_len;
+	size_t in_cap;
+	size_t scan; // bytes of `in` without '\n'
+	char * out;
+	size_t out_len;
+	size_t out_off; // bytes of `out` already sent
+	size_t out_cap;
+
+	struct request * ready[SERVER_PIPELINE]; // replies by rank % SERVER_PIPELINE
+	long seq;     // rank of the next request
+	long written; // rank of the next reply to put in `out`
+	long pending; // requests at the workers
+	int eof;      // nothing more to read
+	int broken;   // nothing more to send
+	uint32_t events; // registered in epoll
+	struct conn * next;
+};
+
+struct loop {
+	int epoll;
+	struct endpoint wake;
+	struct endpoint listener[2];
+	int listeners;
+	struct workers * workers;
+	struct conn * conns;
+	int closed; // connections closed but still in `conns`
+};
+
+
+static struct conn * conn_new(int fd) {
+
+	struct conn * c = malloc(sizeof(struct conn));
+	CHECK_MALLOC(c, "server connection");
+	c->ep.kind = CLIENT;
+	c->ep.fd   = fd;
+	c->in      = NULL;
+	c->in_len  = 0;
+	c->in_cap  = 0;
+	c->scan    = 0;
+	c->out     = NULL;
+	c->out_len = 0;
+	c->out_off = 0;
+	c->out_cap = 0;
+	memset(c->ready, 0, sizeof(c->ready));
+	c->seq     = 0;
+	c->written = 0;
+	c->pending = 0;
+	c->eof     = 0;
+	c->broken  = 0;
+	c->events  = 0;
+	c->next    = NULL;
+	return c;
+}
+
+static void conn_free(struct conn * c) {
+	for (int i = 0; i < SERVER_PIPELINE; i++) {
+		if (c->ready[i] != NULL) {
+			request_free(c->ready[i]);
+		}
+	}
+	LOG_FREE(c->in);
+	free(c->in);
+	LOG_FREE(c->out);
+	free(c->out);
+	LOG_FREE(c);
+	free(c);
+}
+
+// one read (the loop is level-triggered), so a connection can't starve the others
+static void conn_read(struct conn * c) {
+
+	if (c->in_cap - c->in_len < SERVER_READ_SIZE) {
+		c->in_cap = c->in_len + SERVER_READ_SIZE;
+		c->in = realloc(c->in, c->in_cap);
+		CHECK_MALLOC(c->in, "server input");
+	}
+	ssize_t n = read(c->ep.fd, c->in + c->in_len, c->in_cap - c->in_len);
+	if (n > 0) {
+		c->in_len += n;
+		return;
+	}
+	if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+		return;
+	}
+	if (n < 0) {
+		log_warn("server: read: %s", strerror(errno));
+	}
+	c->eof = 1;
+}
+
+// give the complete lines of the input to the workers
+static void conn_parse(struct loop * l, struct conn * c) {
+
+	struct request * head = NULL;
+	struct request ** tail = &head;
+	size_t pos  = 0;
+	size_t skip = c->scan;
+
+	while (c->seq - c->written < SERVER_PIPELINE) {
+		char * nl = memchr(c->in + pos + skip, '\n', c->in_len - pos - skip);
+		size_t len;
+		if (nl != NULL) {
+			len = nl - (c->in + pos);
+		}
+		else if (c->eof && (pos < c->in_len)) { // last line without '\n'
+			len = c->in_len - pos;
+		}
+		else {
+			break;
+		}
+		skip = 0;
+
+		struct request * r = malloc(sizeof(struct request) + len + 1);
+		CHECK_MALLOC(r, "server request");
+		r->conn = c;
+		r->seq  = c->seq++;
+		r->line = (char *) (r + 1);
+		memcpy(r->line, c->in + pos, len);
+		r->line[len] = '\0';
+		r->reply = NULL;
+		r->next  = NULL;
+		*tail = r;
+		tail  = &r->next;
+		c->pending++;
+		pos += len + (nl != NULL);
+	}
+	memmove(c->in, c->in + pos, c->in_len - pos);
+	c->in_len -= pos;
+	c->scan = (c->seq - c->written < SERVER_PIPELINE ? c->in_len : 0);
+
+	if (head != NULL) {
+		workers_push(l->workers, head);
+	}
+}
+
+// put the replies in order in `out` and send as much as possible
+static void conn_flush(struct conn * c) {
+
+	struct request * r;
+	while ((r = c->ready[c->written % SERVER_PIPELINE]) != NULL) {
+		c->ready[c->written % SERVER_PIPELINE] = NULL;
+		c->written++;
+		if (c->broken) {
+			request_free(r);
+			continue;
+		}
+		if (c->out_cap - c->out_len < r->reply_len) {
+			memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+			c->out_len -= c->out_off;
+			c->out_off  = 0;
+			if (c->out_cap - c->out_len < r->reply_len) {
+				c->out_cap = 2 * (c->out_len + r->reply_len);
+				c->out = realloc(c->out, c->out_cap);
+				CHECK_MALLOC(c->out, "server output");
+			}
+		}
+		memcpy(c->out + c->out_len, r->reply, r->reply_len);
+		c->out_len += r->reply_len;
+		request_free(r);
+	}
+
+	while (!c->broken && (c->out_off < c->out_len)) {
+		ssize_t n = send(c->ep.fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+		if (n > 0) {
+			c->out_off += n;
+		}
+		else if ((n < 0) && (errno == EINTR)) {
+			continue;
+		}
+		else if ((n < 0) && (errno == EAGAIN)) {
+			break;
+		}
+		else { // the client left
+			log_info("server: send: %s", strerror(errno));
+			c->broken = 1;
+		}
+	}
+	if (c->broken || (c->out_off == c->out_len)) {
+		c->out_len = 0;
+		c->out_off = 0;
+	}
+}
+
+// evaluate, send, then close or wait for the right events
+static void conn_update(struct loop * l, struct conn * c) {
+
+	if (c->ep.fd < 0) { // closed, waiting for its last replies
+		conn_flush(c);
+		return;
+	}
+	conn_flush(c); // first, it frees room in the pipeline
+	if (!c->broken) {
+		conn_parse(l, c);
+	}
+
+	int finished = (c->eof && (c->in_len == 0) && (c->seq == c->written) && (c->out_len == 0));
+	if (c->broken || finished) {
+		epoll_ctl(l->epoll, EPOLL_CTL_DEL, c->ep.fd, NULL);
+		close(c->ep.fd);
+		c->ep.fd  = -1;
+		c->broken = 1;
+		l->closed++;
+		return;
+	}
+
+	uint32_t events = 0;
+	if (!c->eof && (c->seq - c->written < SERVER_PIPELINE) && (c->out_len - c->out_off < SERVER_OUT_MAX)) {
+		events |= EPOLLIN;
+	}
+	if (c->out_off < c->out_len) {
+		events |= EPOLLOUT;
+	}
+	if (events != c->events) {
+		struct epoll_event ev = {.events = events, .data.ptr = &c->ep};
+		epoll_ctl(l->epoll, EPOLL_CTL_MOD, c->ep.fd, &ev);
+		c->events = events;
+	}
+}
+
+static void conn_event(struct loop * l, struct conn * c, uint32_t events) {
+
+	if (c->ep.fd < 0) { // closed by a previous event of the same batch
+		return;
+	}
+	if (events & (EPOLLERR | EPOLLHUP)) { // nobody to reply to
+		c->broken = 1;
+	}
+	else if (events & EPOLLIN) {
+		conn_read(c);
+	}
+	conn_update(l, c);
+}
+
+// free the closed connections without request at the workers
+static void loop_sweep(struct loop * l) {
+
+	struct conn ** link = &l->conns;
+	while (*link != NULL) {
+		struct conn * c = *link;
+		if ((c->ep.fd < 0) && (c->pending == 0)) {
+			*link = c->next;
+			conn_free(c);
+			l->closed--;
+			continue;
+		}
+		link = &c->next;
+	}
+}
+
+
+
+/*
+	EVENT LOOP
+*/
+
+static int listen_unix(const char * path) {
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		log_warn("server: socket path too long '%s'", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	unlink(path); // left by a previous server
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if ((fd < 0) || (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(fd, SERVER_BACKLOG) < 0)) {
+		log_warn("server: can't listen on '%s': %s", path, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	log_info("server: listen on '%s'", path);
+	return fd;
+}
+
+static int listen_tcp(int port) {
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port   = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local callers only
+
+	int fd  = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	int yes = 1;
+	if ((fd < 0) || (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0)
+		|| (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(fd, SERVER_BACKLOG) < 0)) {
+		log_warn("server: can't listen on port %d: %s", port, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	log_info("server: listen on localhost:%d", port);
+	return fd;
+}
+
+static void loop_add(struct loop * l, struct endpoint * ep, uint32_t events) {
+	struct epoll_event ev = {.events = events, .data.ptr = ep};
+	if (epoll_ctl(l->epoll, EPOLL_CTL_ADD, ep->fd, &ev) < 0) {
+		log_warn("server: epoll_ctl: %s", strerror(errno));
+	}
+}
+
+static void loop_accept(struct loop * l, int listener) {
+
+	while (1) {
+		int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if ((errno != EAGAIN) && (errno != EINTR)) {
+				log_warn("server: accept: %s", strerror(errno));
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		int yes = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)); // fails on a Unix socket, that's fine
+
+		struct conn * c = conn_new(fd);
+		c->next  = l->conns;
+		l->conns = c;
+		c->events = EPOLLIN;
+		loop_add(l, &c->ep, EPOLLIN);
+	}
+}
+
+// give the replies to their connections
+static void loop_replies(struct loop * l) {
+
+	uint64_t count;
+	ssize_t n = read(wake_fd, &count, sizeof(count));
+	(void) n; // EAGAIN if already read
+
+	struct request * r = workers_take(l->workers);
+	while (r != NULL) {
+		struct request * next = r->next;
+		struct conn * c = r->conn;
+		c->pending--;
+		r->next = NULL;
+		c->ready[r->seq % SERVER_PIPELINE] = r;
+		conn_update(l, c);
+		r = next;
+	}
+}
+
+
+int server(const char * path, int port, int threads) {
+
+	if (threads <= 0) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	struct loop l;
+	l.epoll = epoll_create1(EPOLL_CLOEXEC);
+	l.listeners = 0;
+	l.conns  = NULL;
+	l.closed = 0;
+	if (wake_fd < 0) {
+		__atomic_store_n(&wake_fd, eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), __ATOMIC_RELEASE);
+	}
+	if ((l.epoll < 0) || (wake_fd < 0)) {
+		log_warn("server: %s", strerror(errno));
+		return -1;
+	}
+	uint64_t count;
+	ssize_t n = read(wake_fd, &count, sizeof(count)); // from a previous server
+	(void) n;
+	__atomic_store_n(&stopping, 0, __ATOMIC_RELAXED);
+	l.wake.kind = WAKE;
+	l.wake.fd   = wake_fd;
+	loop_add(&l, &l.wake, EPOLLIN);
+
+	int fds[2] = {(path != NULL ? listen_unix(path) : -2), (port > 0 ? listen_tcp(port) : -2)};
+	for (int i = 0; i < 2; i++) {
+		if (fds[i] == -1) { // asked but failed
+			l.listeners = 0;
+			break;
+		}
+		if (fds[i] >= 0) {
+			l.listener[l.listeners].kind = LISTENER;
+			l.listener[l.listeners].fd   = fds[i];
+			loop_add(&l, &l.listener[l.listeners], EPOLLIN);
+			l.listeners++;
+		}
+	}
+	if (l.listeners == 0) {
+		for (int i = 0; i < 2; i++) {
+			if (fds[i] >= 0) {
+				close(fds[i]);
+			}
+		}
+		close(l.epoll);
+		return -1;
+	}
+	l.workers = workers_start(threads);
+
+	struct epoll_event events[SERVER_EVENTS];
+	while (!__atomic_load_n(&stopping, __ATOMIC_RELAXED)) {
+		int n = epoll_wait(l.epoll, events, SERVER_EVENTS, -1);
+		if ((n < 0) && (errno != EINTR)) {
+			log_warn("server: epoll_wait: %s", strerror(errno));
+			break;
+		}
+		for (int i = 0; i < n; i++) {
+			struct endpoint * ep = events[i].data.ptr;
+			switch (ep->kind) {
+				case LISTENER:
+					loop_accept(&l, ep->fd);
+					break;
+				case WAKE:
+					loop_replies(&l);
+					break;
+				case CLIENT:
+					conn_event(&l, (struct conn *) ep, events[i].events);
+					break;
+			}
+		}
+		if (l.closed > 0) {
+			loop_sweep(&l);
+		}
+	}
+	log_info("server: stop");
+
+	workers_stop(l.workers);
+	while (l.conns != NULL) {
+		struct conn * c = l.conns;
+		l.conns = c->next;
+		if (c->ep.fd >= 0) {
+			close(c->ep.fd);
+		}
+		conn_free(c);
+	}
+	for (int i = 0; i < l.listeners; i++) {
+		close(l.listener[i].fd);
+	}
+	if (path != NULL) {
+		unlink(path);
+	}
+	close(l.epoll);
+	return 0;
+}
+
+void server_stop() {
+	__atomic_store_n(&stopping, 1, __ATOMIC_RELAXED); // lock-free, so async-signal-safe
+	wake_loop();
+}
+
+static void stop_handler(int sig) {
+	server_stop();
+}
+
+void server_catch_signals() {
+	struct sigaction act;
+	act.sa_handler = stop_handler;
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = SA_RESTART;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+static void * serve(void * path) {
+	assert(server(path, 0, 2) == 0);
+	return NULL;
+}
+
+static int client(const char * path) {
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	for (int i = 0; i < 200; i++) { // the server starts in its thread
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		assert(fd >= 0);
+		if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+			return fd;
+		}
+		close(fd);
+		struct timespec wait = {0, 10 * 1000 * 1000};
+		nanosleep(&wait, NULL);
+	}
+	assert(0 && "no server");
+	return -1;
+}
+
+// send every request at once, then read every reply in `res`
+static void pipeline(const char * path, const char * requests, char * res, size_t size) {
+
+	int fd = client(path);
+	size_t len = strlen(requests);
+	assert(write(fd, requests, len) == (ssize_t) len);
+	shutdown(fd, SHUT_WR);
+
+	size_t got = 0;
+	ssize_t n;
+	while ((n = read(fd, res + got, size - 1 - got)) > 0) {
+		got += n;
+	}
+	res[got] = '\0';
+	close(fd);
+}
+
+void test_server() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("SERVER:\n");
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/calcul-test-%d.sock", (int) getpid());
+	pthread_t thread;
+	assert(pthread_create(&thread, NULL, serve, path) == 0);
+	char res[1 << 16];
+
+
+	printf(" replies\n");
+	pipeline(path, "1 + 2\n2 ^ 64\n1 # 2\n\n-31", res, sizeof(res)); // no '\n' at the end
+	assert(strcmp(res, "0x3\n0x10000000000000000\nerror 3: Lexer: Unknown symbol '#'\n\n-0x1f\n") == 0);
+
+
+	printf(" pipelining\n");
+	int n = 4 * SERVER_PIPELINE; // more than evaluated at once
+	char * requests = malloc(16 * n);
+	CHECK_MALLOC(requests, "test server");
+	char * expected = malloc(16 * n);
+	CHECK_MALLOC(expected, "test server");
+	int len = 0;
+	int exp = 0;
+	for (int i = 0; i < n; i++) {
+		len += sprintf(requests + len, "%d * 2\n", i);
+		exp += sprintf(expected + exp, "%#x\n", 2 * i);
+	}
+	pipeline(path, requests, res, sizeof(res));
+	assert(strcmp(res, expected) == 0);
+	LOG_FREE(requests);
+	free(requests);
+	LOG_FREE(expected);
+	free(expected);
+
+
+	printf(" stats\n");
+	pipeline(path, "3 ^ 30000\n1 + 1\n" SERVER_STATS "\n", res, sizeof(res)); // deferred to a huge worker
+	assert(strncmp(res, "0x", 2) == 0);
+	assert(strstr(res, "\n0x2\ntiny: depth ") != NULL);
+	assert(strstr(res, "; huge: depth ") != NULL);
+
+
+	printf(" stop\n");
+	server_stop();
+	pthread_join(thread, NULL);
+	assert(access(path, F_OK) != 0); // socket removed
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+#include "scheduler.h"
+
+
+/*
+	Evaluation server
+
+One process keeps its worker threads (and their contexts) for many clients.
+It listens on a Unix socket and/or on a TCP port of localhost. The protocol is
+the one of the batch: a request is a line, its reply is a line, in the order
+of the requests of the connection:
+
+	0x2a
+	                                (empty line)
+	error <column>: <message>
+
+A client can send many requests without waiting for the replies (up to
+`SERVER_PIPELINE` of them are evaluated at once per connection). One thread
+runs an epoll loop over the sockets, the lines are evaluated by the workers
+of a scheduler, so a huge power doesn't delay the small requests.
+
+The request `SERVER_STATS` replies with the depths and the waits of its queues:
+
+	tiny: depth 0, taken 12, wait avg 3us p99 8us max 9us; huge: depth 0, ...
+*/
+
+
+// serve on the Unix socket `path` (NULL for none) and on localhost:`port` (0 for none)
+// with `threads` workers (0 is one per core), until `server_stop`
+// return 0, -1 if it can't listen
+int server(const char * path, int port, int threads);
+
+// stop the server (async-signal-safe)
+void server_stop();
+
+// `server_stop` on SIGINT and SIGTERM
+void server_catch_signals();
+
+
+void test_server();
+
+
+#endif // SERVER_H
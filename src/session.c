@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L // open, pread, O_CLOEXEC
+#include "session.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "calcul\0s" // 8 bytes
+#define SNAPSHOT_VERSION 1
+
+
+// header of a snapshot (integers in the byte order of the host)
+struct session_file {
+	char magic[8];     // `SNAPSHOT_MAGIC`
+	uint32_t version;  // `SNAPSHOT_VERSION`
+	uint32_t has_last;
+	uint64_t last;     // offset of the last result, a multiple of the page size
+	uint64_t max_size;
+	uint64_t eval_budget;
+	double timeout;
+	uint64_t process_budget;
+	uint64_t spill;
+	char scratch[SESSION_PATH];
+};
+
+
+void session_init(struct session * s) {
+	s->config.max_size    = ESTIMATE_MAX_SIZE;
+	s->config.eval_budget = ALLOC_EVAL_BUDGET;
+	s->config.timeout     = CANCEL_TIMEOUT;
+	s->process_budget = ALLOC_PROCESS_BUDGET;
+	s->spill      = ALLOC_SPILL_THRESHOLD;
+	s->scratch[0] = '\0';
+	s->has_last   = 0;
+}
+
+void session_set_last(struct session * s, struct number num) {
+	if (s->has_last) {
+		number_free(s->last);
+	}
+	s->last = num;
+	s->has_last = 1;
+}
+
+long session_snapshot(const struct session * s, const char * path) {
+
+	struct session_file h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	long page = sysconf(_SC_PAGESIZE);
+	h.version  = SNAPSHOT_VERSION;
+	h.has_last = s->has_last;
+	h.last     = ((sizeof(h) + page - 1) / page) * page;
+	h.max_size    = s->config.max_size;
+	h.eval_budget = s->config.eval_budget;
+	h.timeout     = s->config.timeout;
+	h.process_budget = s->process_budget;
+	h.spill = s->spill;
+	snprintf(h.scratch, sizeof(h.scratch), "%s", s->scratch);
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+	struct output o;
+	output_open_fd(&o, fd);
+	output_mem(&o, (const char *) &h, sizeof(h));
+	for (size_t i = sizeof(h); i < h.last; i++) {
+		output_char(&o, '\0');
+	}
+	long written = (output_close(&o) == 0 ? o.written : -1);
+	if ((written >= 0) && s->has_last) {
+		long n = number_save(&s->last, fd);
+		written = (n < 0 ? -1 : written + n);
+	}
+	if ((close(fd) < 0) && (written >= 0)) {
+		written = -1;
+	}
+	return written;
+}
+
+int session_restore(struct session * s, const char * path) {
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	struct session_file h;
+	ssize_t n = pread(fd, &h, sizeof(h), 0);
+	long page = sysconf(_SC_PAGESIZE);
+	if ((n != sizeof(h)) || (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) || (h.version != SNAPSHOT_VERSION)
+		|| (h.scratch[SESSION_PATH - 1] != '\0') || (h.last % page != 0)) {
+		log_warn("'%s' isn't a snapshot", path);
+		close(fd);
+		errno = (n < 0 ? errno : EILSEQ);
+		return -1;
+	}
+	struct number last;
+	if (h.has_last && (number_load(fd, h.last, &last) < 0)) {
+		int errsv = errno;
+		close(fd);
+		errno = errsv;
+		return -1;
+	}
+	close(fd); // a mapping keeps the file
+
+	session_free(s);
+	s->config.max_size    = h.max_size;
+	s->config.eval_budget = h.eval_budget;
+	s->config.timeout     = h.timeout;
+	s->process_budget = h.process_budget;
+	s->spill = h.spill;
+	memcpy(s->scratch, h.scratch, sizeof(s->scratch));
+	s->has_last = h.has_last;
+	if (h.has_last) {
+		s->last = last;
+	}
+	log_info("session restored from '%s'", path);
+	return 0;
+}
+
+void session_free(struct session * s) {
+	if (s->has_last) {
+		number_free(s->last);
+		s->has_last = 0;
+	}
+}
+
+
+
+/*
+	TEST
+*/
+
+
+static void test_fprint(const struct number * num, char * buf, size_t size) {
+	FILE * out = fmemopen(buf, size, "w");
+	assert(out != NULL);
+	number_fprint(out, num);
+	fclose(out);
+}
+
+void test_session() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("SESSION:\n");
+	struct calc_ctx * ctx = ctx_new();
+	CHECK_MALLOC(ctx, "test session");
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/calcul-session-%d.snap", (int) getpid());
+	char expected[1024];
+	char restored[1024];
+	struct session s;
+	struct session r;
+	session_init(&s);
+	session_init(&r);
+
+
+	printf(" last result\n");
+	struct number result;
+	assert(eval_str(ctx, CONSOLE_LAST " + 1", &result) < 0);
+	assert(ctx_error(ctx) == UNMANAGED);
+	assert(eval_str(ctx, "0 - 3 ^ 1001", &result) == 1);
+	session_set_last(&s, result);
+	ctx->last = &s.last;
+	assert(eval_str(ctx, CONSOLE_LAST " - " CONSOLE_LAST " * 2 + (" CONSOLE_LAST ")", &result) == 1);
+	test_fprint(&result, restored, sizeof(restored));
+	assert(strcmp(restored, "0x0") == 0);
+	number_free(result);
+	assert(eval_str(ctx, "2 * " CONSOLE_LAST, &result) == 1);
+	session_set_last(&s, result); // the previous one is freed
+	assert(eval_str(ctx, "-2 * 3 ^ 1001", &result) == 1);
+	test_fprint(&result, expected, sizeof(expected));
+	number_free(result);
+	test_fprint(&s.last, restored, sizeof(restored));
+	assert(strcmp(expected, restored) == 0);
+
+
+	printf(" snapshot and restore\n");
+	s.config.max_size = 1 << 20;
+	s.config.timeout  = 2.5;
+	s.spill = 12345;
+	strcpy(s.scratch, "/tmp");
+	assert(session_snapshot(&s, path) > 0);
+	assert(session_restore(&r, path) == 0);
+	assert((r.config.max_size == s.config.max_size) && (r.config.eval_budget == s.config.eval_budget));
+	assert((r.config.timeout == 2.5) && (r.process_budget == s.process_budget) && (r.spill == 12345));
+	assert(strcmp(r.scratch, "/tmp") == 0);
+	assert(r.has_last);
+	test_fprint(&r.last, restored, sizeof(restored));
+	assert(strcmp(expected, restored) == 0);
+
+	session_free(&s);
+	assert(session_snapshot(&s, path) > 0); // without last result
+	assert(session_restore(&r, path) == 0);
+	assert(!r.has_last && (r.spill == 12345));
+
+
+	printf(" errors\n");
+	FILE * file = fopen(path, "r+");
+	assert(file != NULL);
+	fputc('C', file);
+	fclose(file);
+	r.spill = 1;
+	assert((session_restore(&r, path) < 0) && (errno == EILSEQ));
+	assert(r.spill == 1); // unchanged
+	unlink(path);
+	assert((session_restore(&r, path) < 0) && (errno == ENOENT));
+	assert(session_snapshot(&s, "/nonexistent/dir/f") < 0);
+
+
+	session_free(&r);
+	ctx_free(ctx);
+	printf("done\n\n");
+	#endif
+}
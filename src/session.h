@@ -0,0 +1,61 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+
+
+/*
+	Session snapshot
+
+The state of a session is the configuration of the process (`main` options)
+and the last result of the console (the name `CONSOLE_LAST`). A snapshot is
+one file: a header of one page with the configuration, then the last result
+as saved by `number_save`. At restore, the last result is mapped from the
+file and used in place (see `big_int_load`), its pages are only read when
+the value is.
+*/
+
+
+#define SESSION_PATH 4096 // bytes of the path of the scratch directory
+
+struct session {
+	struct calc_config config; // of the contexts (see `ctx_set_default`)
+	size_t process_budget;     // see `alloc_set_budget`
+	size_t spill;              // see `alloc_set_scratch`
+	char scratch[SESSION_PATH]; // empty without scratch directory
+	int has_last;
+	struct number last;
+};
+
+
+// configuration of `config.h`, no last result
+void session_init(struct session * s);
+
+// replace the last result, `s` owns `num` from now
+void session_set_last(struct session * s, struct number num);
+
+// write the snapshot of `s` in the file `path`
+// return the bytes written, -1 on failure (see `errno`)
+long session_snapshot(const struct session * s, const char * path);
+
+// replace `s` by the snapshot in the file `path`
+// return 0, -1 on failure: `s` is unchanged, the error is set if no memory, see `errno` otherwise
+// (`EILSEQ` if it isn't a snapshot or it is corrupted)
+int session_restore(struct session * s, const char * path);
+
+void session_free(struct session * s);
+
+
+void test_session();
+
+
+#endif // SESSION_H
@@ -1,13 +1,13 @@
 #include "shunting_yard.h"
 
-#define TOKEN_STACK(size) stack_malloc(sizeof(struct token), size, (stack_copy_elem) token_copy);
+#define INDEX_STACK(size) stack_malloc(sizeof(int), size, (stack_copy_elem) token_copy_index);
 
 
 // < 0 means left associative
 //  0  means 
 // 0 < means right associative
-static int assoc(const struct token * const t) {
-	switch (t->type) {
+static int assoc(enum token_type type) {
+	switch (type) {
 
 		case MINUS: // a - b - c = (a - b) - c
 		case POW:
@@ -26,8 +26,8 @@ static int assoc(const struct token * const t) {
 	}
 }
 
-static int preced(const struct token * const t) {
-	switch (t->type) {
+static int preced(enum token_type type) {
+	switch (type) {
 
 		case UNARY_PLUS:
 		case UNARY_MINUS:
@@ -50,23 +50,24 @@ static int preced(const struct token * const t) {
 
 
 // let's assume the parenthesis are correct
-static void shunting_yard_wye(const struct token * input, struct stack * operator, struct stack * output) {
+static void shunting_yard_wye(const struct expr * e, int input, struct stack * operator, struct stack * output) {
 
-	switch (input->type) {
+	enum token_type type = token_type(e, input);
+	switch (type) {
 
 		case NUM_OPERAND:	// operand
 		case VAR_OPERAND: {
-			stack_push(output, input);
+			stack_push(output, &input);
 			return;
 		}
 		case LPARENT:		// (
 		case FUNC_NAME: {	// function
-			stack_push(operator, input);
+			stack_push(operator, &input);
 			return;
 		}
 		case ARG_SEP: {		// ,
-			while (((struct token *) stack_peek(operator))->type != LPARENT) {
-				struct token tmp;
+			while (token_type(e, *(int *) stack_peek(operator)) != LPARENT) {
+				int tmp;
 				stack_pop(operator, &tmp);
 				stack_push(output, &tmp);
 			}
@@ -79,25 +80,25 @@ static void shunting_yard_wye(const struct token * input, struct stack * operato
 		case UNARY_PLUS:
 		case UNARY_MINUS: {
 			while (!stack_empty(operator)) {
-				struct token * top = stack_peek(operator);
-				if ( !((preced(top) > preced(input)) || ((preced(top) == preced(input)) && (assoc(top) < 0))) ) {
+				enum token_type top = token_type(e, *(int *) stack_peek(operator));
+				if ( !((preced(top) > preced(type)) || ((preced(top) == preced(type)) && (assoc(top) < 0))) ) {
 					break;
 				}
-				struct token tmp;
+				int tmp;
 				stack_pop(operator, &tmp);
 				stack_push(output, &tmp);
 			}
-			stack_push(operator, input);
+			stack_push(operator, &input);
 			return;
 		}
 		case RPARENT: { 	// )
-			struct token tmp;
+			int tmp;
 			stack_pop(operator, &tmp);
-			while (tmp.type != LPARENT) {
+			while (token_type(e, tmp) != LPARENT) {
 				stack_push(output, &tmp);
 				stack_pop(operator, &tmp);
 			} // discard LPARENT
-			if ((stack_empty(operator) || (((struct token *) stack_peek(operator))->type != FUNC_NAME))) {
+			if ((stack_empty(operator) || (token_type(e, *(int *) stack_peek(operator)) != FUNC_NAME))) {
 				return;
 			}
 			stack_pop(operator, &tmp);
@@ -111,39 +112,51 @@ static void shunting_yard_wye(const struct token * input, struct stack * operato
 	return;
 }
 
-struct stack * const shunting_yard(int n, const struct token * token) {
+struct stack * const shunting_yard(struct calc_ctx * ctx, const struct expr * e) {
+	int n = e->len;
 	log_debug("Shunting_yard on %d token", n);
 
-	// oversized stacks
-	struct stack * output   = TOKEN_STACK(n);
-	struct stack * operator = TOKEN_STACK(n);
+	// oversized stacks, the operators one is kept in the context
+	if ((ctx->operators != NULL) && (stack_capacity(ctx->operators) < n)) {
+		stack_free(ctx->operators);
+		ctx->operators = NULL;
+	}
+	if (ctx->operators == NULL) {
+		ctx->operators = INDEX_STACK(n);
+	}
+	struct stack * output = INDEX_STACK(n);
+	if ((output == NULL) || (ctx->operators == NULL)) {
+		ctx_error_set(ctx, OUT_OF_MEM, NULL, NULL, 0);
+		if (output != NULL) {
+			stack_free(output);
+		}
+		return NULL;
+	}
+	struct stack * operator = ctx->operators;
 
 	for (int i = 0; i < n; i++) {
-		shunting_yard_wye(&token[i], operator, output);
+		shunting_yard_wye(e, i, operator, output);
 	}
 
 	while (!stack_empty(operator)) {
-		struct token tmp;
+		int tmp;
 		stack_pop(operator, &tmp);
 		stack_push(output, &tmp);
 	}
 	assert(stack_empty(operator));
 
-	// clear
-	stack_free(operator);
 	stack_reverse(output);
 	log_debug("Shunting_yard end, stack expression in %p", output);
 	return output;
 }
 
 
-static void print_rpn_stack_token(const struct token * const t) {
-	token_print(t);
-	printf("\n");
-}
-
-void print_rpn_stack(struct stack const * const rpn_stack) {
-	stack_print(rpn_stack, (stack_print_elem) print_rpn_stack_token);
+void print_rpn_stack(const struct expr * e, struct stack const * const rpn_stack) {
+	for (int i = stack_size(rpn_stack) - 1; i >= 0; i--) { // top to bottom
+		struct token t = token_get(e, *(int *) stack_get(rpn_stack, i));
+		token_print(&t);
+		printf("\n");
+	}
 }
 
 
@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include "config.h"
+#include "context.h"
 #include "log.h"
 #include "stack.h"
 #include "token.h"
@@ -10,12 +11,14 @@
 
 /*
 	`shunting_yard` convert an array of token to a stack in Reverse Polish Notation
+	(of the indices of the tokens in `e`)
 */
 
 
-struct stack * const shunting_yard(int n, const struct token * token);
+// return NULL if no memory (error in `ctx`)
+struct stack * const shunting_yard(struct calc_ctx * ctx, const struct expr * e);
 
-void print_rpn_stack(struct stack const * const rpn_stack);
+void print_rpn_stack(const struct expr * e, struct stack const * const rpn_stack);
 
 
 void test_shunting_yard();
@@ -13,8 +13,11 @@ struct stack {
 struct stack * stack_malloc(int elem_size, int max_elem, stack_copy_elem copy) {
 
 	// store the stack on the heap {struct stack, [elem_size * max_elem]}
-	struct stack * s = malloc(sizeof(struct stack) + (elem_size * max_elem));
-	CHECK_MALLOC(s, "stack_malloc");
+	struct stack * s = alloc_malloc(sizeof(struct stack) + ((size_t) elem_size * max_elem));
+	log_trace("malloc %p: stack_malloc", s);
+	if (s == NULL) {
+		return NULL;
+	}
 
 	// init the stack
 	s->elem_size = elem_size;
@@ -47,6 +50,11 @@ void * stack_peek(const struct stack * s) {
 	return (s->current - s->elem_size);
 }
 
+void * stack_get(const struct stack * s, int i) {
+	assert((0 <= i) && (i < stack_size(s)));
+	return (s->start + (s->elem_size * i));
+}
+
 // yes, that's not a basic operation, 
 // but that's so easy to write and so much efficient that without the struct
 void stack_reverse(struct stack * s) {
@@ -78,6 +86,10 @@ int stack_size(const struct stack * s) {
 	return ((s->current - s->start) / s->elem_size);
 }
 
+int stack_capacity(const struct stack * s) {
+	return s->max_elem;
+}
+
 
 // print
 void stack_print(const struct stack * s, stack_print_elem print) {
@@ -94,7 +106,7 @@ void stack_free(struct stack * s) {
 	s->start   = NULL;
 	s->current = NULL;
 	LOG_FREE(s);
-	free(s);
+	alloc_free(s);
 }
 
 
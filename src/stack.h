@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include "alloc.h"
 #include "config.h"
 #include "log.h"
 
@@ -10,6 +11,7 @@
 // create stack
 typedef void (*stack_copy_elem)(const void * const src, void * const dst);
 
+// return NULL if no memory (see alloc.h)
 struct stack * stack_malloc(int elem_size, int max_elem, stack_copy_elem copy);
 
 
@@ -20,6 +22,8 @@ void stack_pop(struct stack * s, void * dst);
 
 void * stack_peek(const struct stack * s);
 
+void * stack_get(const struct stack * s, int i); // i-th element from the bottom
+
 void stack_reverse(struct stack * s);
 
 
@@ -30,6 +34,8 @@ int stack_full(const struct stack * s);
 
 int stack_size(const struct stack * s);
 
+int stack_capacity(const struct stack * s);
+
 
 // print
 typedef void (*stack_print_elem)(const void * const elem);
@@ -0,0 +1,447 @@
+#include "stream.h"
+
+#define STREAM_FEED_MAX (1 << 30) // digits given at once to `big_int_conv_digits`
+
+
+// `c` goes on the name or the number before it
+static int name_char(char c) {
+	return (isalnum((unsigned char) c) || (c == '_'));
+}
+
+// a digit of a literal in `base`, as the lexer reads it (10 is the base without prefix)
+static int is_digit(char c, int base) {
+	if (base == 16) {
+		return isxdigit((unsigned char) c);
+	}
+	return (isdigit((unsigned char) c) && ((base == 10) || (c - '0' < base)));
+}
+
+// the first error of the line, the rest of it is skipped
+static void fail(struct stream * s, enum error_type err, long at) {
+	if (s->error == NO_ERROR) {
+		s->error    = err;
+		s->error_at = at;
+		s->error_word = -1;
+	}
+}
+
+static void append(struct stream * s, const char * mem, size_t len) {
+	if (s->len + len + 1 > s->cap) {
+		size_t cap = 2 * s->cap;
+		while (cap < s->len + len + 1) {
+			cap *= 2;
+		}
+		char * text = realloc(s->text, cap);
+		if (text == NULL) {
+			fail(s, OUT_OF_MEM, s->len);
+			return;
+		}
+		s->text = text;
+		s->cap  = cap;
+	}
+	memcpy(s->text + s->len, mem, len);
+	s->len += len;
+	s->text[s->len] = '\0';
+}
+
+// the conversion of `ctx` failed (no memory, cancelled...)
+static void conv_failed(struct calc_ctx * ctx, struct stream * s, long at) {
+	fail(s, (ctx_error(ctx) ? ctx_error(ctx) : OUT_OF_MEM), at);
+	ctx_error_reset(ctx);
+}
+
+static void conv_digits(struct calc_ctx * ctx, struct stream * s, const char * digits, size_t len) {
+	ctx_bind(ctx);
+	while (len > 0) {
+		int n = (len < STREAM_FEED_MAX ? (int) len : STREAM_FEED_MAX);
+		if (big_int_conv_digits(&s->conv, digits, n) < 0) {
+			big_int_conv_free(&s->conv);
+			s->streamed = 0;
+			s->lit = -1;
+			conv_failed(ctx, s, s->len);
+			break;
+		}
+		digits += n;
+		len    -= n;
+	}
+	ctx_bind(NULL);
+}
+
+// the literal kept as text is long enough: its digits go to the conversion from now on
+static void start_literal(struct calc_ctx * ctx, struct stream * s) {
+	long first = s->lit + (s->base != 10 ? 2 : 0); // after the prefix
+	long end = (s->point ? s->point_at : (long) s->len);
+	if (end == first) { // no integer part, the lexer refuses it
+		return;
+	}
+	if (!s->running) { // the limits of an evaluation
+		ctx->alloc.budget = ctx->config.eval_budget;
+		ctx->alloc.used   = 0;
+		cancel_begin(ctx->config.timeout);
+		s->running = 1;
+	}
+	ctx_bind(ctx);
+	int res = big_int_conv_begin(&s->conv, s->base, 0);
+	ctx_bind(NULL);
+	s->len = s->lit;
+	if (res < 0) {
+		s->text[s->len] = '\0';
+		s->lit = -1;
+		conv_failed(ctx, s, s->len);
+		return;
+	}
+	s->streamed = 1;
+	log_info("stream: literal of base %d converted while read", s->base);
+	conv_digits(ctx, s, s->text + first, end - first);
+	s->text[s->len] = '\0';
+}
+
+// end of a streamed literal on `next`, its name goes in the text
+static void end_literal(struct calc_ctx * ctx, struct stream * s, char next) {
+	s->lit = -1;
+	s->streamed = 0;
+	if ((s->base != 10) && (s->base != 16) && isxdigit((unsigned char) next)) { // as `try_number`
+		big_int_conv_free(&s->conv);
+		char prefix[] = {'0' + s->base, 'x', next}; // in place of the digits, for the message
+		long at = s->len;
+		append(s, prefix, sizeof(prefix));
+		fail(s, WRONG_BASE, at + 2);
+		s->error_word = at;
+		return;
+	}
+	ctx_bind(ctx);
+	struct big_int * big = big_int_conv_end(&s->conv);
+	ctx_bind(NULL);
+	if (big == NULL) {
+		conv_failed(ctx, s, s->len);
+		return;
+	}
+	int index = ctx_add_literal(ctx, number_of_big(big));
+	if (index < 0) {
+		conv_failed(ctx, s, s->len);
+		return;
+	}
+	char name[32];
+	int n = snprintf(name, sizeof(name), STREAM_NAME "%d ", index); // never merged with what follows
+	append(s, name, n);
+	log_info("stream: literal named '" STREAM_NAME "%d'", index);
+}
+
+
+int stream_init(struct stream * s) {
+	memset(s, 0, sizeof(struct stream));
+	s->cap   = CONSOLE_LINE_SIZE;
+	s->text  = malloc(s->cap);
+	s->chunk = malloc(STREAM_CHUNK);
+	if ((s->text == NULL) || (s->chunk == NULL)) {
+		free(s->text);
+		free(s->chunk);
+		return -1;
+	}
+	s->text[0] = '\0';
+	s->lit = -1;
+	return 0;
+}
+
+size_t stream_feed(struct calc_ctx * ctx, struct stream * s, const char * bytes, size_t len) {
+
+	size_t i = 0;
+	while ((i < len) && !s->done) {
+
+		if (s->error != NO_ERROR) { // skip the rest of the line
+			const char * nl = memchr(bytes + i, '\n', len - i);
+			size_t end = (nl != NULL ? (size_t) (nl - bytes) + 1 : len);
+			s->read += end - i;
+			s->done  = (nl != NULL);
+			return end;
+		}
+
+		if (s->streamed) { // a run of digits at once
+			size_t run = i;
+			while ((run < len) && is_digit(bytes[run], s->base)) {
+				run++;
+			}
+			if (!s->point) {
+				conv_digits(ctx, s, bytes + i, run - i);
+			}
+			s->pos  += run - i;
+			s->read += run - i;
+			i = run;
+			if ((i == len) || !s->streamed) {
+				continue;
+			}
+			if ((bytes[i] == '.') && !s->point) { // the decimals are skipped (no float yet)
+				s->point = 1;
+				s->pos++;
+				s->read++;
+				i++;
+				continue;
+			}
+			end_literal(ctx, s, bytes[i]);
+			continue; // then `bytes[i]` as text
+		}
+
+		char c = bytes[i++];
+		s->read++;
+		if (s->lit >= 0) { // literal kept as text (so far)
+			if ((s->pos == 1) && (c == 'x')) { // prefix of the base
+				int digit = s->text[s->lit] - '0';
+				s->base = (digit == 0 ? 16 : digit);
+			}
+			else if ((c == '.') && !s->point) {
+				s->point    = 1;
+				s->point_at = s->len;
+			}
+			else if (!is_digit(c, s->base)) {
+				s->lit = -1;
+			}
+			if (s->lit >= 0) {
+				append(s, &c, 1);
+				if (++s->pos == STREAM_LITERAL) {
+					start_literal(ctx, s);
+				}
+				continue;
+			}
+		}
+		if (isdigit((unsigned char) c) && !((s->len > 0) && name_char(s->text[s->len - 1]))) {
+			s->lit   = s->len;
+			s->pos   = 1;
+			s->base  = 10;
+			s->point = 0;
+		}
+		append(s, &c, 1);
+		if (c == '\n') {
+			s->lit  = -1;
+			s->done = 1;
+		}
+	}
+	return i;
+}
+
+void stream_close(struct calc_ctx * ctx, struct stream * s) {
+	if (s->done) {
+		return;
+	}
+	if (s->streamed && (s->error == NO_ERROR)) {
+		end_literal(ctx, s, '\n');
+	}
+	s->lit = -1;
+	append(s, "\n", 1);
+	s->done = 1;
+}
+
+int stream_read(struct calc_ctx * ctx, struct stream * s, FILE * in) {
+	while (!s->done) {
+		if (fgets(s->chunk, STREAM_CHUNK, in) == NULL) {
+			if (s->read == 0) {
+				return 0;
+			}
+			stream_close(ctx, s);
+			break;
+		}
+		stream_feed(ctx, s, s->chunk, strlen(s->chunk));
+	}
+	return 1;
+}
+
+int stream_check(struct calc_ctx * ctx, struct stream * s) {
+	if (s->running) {
+		cancel_end();
+		s->running = 0;
+	}
+	if (s->error == NO_ERROR) {
+		return 0;
+	}
+	if (s->error_word >= 0) {
+		ctx_error_set(ctx, s->error, s->text + s->error_at, s->text + s->error_word, 2);
+	}
+	else {
+		ctx_error_set(ctx, s->error, s->text + s->error_at, NULL, 0);
+	}
+	return -1;
+}
+
+void stream_reset(struct calc_ctx * ctx, struct stream * s) {
+	if (s->streamed) {
+		big_int_conv_free(&s->conv);
+	}
+	if (s->running) {
+		cancel_end();
+	}
+	ctx_free_literals(ctx);
+	s->len  = 0;
+	s->text[0] = '\0';
+	s->read = 0;
+	s->done = 0;
+	s->running  = 0;
+	s->lit      = -1;
+	s->streamed = 0;
+	s->error    = NO_ERROR;
+}
+
+void stream_free(struct stream * s) {
+	LOG_FREE(s->text);
+	free(s->text);
+	LOG_FREE(s->chunk);
+	free(s->chunk);
+}
+
+
+
+/*
+	TEST
+*/
+
+
+// feed `line` by pieces of `piece` bytes, return the bytes used
+static size_t feed_pieces(struct calc_ctx * ctx, struct stream * s, const char * line, size_t len, size_t piece) {
+	size_t used = 0;
+	while ((used < len) && !s->done) {
+		size_t n = (len - used < piece ? len - used : piece);
+		used += stream_feed(ctx, s, line + used, n);
+	}
+	return used;
+}
+
+// the results of big operations stay BIG
+static int is_zero(const struct number * n) {
+	if (n->type == INTEGER) {
+		return (n->data.integer == 0);
+	}
+	const unsigned char * bytes;
+	int len;
+	big_int_bytes(n->data.big, &bytes, &len);
+	for (int i = 0; i < len; i++) {
+		if (bytes[i] != 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void test_stream() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("STREAM:\n");
+	struct calc_ctx * ctx = ctx_new();
+	assert(ctx != NULL);
+	struct stream s;
+	assert(stream_init(&s) == 0);
+	struct number result;
+	struct number expected;
+	const int n = STREAM_LITERAL + 100;
+	char * line = malloc(2 * n + 64);
+	assert(line != NULL);
+
+
+	printf(" short lines\n");
+	const char * text = "12 * (3 + x1) - 0x1f.8\n7\n";
+	size_t used = feed_pieces(ctx, &s, text, strlen(text), 3);
+	assert(s.done && (used == 23));
+	assert(strcmp(s.text, "12 * (3 + x1) - 0x1f.8\n") == 0); // as is
+	assert(stream_check(ctx, &s) == 0);
+	stream_reset(ctx, &s);
+	assert(stream_feed(ctx, &s, text + used, strlen(text) - used) == 2);
+	assert(strcmp(s.text, "7\n") == 0);
+	stream_reset(ctx, &s);
+
+
+	printf(" huge literals\n");
+	int len = sprintf(line, "0x1");
+	memset(line + len, '0', n);
+	len += n;
+	len += sprintf(line + len, " + 1\n");
+	assert(feed_pieces(ctx, &s, line, len, 1000) == (size_t) len);
+	assert(strcmp(s.text, STREAM_NAME "0  + 1\n") == 0); // the digits never kept
+	assert(stream_check(ctx, &s) == 0);
+	assert(eval_str(ctx, s.text, &result) == 1);
+	sprintf(line, "2 ^ %d + 1", 4 * n);
+	assert(eval_str(ctx, line, &expected) == 1);
+	assert(big_int_cmp(result.data.big, expected.data.big) == 0);
+	number_free(result);
+	number_free(expected);
+	stream_reset(ctx, &s);
+
+	memset(line, '9', n); // the decimals skipped, in pieces longer than a literal
+	len = n;
+	len += sprintf(line + len, ".5 + 1 - 10 ^ %d\n", n);
+	assert(feed_pieces(ctx, &s, line, len, 2 * STREAM_LITERAL / 3) == (size_t) len);
+	assert(strncmp(s.text, STREAM_NAME "0  + 1 - 10 ^", 13) == 0);
+	assert(stream_check(ctx, &s) == 0);
+	assert(eval_str(ctx, s.text, &result) == 1);
+	assert(is_zero(&result));
+	number_free(result);
+	stream_reset(ctx, &s);
+
+	len = sprintf(line, "1 + ");
+	memset(line + len, '9', n);
+	len += n;
+	len += sprintf(line + len, " - 10 ^ %d\n", n);
+	assert(feed_pieces(ctx, &s, line, len, 4096) == (size_t) len);
+	assert(stream_check(ctx, &s) == 0);
+	assert(eval_str(ctx, s.text, &result) == 1);
+	assert(is_zero(&result));
+	number_free(result);
+	stream_reset(ctx, &s);
+
+
+	printf(" stream_read\n");
+	FILE * file = tmpfile();
+	assert(file != NULL);
+	fputs("0x", file);
+	for (int i = 0; i < n; i++) {
+		fputc('f', file);
+	}
+	fputs(" * 2\n3 + 4", file); // the last line without '\n'
+	rewind(file);
+	assert(stream_read(ctx, &s, file) == 1);
+	assert(strcmp(s.text, STREAM_NAME "0  * 2\n") == 0);
+	assert(stream_check(ctx, &s) == 0);
+	assert(eval_str(ctx, s.text, &result) == 1);
+	assert(big_int_length(result.data.big) == n / 2 + 1);
+	number_free(result);
+	stream_reset(ctx, &s);
+	assert(stream_read(ctx, &s, file) == 1);
+	assert(strcmp(s.text, "3 + 4\n") == 0);
+	stream_reset(ctx, &s);
+	assert(stream_read(ctx, &s, file) == 0);
+	fclose(file);
+
+
+	printf(" errors\n");
+	len = sprintf(line, "(2x");
+	memset(line + len, '1', n);
+	len += n;
+	len += sprintf(line + len, "21)\n1\n");
+	assert(feed_pieces(ctx, &s, line, len, 1 << 20) == (size_t) len - 2); // up to the end of the line
+	assert(stream_check(ctx, &s) < 0);
+	assert(ctx_error(ctx) == WRONG_BASE);
+	assert(strcmp(s.text, "(2x2") == 0); // the prefix in place of the digits
+	ctx_error_reset(ctx);
+	stream_reset(ctx, &s);
+
+	ctx->config.eval_budget = 1000; // the value of the literal is over
+	len = sprintf(line, "0x");
+	memset(line + len, 'a', n);
+	len += n;
+	line[len++] = '\n';
+	assert(feed_pieces(ctx, &s, line, len, 1 << 20) == (size_t) len);
+	assert(stream_check(ctx, &s) < 0);
+	assert(ctx_error(ctx) == MEM_BUDGET);
+	assert(strcmp(s.text, "") == 0);
+	ctx_error_reset(ctx);
+	stream_reset(ctx, &s);
+	ctx->config.eval_budget = ALLOC_EVAL_BUDGET;
+
+
+	free(line);
+	stream_free(&s);
+	ctx_free(ctx);
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -0,0 +1,85 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "big_int.h"
+#include "cancel.h"
+#include "config.h"
+#include "context.h"
+#include "error.h"
+#include "eval.h"
+#include "log.h"
+#include "number.h"
+
+
+/*
+	Streaming input of a line
+
+A line is read by chunks (`stream_feed`), it is never needed as a whole. The
+operators, names and short literals are kept as text, but a literal reaching
+`STREAM_LITERAL` bytes is converted while its digits arrive (see
+`big_int_conv`): its digits are never kept, the line keeps its name instead,
+`STREAM_NAME` and its index, bound to its value in the context. So a line of a
+huge literal takes about the memory of its binary value.
+
+After the line, `s->text` is evaluated (or run as a command) as any line,
+with the same context. The errors are then in `s->text`.
+*/
+
+
+struct stream {
+	char * text;    // the line, the streamed literals replaced by their names
+	size_t len;
+	size_t cap;
+	long read;      // bytes of the line
+	int done;       // its '\n' (or the end of the input) is read
+	int running;    // a literal is converted, `cancel_begin` is called
+	char * chunk;   // of `stream_read`
+
+	// literal being read
+	long lit;       // its offset in `text`, -1 if none
+	long pos;       // bytes of the literal so far
+	int base;
+	int point;      // after its '.', the digits are skipped
+	long point_at;  // offset of the '.' in `text`
+	int streamed;   // its digits go to `conv`, not in `text`
+	struct big_int_conv conv;
+
+	enum error_type error; // of a streamed literal, for `stream_check`
+	long error_at;         // offset in `text`
+	long error_word;       // of the prefix of the base (WRONG_BASE), -1 if none
+};
+
+
+// return -1 if no memory
+int stream_init(struct stream * s);
+
+// `len` more bytes of the line, the streamed literals are named in `ctx`
+// return the bytes used: up to the '\n' ending the line (included), then `s->done` is set
+size_t stream_feed(struct calc_ctx * ctx, struct stream * s, const char * bytes, size_t len);
+
+// the input ends without '\n'
+void stream_close(struct calc_ctx * ctx, struct stream * s);
+
+// read a line of `in` by chunks of `STREAM_CHUNK` bytes
+// return 0 at the end of the input (nothing read), 1 otherwise
+int stream_read(struct calc_ctx * ctx, struct stream * s, FILE * in);
+
+// end of the reading of the line, before its evaluation
+// return -1 (and set the error of `ctx` in `s->text`) if a streamed literal failed, 0 otherwise
+int stream_check(struct calc_ctx * ctx, struct stream * s);
+
+// for the next line, the streamed literals not taken by an evaluation are freed
+void stream_reset(struct calc_ctx * ctx, struct stream * s);
+
+void stream_free(struct stream * s);
+
+
+void test_stream();
+
+
+#endif // STREAM_H
@@ -1,11 +1,28 @@
 #include <stdio.h>
 
+#include "alloc.h"
+#include "batch.h"
 #include "big_int.h"
+#include "calcul.h"
+#include "cancel.h"
+#include "checkpoint.h"
+#include "command.h"
+#include "context.h"
+#include "estimate.h"
 #include "lexer.h"
 #include "stack.h"
 #include "number.h"
+#include "output.h"
 #include "parser.h"
+#include "program.h"
+#include "progress.h"
+#include "ring.h"
+#include "scheduler.h"
+#include "server.h"
+#include "session.h"
 #include "shunting_yard.h"
+#include "stream.h"
+#include "token.h"
 
 /*
 	This file should be compile as an executable to run all test
@@ -32,12 +49,29 @@ int main(int argc, char *argv[]) {
 	#endif // LOG_LEVEL
 
 
-	// test_lexer();
+	test_alloc();
+	test_cancel();
+	test_context();
+	test_progress();
+	test_lexer();
 	// test_parser();
 	// test_stack();
 	// test_shunting_yard();
+	test_output();
 	test_big_int();
-	// test_number();
+	test_checkpoint();
+	test_token();
+	test_estimate();
+	test_program();
+	test_command();
+	test_stream();
+	test_session();
+	test_batch();
+	test_calcul();
+	test_scheduler();
+	test_server();
+	test_ring();
+	test_number();
 
 	#endif // NDEBUG
 
@@ -51,42 +51,159 @@ void token_print(const struct token * const t) {
 	}
 }
 
-void token_copy(const struct token * const src, struct token * const dst) {
-	*dst = *src;
-}
+#define TYPE_MASK 0x7f
+#define TOKEN_WIDE 0x80 // flag of the type: the length is in `wide`
 
 
-struct expr token_expr(int len) {
+struct expr token_expr(const char * src, int len) {
 	assert(len >= 0);
 
 	struct expr e;
+	e.src    = src;
+	e.offset = NULL;
+	e.packed = NULL;
+	e.wide   = NULL;
+	e.wides  = 0;
+	e.len    = 0;
 	if (len == 0) {
-		e.list = NULL;
-		e.len  = 0;
 		return e;
 	}
 
-	e.list = (struct token *) malloc(sizeof(struct token) * len);
-	CHECK_MALLOC(e.list, "token_expr");
-	e.len = len;
+	e.offset = alloc_malloc(2 * sizeof(uint32_t) * len); // both arrays at once
+	log_trace("malloc %p: token_expr", e.offset);
+	if (e.offset != NULL) {
+		e.packed = e.offset + len;
+		e.len    = len;
+	}
 	return e;
 }
 
+int token_set(struct expr * e, int i, const struct token * t) {
+	assert((0 <= i) && (i < e->len));
+	assert((t->str >= e->src) && (t->str - e->src <= TOKEN_OFFSET_MAX));
+	assert((t->len >= 0) && (t->type <= TYPE_MASK));
+
+	e->offset[i] = t->str - e->src;
+	if (t->len < TOKEN_LEN_MAX) {
+		e->packed[i] = ((uint32_t) t->len << 8) | t->type;
+		return 0;
+	}
+	int * wide = alloc_realloc(e->wide, sizeof(int) * (e->wides + 1));
+	if (wide == NULL) {
+		return -1;
+	}
+	e->wide = wide;
+	e->wide[e->wides] = t->len;
+	e->packed[i] = ((uint32_t) e->wides << 8) | TOKEN_WIDE | t->type;
+	e->wides++;
+	return 0;
+}
+
+struct token token_get(const struct expr * e, int i) {
+	assert((0 <= i) && (i < e->len));
+
+	uint32_t word = e->packed[i];
+	struct token t;
+	t.type = word & TYPE_MASK;
+	t.str  = e->src + e->offset[i];
+	t.len  = ((word & TOKEN_WIDE) ? e->wide[word >> 8] : (int) (word >> 8));
+	return t;
+}
+
+enum token_type token_type(const struct expr * e, int i) {
+	assert((0 <= i) && (i < e->len));
+	return (e->packed[i] & TYPE_MASK);
+}
+
+void token_set_type(struct expr * e, int i, enum token_type type) {
+	assert((0 <= i) && (i < e->len));
+	e->packed[i] = (e->packed[i] & ~(uint32_t) TYPE_MASK) | type;
+}
+
+void token_copy_index(const int * const src, int * const dst) {
+	*dst = *src;
+}
+
 void token_print_expr(const struct expr * const e) {
 
-	printf("expr [%p] \n", e->list);
+	printf("expr [%p] \n", e->offset);
 	for (int i = 0; i < e->len; i++) {
+		struct token t = token_get(e, i);
 		printf("%3d ", i);
-		token_print(&(e->list[i]));
+		token_print(&t);
 		printf("\n");
 	}
 }
 
 void token_free_expr(struct expr * e) {
 	e->len = 0;
-	if (e->list != NULL) {
-		LOG_FREE(e->list);
-		free(e->list);
-		e->list = NULL;
+	if (e->offset != NULL) {
+		LOG_FREE(e->offset);
+		alloc_free(e->offset);
+		e->offset = NULL;
+		e->packed = NULL;
+	}
+	if (e->wide != NULL) {
+		alloc_free(e->wide);
+		e->wide  = NULL;
+		e->wides = 0;
 	}
-}
\ No newline at end of file
+}
+
+
+
+/*
+	TEST
+*/
+
+
+void test_token() {
+
+	#ifdef NDEBUG
+	printf("COMPILE ERROR: test should NOT be compile with '-DNDEBUG'\n\n");
+	exit(1);
+	#else
+	printf("TOKEN:\n");
+
+
+	printf(" packed\n");
+	const char * src = "12 + x";
+	struct expr e = token_expr(src, 3);
+	assert(e.len == 3);
+	struct token t = {NUMBER, src, 2};
+	assert(token_set(&e, 0, &t) == 0);
+	t = (struct token) {SYMBOL, src + 3, 1};
+	assert(token_set(&e, 1, &t) == 0);
+	t = (struct token) {NAME, src + 5, 1};
+	assert(token_set(&e, 2, &t) == 0);
+	t = token_get(&e, 0);
+	assert((t.type == NUMBER) && (t.str == src) && (t.len == 2));
+	t = token_get(&e, 2);
+	assert((t.type == NAME) && (t.str == src + 5) && (t.len == 1));
+	token_set_type(&e, 1, PLUS);
+	assert(token_type(&e, 1) == PLUS);
+	t = token_get(&e, 1);
+	assert((t.str == src + 3) && (t.len == 1));
+	token_free_expr(&e);
+	assert((e.len == 0) && (e.offset == NULL));
+
+
+	printf(" long tokens\n"); // only the lengths, the source isn't read
+	e = token_expr(src, 2);
+	t = (struct token) {NUMBER, src, TOKEN_LEN_MAX + 7};
+	assert(token_set(&e, 0, &t) == 0);
+	t = (struct token) {NUMBER, src + 1, TOKEN_LEN_MAX};
+	assert(token_set(&e, 1, &t) == 0);
+	assert(e.wides == 2);
+	token_set_type(&e, 0, NUM_OPERAND);
+	t = token_get(&e, 0);
+	assert((t.type == NUM_OPERAND) && (t.len == TOKEN_LEN_MAX + 7));
+	t = token_get(&e, 1);
+	assert((t.type == NUMBER) && (t.str == src + 1) && (t.len == TOKEN_LEN_MAX));
+	token_free_expr(&e);
+	assert(e.wide == NULL);
+
+
+	printf("done\n\n");
+	#endif
+}
@@ -2,8 +2,11 @@
 #define TOKEN_H
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
 #include "config.h"
 #include "log.h"
 
@@ -33,6 +36,7 @@ enum token_type {
 	ARG_SEP,
 };
 
+// a token unpacked (see `token_get`)
 struct token {
 	enum token_type type;
 	const char * str;
@@ -41,21 +45,53 @@ struct token {
 
 void token_print(const struct token * const t);
 
-void token_copy(const struct token * const src, struct token * const dst);
 
 
+/*
+	Packed expression
+
+The tokens are stored in struct-of-arrays, 8 bytes per token: the offset of the
+token in the source (32 bits) and a word of its length (24 bits) and its type (8
+bits). The rare lengths from `TOKEN_LEN_MAX` are kept aside in `wide`. The stacks
+of the parser and of the RPN hold indices of tokens (`int`), not tokens.
+*/
+
+#define TOKEN_LEN_MAX ((1 << 24) - 1)
+#define TOKEN_OFFSET_MAX UINT32_MAX // the source of an expression is under 4 GiB
 
 struct expr {
-	struct token * list;
+	const char * src;  // the tokens point in it
+	uint32_t * offset; // of each token in `src`
+	uint32_t * packed; // length << 8 | type, or the index in `wide` of a long one
+	int * wide;        // lengths over 24 bits
+	int wides;
 	int len;
 };
 
-struct expr token_expr(int len);
+// for the tokens of `src`, `len` is 0 if no memory
+struct expr token_expr(const char * src, int len);
+
+// `t->str` is in `e->src`, at most `TOKEN_OFFSET_MAX` bytes after it
+// return -1 if no memory (for a long token)
+int token_set(struct expr * e, int i, const struct token * t);
+
+struct token token_get(const struct expr * e, int i);
+
+enum token_type token_type(const struct expr * e, int i);
+
+// the same token (string and length) of another type
+void token_set_type(struct expr * e, int i, enum token_type type);
+
+// `stack_copy_elem` of the stacks of indices
+void token_copy_index(const int * const src, int * const dst);
 
 void token_print_expr(const struct expr * const e);
 
 void token_free_expr(struct expr * e);
 
 
+void test_token();
+
+
 
 #endif // TOKEN_H
\ No newline at end of file